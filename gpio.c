@@ -46,6 +46,7 @@ int set_pin_handle( PIN_HANDLE *pin_handle, const mrbc_value *val )
 
   case MRBC_TT_STRING: {
     const char *s = mrbc_string_cstr(val);
+    if( !s ) return -1;		// ENOMEM
     if( 'A' <= s[0] && s[0] <= 'G' ) {
       pin_handle->port = s[0] - 'A' + 1;
     } else if( 'a' <= s[0] && s[0] <= 'g' ) {
@@ -51,15 +51,20 @@ void mrbc_tick(void);
 # define hal_enable_irq()  __builtin_enable_interrupts()
 # define hal_disable_irq() __builtin_disable_interrupts()
 # define hal_idle_cpu()    _wait()
+uint32_t hal_idle_tickless(uint32_t ticks);	// in timer.c
 
 #else // MRBC_NO_TIMER
 # define hal_init()        ((void)0)
 # define hal_enable_irq()  ((void)0)
 # define hal_disable_irq() ((void)0)
 # define hal_idle_cpu()    ((__delay_ms(MRBC_TICK_UNIT)), mrbc_tick())
+# define hal_idle_tickless(ticks) ((__delay_ms(MRBC_TICK_UNIT)), 1)
 
 #endif
 
+// RAM is at physical address 0x00000000, and flash at 0x1D000000.
+#define hal_is_ram_address(p) (((uintptr_t)(p) & 0x1FFFFFFF) < 0x1D000000)
+
 int hal_write(int fd, const void *buf, int nbytes);
 int hal_flush(int fd);
 void hal_abort(const char *s);
@@ -0,0 +1,7 @@
+# block iteration
+a = [1, 2, 3, 4, 5, 6, 7, 8, 9, 10]
+sum = 0
+20_000.times {
+  a.each { |x| sum += x }
+}
+puts sum
@@ -0,0 +1,10 @@
+# comparison of Integer and Float
+i = 0
+hit = 0
+while i < 500_000
+  hit += 1 if i < 250_000.0
+  hit += 1 if i >= 100_000
+  hit += 1 if 0.5 <= i
+  i += 1
+end
+puts hit
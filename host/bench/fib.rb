@@ -0,0 +1,6 @@
+# recursive method call
+def fib(n)
+  n < 2 ? n : fib(n - 1) + fib(n - 2)
+end
+
+puts fib(25)
@@ -0,0 +1,10 @@
+# Hash lookup with 100 entries
+h = {}
+100.times { |i| h["key#{i}"] = i }
+keys = h.keys
+
+sum = 0
+1000.times {
+  keys.each { |k| sum += h[k] }
+}
+puts sum
@@ -0,0 +1,12 @@
+# keyword arguments and splat
+def read(addr, n, stop: false, timeout: 10)
+  n + timeout
+end
+
+args = [0x40, 2]
+sum = 0
+20_000.times {
+  sum += read(0x40, 2, stop: true)
+  sum += read(*args, timeout: 1)
+}
+puts sum
@@ -0,0 +1,8 @@
+# integer arithmetic in while loop
+i = 0
+sum = 0
+while i < 1_000_000
+  sum += i * 2 - 1
+  i += 1
+end
+puts sum
@@ -0,0 +1,26 @@
+# instance variables and method calls
+class Sensor
+  def initialize
+    @value = 0
+    @count = 0
+  end
+
+  def update(v)
+    @value = v
+    @count += 1
+  end
+
+  def value
+    @value
+  end
+end
+
+s = Sensor.new
+i = 0
+sum = 0
+while i < 200_000
+  s.update(i)
+  sum += s.value
+  i += 1
+end
+puts sum
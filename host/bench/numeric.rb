@@ -0,0 +1,12 @@
+# mixed Integer and Float arithmetic (first order IIR filter)
+coef = 0.25
+y = 0.0
+n = 0
+i = 0
+while i < 200_000
+  x = i % 1024
+  y = y + (x - y) * coef
+  n += 1 if y > 512
+  i += 1
+end
+puts n
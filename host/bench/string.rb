@@ -0,0 +1,8 @@
+# string building
+n = 0
+2_000.times { |i|
+  s = ""
+  10.times { |j| s << j.to_s }
+  n += s.size
+}
+puts n
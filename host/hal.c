@@ -0,0 +1,390 @@
+/*! @file
+  @brief
+  Hardware abstraction layer
+        for POSIX (host build)
+
+  <pre>
+  Copyright (C) 2015- Kyushu Institute of Technology.
+  Copyright (C) 2015- Shimane IT Open-Innovation Center.
+
+  This file is distributed under BSD 3-Clause License.
+  </pre>
+*/
+
+/***** Feature test switches ************************************************/
+#define _GNU_SOURCE
+
+/***** System headers *******************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+
+/***** Local headers ********************************************************/
+#include "hal.h"
+#include "rrt0.h"
+
+/***** Constant values ******************************************************/
+/***** Macros ***************************************************************/
+/***** Typedefs *************************************************************/
+/***** Function prototypes **************************************************/
+/***** Local variables ******************************************************/
+#if !defined(MRBC_NO_TIMER)
+static pthread_mutex_t irq_mutex_;
+static pthread_cond_t tick_cond_ = PTHREAD_COND_INITIALIZER;
+static volatile uint32_t tick_count_;
+#if defined(MRBC_USE_TICKLESS)
+static volatile int flag_tickless_;	// the tick is stopped.
+static uint32_t idle_deadline_;		// tick_count_ to wake up, or 0.
+#endif
+
+// simulated UART for the console.
+static struct {
+  int baud;			// 0: not simulated.
+  int policy;			// HAL_TX_BLOCK, DROP or OVERWRITE.
+  int wake_level;		// post the event at this fill, or -1.
+  uint32_t dropped;		// num of bytes discarded.
+  uint32_t rd, wr;		// index of fifo. (wr - rd is the fill)
+  double credit;		// bytes that the line can shift out now.
+  struct timespec last;		// time when the credit was given.
+  uint8_t fifo[HAL_SIZE_TXFIFO];
+} uart_;
+#endif
+
+
+/***** Global variables *****************************************************/
+/***** Signal catching functions ********************************************/
+/***** Local functions ******************************************************/
+#if !defined(MRBC_NO_TIMER)
+//================================================================
+/*! shift out the data from the TX FIFO of the simulated UART,
+  as many as the line could send since the last call.
+
+  @note	called with interrupt disabled.
+*/
+static void uart_shift_out(void)
+{
+  struct timespec now;
+  clock_gettime( CLOCK_MONOTONIC, &now );
+
+  uint32_t fill = uart_.wr - uart_.rd;
+  if( fill == 0 ) {
+    uart_.credit = 0;		// the line is idle.
+    uart_.last = now;
+    return;
+  }
+
+  uart_.credit += ((now.tv_sec - uart_.last.tv_sec) +
+		   (now.tv_nsec - uart_.last.tv_nsec) / 1e9) * uart_.baud / 10;
+  uart_.last = now;
+
+  uint32_t n = uart_.credit < fill ? (uint32_t)uart_.credit : fill;
+  uart_.credit -= n;
+  while( n > 0 ) {
+    uint32_t idx = uart_.rd % HAL_SIZE_TXFIFO;
+    uint32_t len = HAL_SIZE_TXFIFO - idx;
+    if( len > n ) len = n;
+    if( write( 1, uart_.fifo + idx, len ) < 0 ) {}
+    uart_.rd += len;
+    n -= len;
+  }
+}
+
+
+//================================================================
+/*! wait for the line to send some data, by polling.
+
+  It works even if interrupts are disabled, like the firmware does.
+  @note	called and returns with interrupt disabled.
+*/
+static void uart_poll(void)
+{
+  struct timespec ts = { 0, 10 * 1000000000L / uart_.baud };	// 1 byte.
+
+  pthread_mutex_unlock( &irq_mutex_ );
+  nanosleep( &ts, NULL );
+  pthread_mutex_lock( &irq_mutex_ );
+  uart_shift_out();
+}
+
+
+//================================================================
+/*! TX interrupt handler of the simulated UART.
+
+  @return	posted the event or not.
+*/
+static int uart_tx_isr(void)
+{
+  uart_shift_out();
+
+  if( uart_.wake_level >= 0 &&
+      (int)(uart_.wr - uart_.rd) <= uart_.wake_level ) {
+    uart_.wake_level = -1;
+    mrbc_notify_event_from_isr( &uart_ );
+    return 1;
+  }
+  return 0;
+}
+
+
+//================================================================
+/*! send out the data through the simulated UART.
+
+  @param  buf	pointer of buffer.
+  @param  nbytes	output byte length.
+  @return	num of bytes written to the TX FIFO.
+*/
+static int uart_write(const void *buf, int nbytes)
+{
+  const uint8_t *p = buf;
+  int n = nbytes;
+
+  pthread_mutex_lock( &irq_mutex_ );
+  uart_shift_out();
+  while( n > 0 ) {
+    int room = HAL_SIZE_TXFIFO - (uart_.wr - uart_.rd);
+
+    if( room < n ) {
+      switch( uart_.policy ) {
+      case HAL_TX_DROP:
+	if( room == 0 ) {
+	  uart_.dropped += n;
+	  nbytes -= n;
+	  n = 0;
+	  continue;
+	}
+	break;
+
+      case HAL_TX_OVERWRITE:
+	// keep the newest data.
+	if( n > HAL_SIZE_TXFIFO ) {
+	  uart_.dropped += n - HAL_SIZE_TXFIFO;
+	  p += n - HAL_SIZE_TXFIFO;
+	  n = HAL_SIZE_TXFIFO;
+	}
+	if( room < n ) {
+	  uart_.rd += n - room;
+	  uart_.dropped += n - room;
+	  room = n;
+	}
+	break;
+
+      default:	// HAL_TX_BLOCK
+	if( room == 0 ) {
+	  uart_poll();
+	  continue;
+	}
+      }
+    }
+
+    if( room > n ) room = n;
+    n -= room;
+    while( room-- > 0 ) {
+      uart_.fifo[uart_.wr++ % HAL_SIZE_TXFIFO] = *p++;
+    }
+  }
+
+  // throttle the task, same as the firmware.
+  mrbc_tcb *tcb;
+  if( uart_.policy == HAL_TX_BLOCK &&
+      uart_.wr - uart_.rd > HAL_SIZE_TXFIFO * 3 / 4 &&
+      (tcb = mrbc_get_running_task()) != NULL ) {
+    uart_.wake_level = HAL_SIZE_TXFIFO / 4;
+    mrbc_wait_event( tcb, &uart_, -1 );
+  }
+  pthread_mutex_unlock( &irq_mutex_ );
+
+  return nbytes;
+}
+
+
+//================================================================
+/*! timer thread. substitute of the timer interrupt handler.
+*/
+static void * timer_thread( void *arg )
+{
+  struct timespec next;
+  clock_gettime( CLOCK_MONOTONIC, &next );
+
+  while( 1 ) {
+    next.tv_nsec += MRBC_TICK_UNIT * 1000000L;
+    if( next.tv_nsec >= 1000000000L ) {
+      next.tv_nsec -= 1000000000L;
+      next.tv_sec++;
+    }
+    clock_nanosleep( CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL );
+
+    pthread_mutex_lock( &irq_mutex_ );
+    int flag_event = uart_.baud && uart_tx_isr();
+#if defined(MRBC_USE_TICKLESS)
+    // While the tick is stopped, this thread works as the free running
+    // counter, and raises the interrupt only at the deadline.
+    if( flag_tickless_ ) {
+      tick_count_++;
+      if( flag_event ||
+	  (idle_deadline_ && (int32_t)(tick_count_ - idle_deadline_) >= 0) ) {
+        pthread_cond_broadcast( &tick_cond_ );
+      }
+      pthread_mutex_unlock( &irq_mutex_ );
+      continue;
+    }
+#else
+    (void)flag_event;	// handled by mrbc_tick().
+#endif
+    mrbc_tick();
+    tick_count_++;
+    pthread_cond_broadcast( &tick_cond_ );
+    pthread_mutex_unlock( &irq_mutex_ );
+  }
+
+  return NULL;
+}
+#endif
+
+
+/***** Global functions *****************************************************/
+#if !defined(MRBC_NO_TIMER)
+//================================================================
+/*! initialize hal. start the timer thread.
+*/
+void hal_init(void)
+{
+  pthread_mutexattr_t attr;
+  pthread_mutexattr_init( &attr );
+  pthread_mutexattr_settype( &attr, PTHREAD_MUTEX_RECURSIVE );
+  pthread_mutex_init( &irq_mutex_, &attr );
+  pthread_mutexattr_destroy( &attr );
+
+  pthread_t th;
+  if( pthread_create( &th, NULL, timer_thread, NULL ) != 0 ) {
+    hal_abort("Fatal error: Can't create timer thread.\n");
+  }
+  pthread_detach( th );
+}
+
+
+//================================================================
+/*! enable interrupt
+*/
+void hal_enable_irq(void)
+{
+  pthread_mutex_unlock( &irq_mutex_ );
+}
+
+
+//================================================================
+/*! disable interrupt
+*/
+void hal_disable_irq(void)
+{
+  pthread_mutex_lock( &irq_mutex_ );
+}
+
+
+//================================================================
+/*! wait for the next tick.
+*/
+void hal_idle_cpu(void)
+{
+  pthread_mutex_lock( &irq_mutex_ );
+  uint32_t tick = tick_count_;
+  while( tick == tick_count_ ) {
+    pthread_cond_wait( &tick_cond_, &irq_mutex_ );
+  }
+  pthread_mutex_unlock( &irq_mutex_ );
+}
+
+
+#if defined(MRBC_USE_TICKLESS)
+//================================================================
+/*! sleep without the tick.
+
+  @param  ticks	ticks to the next deadline, or 0 if no deadline.
+  @return	elapsed ticks.
+  @note	called and returns with interrupt disabled.
+*/
+uint32_t hal_idle_tickless(uint32_t ticks)
+{
+  uint32_t start = tick_count_;
+
+  idle_deadline_ = ticks ? start + ticks : 0;
+  flag_tickless_ = 1;
+  pthread_cond_wait( &tick_cond_, &irq_mutex_ );
+  flag_tickless_ = 0;
+
+  return tick_count_ - start;
+}
+#endif
+
+
+//================================================================
+/*! send the console (fd 1) through the simulated UART.
+
+  @param  baud	baud rate. 0 to write directly.
+  @param  policy	HAL_TX_BLOCK, HAL_TX_DROP or HAL_TX_OVERWRITE
+  @note	call before mrbc_init().
+*/
+void hal_uart_sim(int baud, int policy)
+{
+  uart_.baud = baud;
+  uart_.policy = policy;
+  uart_.wake_level = -1;
+  clock_gettime( CLOCK_MONOTONIC, &uart_.last );
+}
+#endif
+
+
+//================================================================
+/*! Write
+
+  @param  fd	dummy, but 1.
+  @param  buf	pointer of buffer.
+  @param  nbytes	output byte length.
+*/
+int hal_write(int fd, const void *buf, int nbytes)
+{
+#if !defined(MRBC_NO_TIMER)
+  if( uart_.baud && fd == 1 ) return uart_write(buf, nbytes);
+#endif
+  return write(fd, buf, nbytes);
+}
+
+
+//================================================================
+/*! Flush write buffer
+
+  @param  fd	dummy, but 1.
+*/
+int hal_flush(int fd)
+{
+#if !defined(MRBC_NO_TIMER)
+  if( uart_.baud ) {
+    pthread_mutex_lock( &irq_mutex_ );
+    uart_shift_out();
+    while( uart_.wr != uart_.rd ) {
+      uart_poll();
+    }
+    pthread_mutex_unlock( &irq_mutex_ );
+  }
+#endif
+  return 0;
+}
+
+
+//================================================================
+/*! abort program
+
+  @param s	additional message.
+*/
+void hal_abort(const char *s)
+{
+  hal_flush(1);
+  if( s ) {
+    write(2, s, strlen(s));
+  }
+
+  abort();
+}
@@ -0,0 +1,101 @@
+/*! @file
+  @brief
+  Hardware abstraction layer
+        for POSIX (host build)
+
+  <pre>
+  Copyright (C) 2015- Kyushu Institute of Technology.
+  Copyright (C) 2015- Shimane IT Open-Innovation Center.
+
+  This file is distributed under BSD 3-Clause License.
+
+  The tick is generated by a timer thread instead of a hardware timer.
+  Disabling interrupts is emulated by a mutex shared with the timer thread.
+  Optionally, the console (fd 1) is sent through a simulated UART, whose
+  TX interrupt is also emulated by the timer thread.
+  </pre>
+*/
+
+#ifndef MRBC_SRC_HAL_H_
+#define MRBC_SRC_HAL_H_
+
+/***** Feature test switches ************************************************/
+/***** System headers *******************************************************/
+#include <stdint.h>
+#include <unistd.h>
+
+/***** Local headers ********************************************************/
+/***** Constant values ******************************************************/
+/***** Macros ***************************************************************/
+#if !defined(MRBC_TICK_UNIT)
+#define MRBC_TICK_UNIT_1_MS   1
+#define MRBC_TICK_UNIT_2_MS   2
+#define MRBC_TICK_UNIT_4_MS   4
+#define MRBC_TICK_UNIT_10_MS 10
+#define MRBC_TICK_UNIT MRBC_TICK_UNIT_1_MS
+// Substantial timeslice value (millisecond) will be
+// MRBC_TICK_UNIT * MRBC_TIMESLICE_TICK_COUNT (+ Jitter).
+#define MRBC_TIMESLICE_TICK_COUNT 10
+#endif
+
+#if !defined(HAL_SIZE_TXFIFO)
+#define HAL_SIZE_TXFIFO 256	// TX FIFO of the simulated UART.
+#endif
+
+// what hal_write() does when the TX FIFO is full. (same as the firmware)
+#define HAL_TX_BLOCK		0	// wait, and throttle the task.
+#define HAL_TX_DROP		1	// discard the new data.
+#define HAL_TX_OVERWRITE	2	// discard the oldest data.
+
+
+/***** Typedefs *************************************************************/
+/***** Global variables *****************************************************/
+/***** Function prototypes **************************************************/
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void mrbc_tick(void);
+
+#if !defined(MRBC_NO_TIMER)	// use timer thread.
+void hal_init(void);
+void hal_enable_irq(void);
+void hal_disable_irq(void);
+void hal_idle_cpu(void);
+uint32_t hal_idle_tickless(uint32_t ticks);
+void hal_uart_sim(int baud, int policy);
+
+#else // MRBC_NO_TIMER
+# define hal_init()        ((void)0)
+# define hal_enable_irq()  ((void)0)
+# define hal_disable_irq() ((void)0)
+# define hal_idle_cpu()    (usleep(MRBC_TICK_UNIT * 1000), mrbc_tick())
+
+#endif
+
+// all bytecode is loaded to RAM on the host.
+#define hal_is_ram_address(p) 1
+
+int hal_write(int fd, const void *buf, int nbytes);
+int hal_flush(int fd);
+void hal_abort(const char *s);
+
+
+/***** Inline functions *****************************************************/
+#if defined(MRBC_NO_TIMER)
+//================================================================
+/*! sleep the ticks to the next deadline. (at least 1 tick)
+*/
+static inline uint32_t hal_idle_tickless(uint32_t ticks)
+{
+  if( ticks == 0 ) ticks = 1;
+  usleep( ticks * MRBC_TICK_UNIT * 1000 );
+  return ticks;
+}
+#endif
+
+
+#ifdef __cplusplus
+}
+#endif
+#endif // ifndef MRBC_SRC_HAL_H_
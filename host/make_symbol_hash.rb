@@ -0,0 +1,83 @@
+#!/usr/bin/env ruby
+#
+# Generate the perfect hash table of the built-in symbols.
+#
+#  usage: ruby make_symbol_hash.rb ../src/_autogen_builtin_symbol.h > ../src/_autogen_builtin_symbol_hash.h
+#
+# The hash function must be the same as calc_hash() in src/symbol.c (FNV-1a).
+# slot = ((h >> 6) + disp[h & (N_BUCKET-1)] * ((h >> 15) | 1)) & (N_SLOT-1)
+#
+
+N_BUCKET = 64
+N_SLOT = 512
+MASK32 = 0xffffffff
+
+def calc_hash( str )
+  h = 2166136261
+  str.each_byte {|b|
+    h ^= b
+    h = (h * 16777619) & MASK32
+  }
+  h
+end
+
+def slot_of( h, d )
+  (((h >> 6) + d * ((h >> 15) | 1)) & MASK32) & (N_SLOT-1)
+end
+
+
+symbols = []
+File.foreach( ARGV[0] || "../src/_autogen_builtin_symbol.h" ) {|line|
+  if /^\s+"(.*)",\s*\/\/ MRBC_SYMID_\w+ = (\d+)/ =~ line
+    symbols[$2.to_i] = $1
+  end
+}
+n_symbols = symbols.size
+raise "too many symbols." if n_symbols > 256 || n_symbols * 2 > N_SLOT
+
+# assign displacements, larger bucket first.
+buckets = Array.new(N_BUCKET) { [] }
+(1...n_symbols).each {|id|
+  h = calc_hash( symbols[id] )
+  buckets[h & (N_BUCKET-1)] << [id, h]
+}
+
+disp = Array.new(N_BUCKET, 0)
+table = Array.new(N_SLOT, 0)
+buckets.each_with_index.sort_by {|b,i| [-b.size, i] }.each {|b,i|
+  next if b.empty?
+  d = (0..255).find {|d|
+    slots = b.map {|id,h| slot_of(h, d) }
+    slots.uniq.size == slots.size && slots.all? {|s| table[s] == 0 }
+  }
+  raise "can't make perfect hash." if !d
+  disp[i] = d
+  b.each {|id,h| table[slot_of(h, d)] = id }
+}
+
+
+puts <<EOS
+/* Auto generated by make_symbol_hash.rb */
+#ifndef MRBC_SRC_AUTOGEN_BUILTIN_SYMBOL_HASH_H_
+#define MRBC_SRC_AUTOGEN_BUILTIN_SYMBOL_HASH_H_
+
+#define MRBC_BUILTIN_SYMBOL_COUNT #{n_symbols}
+#define MRBC_BUILTIN_SYMBOL_BUCKETS #{N_BUCKET}
+#define MRBC_BUILTIN_SYMBOL_SLOTS #{N_SLOT}
+
+#if defined(MRBC_DEFINE_SYMBOL_TABLE)
+static const uint8_t builtin_symbol_disp[MRBC_BUILTIN_SYMBOL_BUCKETS] = {
+EOS
+disp.each_slice(16) {|a| puts "  " + a.join(", ") + "," }
+puts <<EOS
+};
+
+static const uint8_t builtin_symbol_slot[MRBC_BUILTIN_SYMBOL_SLOTS] = {
+EOS
+table.each_slice(16) {|a| puts "  " + a.join(", ") + "," }
+puts <<EOS
+};
+#endif
+
+#endif
+EOS
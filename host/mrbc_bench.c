@@ -0,0 +1,279 @@
+/*! @file
+  @brief
+  Benchmark runner for the host build.
+
+  <pre>
+  Copyright (C) 2015- Kyushu Institute of Technology.
+  Copyright (C) 2015- Shimane IT Open-Innovation Center.
+
+  This file is distributed under BSD 3-Clause License.
+
+  Usage: mrbc_bench [-r repeat] [-m heap_size_kb] [-s scratch_kb]
+		    [-u baud [-t tx_policy]] [-v] file.mrb ...
+
+  Runs each .mrb file as a task on a freshly initialized heap, and reports
+  time to load (create the task), executed instructions, instructions/sec,
+  number of allocations, peak heap usage and maximum depth of method calls.
+  The time is the best of repeated runs. Pre-linked images (.mrbi) made by
+  mrbc_image can be given as well as .mrb.
+  </pre>
+*/
+
+/***** Feature test switches ************************************************/
+#define _GNU_SOURCE
+
+/***** System headers *******************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+/***** Local headers ********************************************************/
+#include "mrubyc.h"
+
+/***** Constant values ******************************************************/
+#if !defined(MRBC_MEMORY_SIZE)
+#define MRBC_MEMORY_SIZE (1024*40)	// same as the firmware.
+#endif
+
+
+/***** Macros ***************************************************************/
+/***** Typedefs *************************************************************/
+//================================================================
+/*!@brief
+  Result of a benchmark.
+*/
+struct BENCH_RESULT {
+  int ret;			//!< return value of mrbc_run()
+  double sec;			//!< elapsed time (best)
+  double load_sec;		//!< time to create the task (best)
+  unsigned long long n_inst;	//!< num of executed instructions.
+  unsigned long n_alloc;	//!< num of allocations.
+  unsigned long peak;		//!< peak heap usage.
+  unsigned long remain;		//!< heap usage after run.
+  unsigned int heap_size;	//!< heap size.
+  unsigned int depth;		//!< max depth of method calls.
+};
+
+
+/***** Function prototypes **************************************************/
+/***** Local variables ******************************************************/
+static uint8_t *memory_pool;
+static unsigned int memory_size = MRBC_MEMORY_SIZE;
+static unsigned int scratch_size;
+
+
+/***** Global variables *****************************************************/
+/***** Signal catching functions ********************************************/
+/***** Local functions ******************************************************/
+//================================================================
+/*! load .mrb file
+
+  @param  filename	file name.
+  @return		pointer to allocated buffer or NULL.
+*/
+static uint8_t * load_mrb_file( const char *filename )
+{
+  FILE *fp = fopen(filename, "rb");
+  if( fp == NULL ) {
+    fprintf(stderr, "File not found (%s)\n", filename);
+    return NULL;
+  }
+
+  fseek(fp, 0, SEEK_END);
+  long size = ftell(fp);
+  fseek(fp, 0, SEEK_SET);
+
+  uint8_t *p = malloc(size);
+  if( p != NULL && fread(p, sizeof(uint8_t), size, fp) != size ) {
+    free(p);
+    p = NULL;
+  }
+  fclose(fp);
+
+  if( p == NULL ) fprintf(stderr, "Read error (%s)\n", filename);
+  return p;
+}
+
+
+//================================================================
+/*! get monotonic time in sec.
+*/
+static double now_sec( void )
+{
+  struct timespec ts;
+  clock_gettime( CLOCK_MONOTONIC, &ts );
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+//================================================================
+/*! run the bytecode once on a fresh heap.
+
+  @param  bytecode	.mrb image.
+  @param  flag_prof	measure the memory usage.
+  @param  res		result.
+*/
+static void run_once( const uint8_t *bytecode, int flag_prof, struct BENCH_RESULT *res )
+{
+  mrbc_cleanup();
+  mrbc_init( memory_pool, memory_size );
+
+  double t = now_sec();
+  mrbc_tcb *tcb = mrbc_create_task( bytecode, 0 );
+  t = now_sec() - t;
+  if( tcb == NULL ) {
+    res->ret = -1;
+    return;
+  }
+  if( res->load_sec == 0 || t < res->load_sec ) res->load_sec = t;
+  if( scratch_size && mrbc_set_scratch_arena( tcb, scratch_size ) != 0 ) {
+    res->ret = -1;
+    return;
+  }
+
+#if defined(MRBC_COUNT_INSTRUCTIONS)
+  mrbc_instruction_count = 0;
+#endif
+#if defined(MRBC_USE_ALLOC_PROF)
+  if( flag_prof ) mrbc_alloc_start_profiling();
+#endif
+
+  double t0 = now_sec();
+  res->ret = mrbc_run();
+  double t1 = now_sec();
+  hal_flush(1);
+
+  if( flag_prof ) {
+#if defined(MRBC_USE_ALLOC_PROF)
+    struct MRBC_ALLOC_PROF prof;
+    mrbc_alloc_stop_profiling();
+    mrbc_alloc_get_profiling( &prof );
+    res->n_alloc = prof.n_alloc;
+    res->peak = prof.max;
+#endif
+    struct MRBC_ALLOC_STATISTICS stat;
+    mrbc_alloc_statistics( &stat );
+    res->remain = stat.used;
+    res->heap_size = stat.total;
+  } else {
+    if( res->sec == 0 || (t1 - t0) < res->sec ) res->sec = t1 - t0;
+  }
+
+#if defined(MRBC_COUNT_INSTRUCTIONS)
+  res->n_inst = mrbc_instruction_count;
+#endif
+  res->depth = tcb->vm.callinfo_max_depth;
+}
+
+
+//================================================================
+/*! print usage
+*/
+static void usage( const char *argv0 )
+{
+  fprintf(stderr, "Usage: %s [-r repeat] [-m heap_size_kb] [-s scratch_kb] [-u baud [-t tx_policy]] [-v] file.mrb ...\n", argv0);
+  fprintf(stderr, "  -r n   run each file n times and take the best time. (default 3)\n");
+  fprintf(stderr, "  -m n   heap size in KiB. (default %d)\n", MRBC_MEMORY_SIZE / 1024);
+  fprintf(stderr, "  -s n   give the task a scratch arena of n KiB.\n");
+#if !defined(MRBC_NO_TIMER)
+  fprintf(stderr, "  -u n   send the output through a simulated UART of n baud.\n");
+  fprintf(stderr, "  -t p   when the UART buffer is full, block, drop or overwrite. (default block)\n");
+#endif
+  fprintf(stderr, "  -v     show output of the programs.\n");
+}
+
+
+/***** Global functions *****************************************************/
+//================================================================
+/*! main
+*/
+int main( int argc, char *argv[] )
+{
+  int repeat = 3;
+  int flag_verbose = 0;
+  int baud = 0;
+  int tx_policy = -1;
+  int opt;
+
+  while( (opt = getopt(argc, argv, "r:m:s:u:t:vh")) != -1 ) {
+    switch( opt ) {
+    case 'r': repeat = atoi(optarg);		break;
+    case 'm': memory_size = atoi(optarg) * 1024;	break;
+    case 's': scratch_size = atoi(optarg) * 1024;	break;
+    case 'u': baud = atoi(optarg);		break;
+    case 't':
+      tx_policy = !strcmp(optarg, "block") ? HAL_TX_BLOCK :
+		  !strcmp(optarg, "drop") ? HAL_TX_DROP :
+		  !strcmp(optarg, "overwrite") ? HAL_TX_OVERWRITE : -2;
+      break;
+    case 'v': flag_verbose = 1;			break;
+    default:  usage(argv[0]);			return 1;
+    }
+  }
+  if( optind >= argc || repeat < 1 || memory_size == 0 ||
+      baud < 0 || tx_policy == -2 ) {
+    usage(argv[0]);
+    return 1;
+  }
+#if !defined(MRBC_NO_TIMER)
+  if( baud ) hal_uart_sim( baud, tx_policy < 0 ? HAL_TX_BLOCK : tx_policy );
+#endif
+
+  memory_pool = malloc( memory_size );
+  if( !memory_pool ) return 1;
+
+  // the programs output to fd 1, report to stdout (saved).
+  FILE *report = fdopen( dup(1), "w" );
+  if( !flag_verbose ) {
+    int fd = open("/dev/null", O_WRONLY);
+    dup2( fd, 1 );
+    close( fd );
+  }
+
+  fprintf(report, "# dispatch: %s\n",
+#if defined(MRBC_USE_THREADED_CODE)
+	  "threaded"
+#else
+	  "switch"
+#endif
+	  );
+  fprintf(report, "%-24s %9s %10s %12s %10s %10s %10s %10s %6s\n", "file",
+	  "load(us)", "time(ms)", "inst", "Minst/s", "n_alloc", "peak(B)",
+	  "remain(B)", "depth");
+
+  int ret = 0;
+  for( int i = optind; i < argc; i++ ) {
+    uint8_t *bytecode = load_mrb_file( argv[i] );
+    if( !bytecode ) {
+      ret = 1;
+      continue;
+    }
+
+    struct BENCH_RESULT res = {0};
+    run_once( bytecode, 1, &res );	// measure memory.
+    for( int n = 0; n < repeat && res.ret == 0; n++ ) {
+      run_once( bytecode, 0, &res );	// measure time.
+    }
+    free( bytecode );
+
+    const char *name = strrchr( argv[i], '/' );
+    name = name ? name + 1 : argv[i];
+    if( res.ret != 0 ) {
+      fprintf(report, "%-24s error (%d)\n", name, res.ret);
+      ret = 1;
+      continue;
+    }
+
+    fprintf(report, "%-24s %9.2f %10.3f %12llu %10.2f %10lu %10lu %10lu %6u\n",
+	    name, res.load_sec * 1e6, res.sec * 1000, res.n_inst,
+	    res.sec > 0 ? res.n_inst / res.sec / 1e6 : 0.0,
+	    res.n_alloc, res.peak, res.remain, res.depth );
+    fflush( report );
+  }
+
+  free( memory_pool );
+  return ret;
+}
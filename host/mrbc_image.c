@@ -0,0 +1,362 @@
+/*! @file
+  @brief
+  Make a pre-linked image from .mrb file.
+
+  <pre>
+  Copyright (C) 2015- Kyushu Institute of Technology.
+  Copyright (C) 2015- Shimane IT Open-Innovation Center.
+
+  This file is distributed under BSD 3-Clause License.
+
+  Usage: mrbc_image [-o output] [-B symbol] file.mrb
+
+  The image holds the flattened mrbc_irep tree with the built-in symbol
+  IDs resolved, and a relocation table for pointers and other symbols.
+  mrbc_load_mrb() built with MRBC_USE_IMAGE loads it by a copy and
+  relocation, without parsing the RITE binary. (see load.h)
+
+  The layout of mrbc_irep depends on the target. Build this tool with
+  the same vm_config.h and the same pointer size as the target.
+  (e.g. -m32 for PIC32)
+  </pre>
+*/
+
+/***** Feature test switches ************************************************/
+/***** System headers *******************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <unistd.h>
+
+/***** Local headers ********************************************************/
+#include "mrubyc.h"
+#include "_autogen_builtin_symbol_hash.h"
+
+/***** Constant values ******************************************************/
+#if !defined(MRBC_IREP_SINGLE_BLOCK)
+#error "mrbc_image needs MRBC_IREP_SINGLE_BLOCK."
+#endif
+
+#define MEMORY_SIZE (1024*256)
+#define SIZE_RITE_BINARY_HEADER 20
+#define SIZE_RITE_SECTION_HEADER 12
+
+
+/***** Macros ***************************************************************/
+/***** Typedefs *************************************************************/
+/***** Function prototypes **************************************************/
+/***** Local variables ******************************************************/
+static uint8_t memory_pool[MEMORY_SIZE];
+
+static const uint8_t *top;		// top irep in the VM.
+static const uint8_t *code;		// IREP records in the .mrb
+static uint8_t *ireps;			// copy of the mrbc_irep block.
+
+static struct MRBC_IMAGE_RELOC *relocs;
+static int n_relocs;
+static const char **symbols;
+static int n_symbols;
+
+
+/***** Global variables *****************************************************/
+/***** Signal catching functions ********************************************/
+/***** Local functions ******************************************************/
+//================================================================
+/*! load .mrb file
+
+  @param  filename	file name.
+  @param  size		returns file size.
+  @return		pointer to allocated buffer or NULL.
+*/
+static uint8_t * load_mrb_file( const char *filename, long *size )
+{
+  FILE *fp = fopen(filename, "rb");
+  if( fp == NULL ) {
+    fprintf(stderr, "File not found (%s)\n", filename);
+    return NULL;
+  }
+
+  fseek(fp, 0, SEEK_END);
+  *size = ftell(fp);
+  fseek(fp, 0, SEEK_SET);
+
+  uint8_t *p = malloc(*size);
+  if( p != NULL && fread(p, sizeof(uint8_t), *size, fp) != *size ) {
+    free(p);
+    p = NULL;
+  }
+  fclose(fp);
+
+  if( p == NULL ) fprintf(stderr, "Read error (%s)\n", filename);
+  return p;
+}
+
+
+//================================================================
+/*! search IREP section.
+
+  @param  bin		.mrb image.
+  @param  size		size of image.
+  @param  sec_size	returns size of the section.
+  @return		pointer to the section or NULL.
+*/
+static const uint8_t * search_irep_section( const uint8_t *bin, long size, uint32_t *sec_size )
+{
+  const uint8_t *p = bin + SIZE_RITE_BINARY_HEADER;
+
+  while( p + 8 <= bin + size ) {
+    *sec_size = (uint32_t)p[4] << 24 | p[5] << 16 | p[6] << 8 | p[7];
+    if( memcmp(p, "IREP", 4) == 0 ) return p;
+    if( memcmp(p, "END\0", 4) == 0 || *sec_size == 0 ) break;
+    p += *sec_size;
+  }
+
+  return NULL;
+}
+
+
+//================================================================
+/*! size of one mrbc_irep. (same as calc_irep_size() in load.c)
+*/
+static uint32_t irep_size( const mrbc_irep *irep )
+{
+  return sizeof(mrbc_irep) + irep->ofs_ireps + sizeof(mrbc_irep *) * irep->rlen;
+}
+
+
+//================================================================
+/*! size of the mrbc_irep block. (end of the last irep)
+*/
+static uint32_t irep_block_size( const mrbc_irep *irep )
+{
+  uint32_t siz = (const uint8_t *)irep - top + irep_size(irep);
+
+  for( int i = 0; i < irep->rlen; i++ ) {
+    uint32_t siz1 = irep_block_size( mrbc_irep_child_irep(irep, i) );
+    if( siz < siz1 ) siz = siz1;
+  }
+
+  return siz;
+}
+
+
+//================================================================
+/*! add relocation entry.
+*/
+static void add_reloc( uint32_t offset, int type, int index )
+{
+  relocs = realloc( relocs, sizeof(*relocs) * (n_relocs + 1) );
+  relocs[n_relocs].offset = offset;
+  relocs[n_relocs].type = type;
+  relocs[n_relocs].index = index;
+  n_relocs++;
+}
+
+
+//================================================================
+/*! get index of symbol name, or add it.
+*/
+static int symbol_index( const char *str )
+{
+  for( int i = 0; i < n_symbols; i++ ) {
+    if( strcmp(symbols[i], str) == 0 ) return i;
+  }
+
+  symbols = realloc( symbols, sizeof(*symbols) * (n_symbols + 1) );
+  symbols[n_symbols] = str;
+  return n_symbols++;
+}
+
+
+//================================================================
+/*! make relocation entries and offsets of one irep, and children.
+*/
+static void relocate_irep( const mrbc_irep *irep )
+{
+  uint32_t ofs = (const uint8_t *)irep - top;
+  mrbc_irep *dst = (mrbc_irep *)(ireps + ofs);
+
+  dst->ref_count = 0;
+  dst->inst = (const uint8_t *)(uintptr_t)(irep->inst - code);
+  add_reloc( ofs + offsetof(mrbc_irep, inst), MRBC_IMAGE_RELOC_CODE, 0 );
+  dst->pool = (const uint8_t *)(uintptr_t)(irep->pool - code);
+  add_reloc( ofs + offsetof(mrbc_irep, pool), MRBC_IMAGE_RELOC_CODE, 0 );
+
+  // symbols. built-in symbols have the same ID in the target.
+  int slen = irep->ofs_pools / sizeof(mrbc_sym);
+  for( int i = 0; i < slen; i++ ) {
+    mrbc_sym sym_id = mrbc_irep_symbol_id(irep, i);
+    if( sym_id < MRBC_BUILTIN_SYMBOL_COUNT ) continue;
+
+    mrbc_irep_symbol_id(dst, i) = 0;
+    add_reloc( ofs + offsetof(mrbc_irep, data) + sizeof(mrbc_sym) * i,
+	       MRBC_IMAGE_RELOC_SYMBOL,
+	       symbol_index( mrbc_symid_to_str(sym_id) ));
+  }
+
+  // instance variable names without '@'.
+  for( int i = 0; irep->ofs_ivars && i < slen; i++ ) {
+    mrbc_sym sym_id = mrbc_irep_ivar_id(irep, i);
+    if( sym_id < MRBC_BUILTIN_SYMBOL_COUNT ) continue;
+
+    mrbc_irep_ivar_id(dst, i) = 0;
+    add_reloc( ofs + offsetof(mrbc_irep, data) + irep->ofs_ivars +
+	       sizeof(mrbc_sym) * i, MRBC_IMAGE_RELOC_SYMBOL,
+	       symbol_index( mrbc_symid_to_str(sym_id) ));
+  }
+
+  // child ireps.
+  for( int i = 0; i < irep->rlen; i++ ) {
+    const mrbc_irep *child = mrbc_irep_child_irep(irep, i);
+    mrbc_irep_child_irep(dst, i) =
+      (mrbc_irep *)(uintptr_t)((const uint8_t *)child - top);
+    add_reloc( ofs + offsetof(mrbc_irep, data) + irep->ofs_ireps +
+	       sizeof(mrbc_irep *) * i, MRBC_IMAGE_RELOC_IREP, 0 );
+    relocate_irep( child );
+  }
+}
+
+
+//================================================================
+/*! compare relocation entries. (symbols are sorted by name index)
+*/
+static int compare_reloc( const void *a, const void *b )
+{
+  const struct MRBC_IMAGE_RELOC *r1 = a, *r2 = b;
+
+  if( r1->type != r2->type ) return r1->type - r2->type;
+  if( r1->index != r2->index ) return r1->index - r2->index;
+  return (r1->offset > r2->offset) - (r1->offset < r2->offset);
+}
+
+
+//================================================================
+/*! write the image as binary, or C source.
+*/
+static int write_image( const char *filename, const char *c_symbol,
+			const uint8_t *img, uint32_t size )
+{
+  FILE *fp = filename ? fopen(filename, "wb") : stdout;
+  if( fp == NULL ) {
+    fprintf(stderr, "Can't open file (%s)\n", filename);
+    return 1;
+  }
+
+  if( !c_symbol ) {
+    fwrite( img, 1, size, fp );
+  } else {
+    fprintf(fp, "#include <stdint.h>\n");
+    fprintf(fp, "const uint8_t %s[] = {", c_symbol);
+    for( uint32_t i = 0; i < size; i++ ) {
+      fprintf(fp, "%s0x%02x,", (i % 16) ? "" : "\n", img[i]);
+    }
+    fprintf(fp, "\n};\n");
+  }
+
+  if( fp != stdout ) fclose(fp);
+  return 0;
+}
+
+
+//================================================================
+/*! print usage
+*/
+static void usage( const char *argv0 )
+{
+  fprintf(stderr, "Usage: %s [-o output] [-B symbol] file.mrb\n", argv0);
+  fprintf(stderr, "  -o file    output file. (default stdout)\n");
+  fprintf(stderr, "  -B symbol  output C source with the array name.\n");
+}
+
+
+/***** Global functions *****************************************************/
+//================================================================
+/*! main
+*/
+int main( int argc, char *argv[] )
+{
+  const char *output = 0;
+  const char *c_symbol = 0;
+  int opt;
+
+  while( (opt = getopt(argc, argv, "o:B:h")) != -1 ) {
+    switch( opt ) {
+    case 'o': output = optarg;		break;
+    case 'B': c_symbol = optarg;	break;
+    default:  usage(argv[0]);		return 1;
+    }
+  }
+  if( optind + 1 != argc ) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  long mrb_size;
+  uint8_t *mrb = load_mrb_file( argv[optind], &mrb_size );
+  if( !mrb ) return 1;
+
+  uint32_t sec_size;
+  const uint8_t *sec = search_irep_section( mrb, mrb_size, &sec_size );
+  if( !sec ) {
+    fprintf(stderr, "IREP section not found (%s)\n", argv[optind]);
+    return 1;
+  }
+  code = sec + SIZE_RITE_SECTION_HEADER;
+  uint32_t code_size = sec_size - SIZE_RITE_SECTION_HEADER;
+
+  // load with the VM, and take the mrbc_irep block.
+  mrbc_init( memory_pool, MEMORY_SIZE );
+  mrbc_vm *vm = mrbc_vm_open( mrbc_vm_new( MAX_REGS_SIZE ));
+  if( !vm ) return 1;
+  vm->flag_no_superinstruction = 1;	// the code is referenced in place.
+  if( mrbc_load_mrb( vm, mrb ) != 0 ) {
+    mrbc_print_vm_exception( vm );
+    return 1;
+  }
+  top = (const uint8_t *)vm->top_irep;
+
+  uint32_t size_ireps = irep_block_size( vm->top_irep );
+  ireps = malloc( size_ireps );
+  memcpy( ireps, top, size_ireps );
+  relocate_irep( vm->top_irep );
+  qsort( relocs, n_relocs, sizeof(*relocs), compare_reloc );
+
+  uint32_t size_symbols = 0;
+  for( int i = 0; i < n_symbols; i++ ) {
+    size_symbols += strlen(symbols[i]) + 1;
+  }
+
+  // make the image.
+  struct MRBC_IMAGE_HEADER hdr = {
+    .ident = MRBC_IMAGE_IDENT,
+    .version = MRBC_IMAGE_VERSION,
+    .sizeof_ptr = sizeof(void *),
+    .sizeof_irep = sizeof(mrbc_irep),
+    .n_builtin_symbols = MRBC_BUILTIN_SYMBOL_COUNT,
+    .n_symbols = n_symbols,
+    .n_relocs = n_relocs,
+    .size_ireps = size_ireps,
+  };
+  hdr.ofs_ireps = sizeof(hdr);
+  hdr.ofs_relocs = hdr.ofs_ireps + size_ireps;
+  hdr.ofs_symbols = hdr.ofs_relocs + sizeof(*relocs) * n_relocs;
+  hdr.ofs_code = hdr.ofs_symbols + size_symbols;
+  hdr.size = hdr.ofs_code + code_size;
+
+  uint8_t *img = malloc( hdr.size );
+  uint8_t *p = img;
+  memcpy( p, &hdr, sizeof(hdr) );			p += sizeof(hdr);
+  memcpy( p, ireps, size_ireps );			p += size_ireps;
+  memcpy( p, relocs, sizeof(*relocs) * n_relocs );	p += sizeof(*relocs) * n_relocs;
+  for( int i = 0; i < n_symbols; i++ ) {
+    int len = strlen(symbols[i]) + 1;
+    memcpy( p, symbols[i], len );			p += len;
+  }
+  memcpy( p, code, code_size );
+
+  fprintf(stderr, "%s: %u bytes. ireps %u, relocs %d, symbols %d\n",
+	  argv[optind], hdr.size, size_ireps, n_relocs, n_symbols);
+
+  return write_image( output, c_symbol, img, hdr.size );
+}
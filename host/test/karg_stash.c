@@ -0,0 +1,108 @@
+/*! @file
+  @brief
+  Regression test: the keyword argument stash must not overwrite the
+  registers of any caller.
+
+  <pre>
+  Copyright (C) 2015- Kyushu Institute of Technology.
+  Copyright (C) 2015- Shimane IT Open-Innovation Center.
+
+  This file is distributed under BSD 3-Clause License.
+
+  The top level uses 109 of MAX_REGS_SIZE (110) registers and keeps a
+  String in the last one. m1 uses few registers and calls k(x: 7), so the
+  stash is placed where the top level's registers are. It must raise
+  "MAX_REGS_SIZE overflow" and leave the String alone.
+  </pre>
+*/
+
+/***** System headers *******************************************************/
+#include <stdio.h>
+#include <string.h>
+
+/***** Local headers ********************************************************/
+#include "mrubyc.h"
+
+/***** Constant values ******************************************************/
+#define MEMORY_SIZE (1024*40)
+
+/*
+  def k(x:)		# nregs 4
+    ENTER	0x000004
+    KARG	R1, :x
+    KEYEND
+    RETURN	R1
+
+  def m1		# nregs 4
+    ENTER	0x000000
+    LOADSYM	R2, :x
+    LOADI_7	R3
+    SSEND	R1, :k, 0x10	# k(x: 7)
+    RETURN	R1
+
+  top level		# nregs 109
+    TCLASS	R1
+    METHOD	R2, I(0)
+    DEF	R1, :k
+    TCLASS	R1
+    METHOD	R2, I(1)
+    DEF	R1, :m1
+    STRING	R108, "keep"
+    SSEND	R1, :m1, 0
+    STOP
+*/
+static const uint8_t bytecode[] = {
+  0x52, 0x49, 0x54, 0x45, 0x30, 0x33, 0x30, 0x30, 0x00, 0x00, 0x00, 0xb2,
+  0x4d, 0x41, 0x54, 0x5a, 0x30, 0x30, 0x30, 0x30, 0x49, 0x52, 0x45, 0x50,
+  0x00, 0x00, 0x00, 0x96, 0x30, 0x33, 0x30, 0x30, 0x00, 0x00, 0x00, 0x3d,
+  0x00, 0x01, 0x00, 0x6d, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x18,
+  0x63, 0x01, 0x58, 0x02, 0x00, 0x5f, 0x01, 0x00, 0x63, 0x01, 0x58, 0x02,
+  0x01, 0x5f, 0x01, 0x01, 0x51, 0x6c, 0x00, 0x2d, 0x01, 0x01, 0x00, 0x69,
+  0x00, 0x01, 0x00, 0x00, 0x04, 0x6b, 0x65, 0x65, 0x70, 0x00, 0x00, 0x02,
+  0x00, 0x01, 0x6b, 0x00, 0x00, 0x02, 0x6d, 0x31, 0x00, 0x00, 0x00, 0x00,
+  0x22, 0x00, 0x01, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x0a, 0x34, 0x00, 0x00, 0x04, 0x37, 0x01, 0x00, 0x36, 0x38, 0x01, 0x00,
+  0x00, 0x00, 0x01, 0x00, 0x01, 0x78, 0x00, 0x00, 0x00, 0x00, 0x2b, 0x00,
+  0x01, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0f, 0x34,
+  0x00, 0x00, 0x00, 0x10, 0x02, 0x00, 0x0d, 0x03, 0x2d, 0x01, 0x01, 0x10,
+  0x38, 0x01, 0x00, 0x00, 0x00, 0x02, 0x00, 0x01, 0x78, 0x00, 0x00, 0x01,
+  0x6b, 0x00, 0x45, 0x4e, 0x44, 0x00, 0x00, 0x00, 0x00, 0x08,
+};
+
+
+/***** Local variables ******************************************************/
+static uint8_t memory_pool[MEMORY_SIZE];
+
+
+/***** Global functions *****************************************************/
+int main( void )
+{
+  mrbc_init( memory_pool, MEMORY_SIZE );
+  mrbc_vm *vm = mrbc_vm_open( mrbc_vm_new( MAX_REGS_SIZE ));
+  if( !vm || mrbc_load_mrb( vm, bytecode ) != 0 ) {
+    printf("NG: can't load.\n");
+    return 1;
+  }
+
+  mrbc_vm_begin( vm );
+  mrbc_vm_run( vm );
+
+  int ret = 0;
+  mrbc_value *keep = &vm->regs[108];
+  if( keep->tt != MRBC_TT_STRING || strcmp( mrbc_string_cstr(keep), "keep" ) != 0 ) {
+    printf("NG: the register of the top level was overwritten.\n");
+    ret = 1;
+  }
+  if( !mrbc_israised(vm) ) {
+    printf("NG: MAX_REGS_SIZE overflow was not raised.\n");
+    ret = 1;
+  }
+  if( ret == 0 ) printf("OK: karg_stash\n");
+
+  mrbc_decref( &vm->exception );
+  vm->exception = mrbc_nil_value();
+  mrbc_vm_end( vm );
+  mrbc_vm_close( vm );
+
+  return ret;
+}
@@ -168,7 +168,7 @@ static int i2c_write_mrbc_value( const mrbc_value *v, int *n_of_out_bytes )
     break;
 
   case MRBC_TT_STRING: {
-    const char *p = mrbc_string_cstr(v);
+    const char *p = mrbc_string_ptr(v);
     for( int i = 0; i < mrbc_string_size(v); i++ ) {
       ret = i2c_write_byte( *p++ );
       if( ret != 0 ) break;
@@ -55,6 +55,7 @@ int hal_write(int fd, const void *buf, int nbytes) {
 }
 
 int hal_flush(int fd) {
+  uart_flush( UART_HANDLE_CONSOLE );
   return 0;
 }
 
@@ -63,6 +64,7 @@ void hal_abort( const char *s )
   if( s ) {
     hal_write( 0, s, strlen(s) );
   }
+  uart_flush( UART_HANDLE_CONSOLE );
   __delay_ms(5000);
   system_reset();
 }
@@ -36,6 +36,7 @@ static uint8_t *irep_write_addr_ = (uint8_t*)FLASH_SAVE_ADDR;
 #define STRM_PUTS(buf)       uart_puts(UART_HANDLE_CONSOLE, buf)
 #define STRM_RESET()         uart_clear_rx_buffer(UART_HANDLE_CONSOLE)
 #define SYSTEM_RESET()       do { \
+  uart_flush(UART_HANDLE_CONSOLE); \
   __builtin_disable_interrupts(); \
   system_reset(); \
 } while(0)
@@ -249,7 +249,7 @@ static int spi_trans_mrbc_value( const SPI_HANDLE *hndl, const mrbc_value *v,
       if( mrbc_string_append_cbuf( ret, NULL, len1 ) != 0 ) break;
       recv = mrbc_string_cstr(ret) + len2;
     }
-    spi_transfer( hndl, mrbc_string_cstr(v), len1, recv, len1, 1 );
+    spi_transfer( hndl, mrbc_string_ptr(v), len1, recv, len1, 1 );
   } break;
 
   default:
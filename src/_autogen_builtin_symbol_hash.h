@@ -0,0 +1,53 @@
+/* Auto generated by make_symbol_hash.rb */
+#ifndef MRBC_SRC_AUTOGEN_BUILTIN_SYMBOL_HASH_H_
+#define MRBC_SRC_AUTOGEN_BUILTIN_SYMBOL_HASH_H_
+
+#define MRBC_BUILTIN_SYMBOL_COUNT 228
+#define MRBC_BUILTIN_SYMBOL_BUCKETS 64
+#define MRBC_BUILTIN_SYMBOL_SLOTS 512
+
+#if defined(MRBC_DEFINE_SYMBOL_TABLE)
+static const uint8_t builtin_symbol_disp[MRBC_BUILTIN_SYMBOL_BUCKETS] = {
+  0, 2, 3, 2, 0, 2, 0, 0, 2, 1, 6, 0, 1, 0, 0, 0,
+  0, 0, 0, 0, 1, 3, 1, 2, 4, 0, 5, 0, 0, 8, 2, 2,
+  0, 0, 3, 2, 4, 0, 7, 4, 3, 1, 0, 0, 4, 0, 0, 0,
+  1, 0, 2, 0, 4, 0, 0, 5, 0, 0, 6, 0, 0, 0, 0, 2,
+};
+
+static const uint8_t builtin_symbol_slot[MRBC_BUILTIN_SYMBOL_SLOTS] = {
+  0, 29, 0, 111, 0, 76, 0, 0, 61, 54, 183, 102, 0, 66, 2, 0,
+  116, 0, 110, 0, 0, 0, 0, 129, 108, 117, 0, 87, 157, 0, 3, 0,
+  126, 0, 60, 132, 0, 208, 0, 0, 133, 0, 0, 0, 0, 73, 0, 94,
+  0, 4, 139, 0, 0, 0, 0, 0, 0, 0, 24, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 216, 0, 47, 159, 58, 0, 187, 174, 0,
+  9, 0, 0, 35, 0, 0, 214, 0, 160, 124, 0, 0, 40, 210, 0, 0,
+  79, 223, 0, 200, 14, 0, 0, 0, 0, 0, 0, 13, 0, 212, 0, 100,
+  64, 0, 221, 74, 0, 0, 7, 0, 81, 154, 150, 143, 5, 0, 0, 0,
+  0, 0, 0, 65, 176, 0, 0, 0, 0, 217, 0, 0, 0, 180, 203, 11,
+  45, 53, 0, 0, 0, 0, 215, 80, 0, 98, 0, 1, 99, 0, 59, 0,
+  0, 0, 0, 97, 0, 0, 123, 0, 0, 188, 189, 171, 0, 0, 0, 0,
+  107, 0, 0, 0, 162, 121, 0, 75, 103, 26, 181, 12, 0, 0, 0, 0,
+  0, 191, 0, 0, 0, 0, 0, 0, 18, 0, 0, 68, 151, 0, 0, 115,
+  63, 0, 169, 44, 0, 52, 21, 0, 0, 82, 0, 0, 0, 185, 55, 85,
+  112, 0, 57, 0, 219, 0, 93, 0, 0, 56, 0, 0, 69, 0, 125, 197,
+  71, 130, 0, 202, 0, 38, 145, 175, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 192, 0, 91, 0, 0, 128, 201, 168, 0, 0, 0, 70, 0, 34, 165,
+  0, 161, 196, 0, 0, 158, 0, 0, 90, 184, 0, 0, 0, 92, 0, 0,
+  0, 144, 0, 193, 41, 0, 182, 0, 226, 84, 0, 178, 30, 95, 0, 0,
+  225, 0, 0, 0, 0, 227, 0, 0, 0, 0, 0, 140, 0, 0, 0, 105,
+  77, 72, 0, 17, 32, 141, 0, 194, 33, 0, 0, 0, 0, 0, 0, 31,
+  137, 0, 0, 155, 96, 170, 0, 204, 49, 220, 0, 28, 0, 0, 48, 0,
+  134, 0, 39, 101, 0, 190, 0, 114, 119, 0, 198, 120, 0, 0, 0, 138,
+  0, 0, 0, 16, 127, 0, 206, 186, 0, 0, 0, 51, 0, 148, 213, 167,
+  0, 19, 62, 0, 0, 67, 0, 0, 27, 15, 89, 0, 149, 0, 0, 0,
+  218, 0, 43, 0, 113, 0, 0, 0, 0, 195, 177, 20, 0, 50, 0, 0,
+  166, 0, 0, 0, 222, 0, 179, 0, 0, 0, 0, 0, 0, 109, 163, 152,
+  36, 0, 0, 211, 10, 0, 0, 153, 86, 0, 207, 136, 0, 224, 147, 0,
+  0, 0, 23, 0, 6, 135, 0, 0, 0, 173, 88, 172, 0, 131, 0, 8,
+  122, 0, 106, 0, 37, 0, 0, 156, 0, 164, 0, 0, 0, 0, 104, 199,
+  25, 142, 0, 46, 0, 0, 146, 0, 42, 205, 0, 0, 0, 0, 0, 0,
+  0, 0, 83, 22, 0, 78, 0, 0, 118, 0, 0, 0, 0, 0, 0, 209,
+};
+#endif
+
+#endif
@@ -10,9 +10,13 @@ static const mrbc_sym method_symbols_Array[] = {
   MRBC_SYM(BL_BR_EQ),
   MRBC_SYM(at),
   MRBC_SYM(clear),
+  MRBC_SYM(collect),
   MRBC_SYM(count),
   MRBC_SYM(delete_at),
   MRBC_SYM(dup),
+  MRBC_SYM(each),
+  MRBC_SYM(each_index),
+  MRBC_SYM(each_with_index),
   MRBC_SYM(empty_Q),
   MRBC_SYM(first),
   MRBC_SYM(include_Q),
@@ -24,6 +28,7 @@ static const mrbc_sym method_symbols_Array[] = {
 #endif
   MRBC_SYM(last),
   MRBC_SYM(length),
+  MRBC_SYM(map),
   MRBC_SYM(max),
   MRBC_SYM(min),
   MRBC_SYM(minmax),
@@ -49,9 +54,13 @@ static const mrbc_func_t method_functions_Array[] = {
   c_array_set,
   c_array_get,
   c_array_clear,
+  c_array_collect,
   c_array_size,
   c_array_delete_at,
   c_array_dup,
+  c_array_each,
+  c_array_each_index,
+  c_array_each_with_index,
   c_array_empty,
   c_array_first,
   c_array_include,
@@ -63,6 +72,7 @@ static const mrbc_func_t method_functions_Array[] = {
 #endif
   c_array_last,
   c_array_size,
+  c_array_collect,
   c_array_max,
   c_array_min,
   c_array_minmax,
@@ -17,9 +17,11 @@ static const mrbc_sym method_symbols_Integer[] = {
   MRBC_SYM(chr),
 #endif
   MRBC_SYM(clamp),
+  MRBC_SYM(downto),
 #if MRBC_USE_STRING
   MRBC_SYM(inspect),
 #endif
+  MRBC_SYM(times),
 #if MRBC_USE_FLOAT
   MRBC_SYM(to_f),
 #endif
@@ -27,6 +29,7 @@ static const mrbc_sym method_symbols_Integer[] = {
 #if MRBC_USE_STRING
   MRBC_SYM(to_s),
 #endif
+  MRBC_SYM(upto),
   MRBC_SYM(OR),
   MRBC_SYM(NEG),
 };
@@ -46,9 +49,11 @@ static const mrbc_func_t method_functions_Integer[] = {
   c_integer_chr,
 #endif
   c_numeric_clamp,
+  c_integer_downto,
 #if MRBC_USE_STRING
   c_integer_inspect,
 #endif
+  c_integer_times,
 #if MRBC_USE_FLOAT
   c_integer_to_f,
 #endif
@@ -56,6 +61,7 @@ static const mrbc_func_t method_functions_Integer[] = {
 #if MRBC_USE_STRING
   c_integer_inspect,
 #endif
+  c_integer_upto,
   c_integer_or,
   c_integer_not,
 };
@@ -4,6 +4,7 @@
 /*===== Range class =====*/
 static const mrbc_sym method_symbols_Range[] = {
   MRBC_SYM(EQ_EQ_EQ),
+  MRBC_SYM(each),
   MRBC_SYM(exclude_end_Q),
   MRBC_SYM(first),
 #if MRBC_USE_STRING
@@ -17,6 +18,7 @@ static const mrbc_sym method_symbols_Range[] = {
 
 static const mrbc_func_t method_functions_Range[] = {
   c_range_equal3,
+  c_range_each,
   c_range_exclude_end,
   c_range_first,
 #if MRBC_USE_STRING
@@ -38,6 +38,27 @@
     *prev: linked list, pointer to the previous free block of same block size.
     *top : pointer to this block's top.
 
+  SLAB AREA (see MRBC_ALLOC_SLAB_SIZE)
+    Small requests are served from fixed size slots before TLSF.
+    The slab area is one used block, and is divided into pages.
+    Each page holds the slots of one size class. A slot has the same
+    header as USED_BLOCK, so usable_size and vm_id work as usual.
+
+     | SLAB_PAGE | slot | slot | ... | SLAB_PAGE | slot | slot | ... |
+     +-----------+------+------+-----+-----------+------+------+-----+
+     |           |size| (contents) |
+
+  SCRATCH ARENA (see MRBC_USE_SCRATCH_ARENA)
+    Per-task bump allocator for short-lived objects. The arena is one
+    used block, and is divided into chunks. Objects are allocated by
+    bumping a pointer in the current chunk, and each chunk counts its
+    live objects. When the count drops to zero, the whole chunk is
+    reclaimed at once. A long-lived object pins only its own chunk.
+
+     | SCRATCH_ARENA | live[] | chunk | chunk | ... |
+     +---------------+--------+-------+-------+-----+
+                              |size| (contents) |size| ...
+
   </pre>
 */
 
@@ -99,6 +120,35 @@
 #endif
 
 
+/*
+  Slab page size and number of size classes.
+  The class N holds the request size up to SLAB_UNIT * (N+1).
+*/
+#ifndef MRBC_ALLOC_SLAB_PAGE_SIZE
+# define MRBC_ALLOC_SLAB_PAGE_SIZE 256
+#endif
+#ifndef MRBC_ALLOC_SLAB_CLASSES
+# define MRBC_ALLOC_SLAB_CLASSES 6
+#endif
+#define SLAB_UNIT	(sizeof(void *) * 2)
+#define SLAB_MAX_SIZE	(SLAB_UNIT * MRBC_ALLOC_SLAB_CLASSES)
+#define SLAB_NO_CLASS	0xff
+
+#if MRBC_ALLOC_SLAB_SIZE % MRBC_ALLOC_SLAB_PAGE_SIZE != 0
+# error "MRBC_ALLOC_SLAB_SIZE must be a multiple of MRBC_ALLOC_SLAB_PAGE_SIZE."
+#endif
+
+/*
+  Chunk size of the scratch arena.
+*/
+#ifndef MRBC_SCRATCH_CHUNK_SIZE
+# define MRBC_SCRATCH_CHUNK_SIZE 256
+#endif
+#if defined(MRBC_USE_SCRATCH_ARENA) && defined(MRBC_ALLOC_VMID)
+# error "Can't use MRBC_USE_SCRATCH_ARENA with MRBC_ALLOC_VMID"
+#endif
+
+
 /***** Macros ***************************************************************/
 #define FLI(x) ((x) >> MRBC_ALLOC_SLI_BIT_WIDTH)
 #define SLI(x) ((x) & ((1 << MRBC_ALLOC_SLI_BIT_WIDTH) - 1))
@@ -218,6 +268,48 @@ typedef struct MEMORY_POOL {
 #define BPOOL_END(memory_pool) ((void *)((uint8_t *)(memory_pool) + ((MEMORY_POOL *)(memory_pool))->size))
 #define BLOCK_ADRS(p) ((void *)((uint8_t *)(p) - sizeof(USED_BLOCK)))
 
+/*
+  define slab page header
+*/
+#if MRBC_ALLOC_SLAB_SIZE > 0
+typedef struct SLAB_PAGE {
+  struct SLAB_PAGE *next;	//!< link of pages in the same class, or empty pages.
+  struct SLAB_PAGE *prev;	//!< (same as above)
+  USED_BLOCK *free_slot;	//!< free slot list in this page.
+  uint8_t size_class;		//!< size class or SLAB_NO_CLASS.
+  uint8_t n_used;		//!< num of used slots.
+} SLAB_PAGE;
+
+#define SLAB_SLOT_SIZE(cls)	(sizeof(USED_BLOCK) + SLAB_UNIT * ((cls) + 1))
+#define SLAB_SLOT_TOP(page)	((USED_BLOCK *)((uint8_t *)(page) + sizeof(SLAB_PAGE)))
+#define SLAB_NEXT_FREE(slot)	(*(USED_BLOCK **)((uint8_t *)(slot) + sizeof(USED_BLOCK)))
+#define SLAB_PAGE_OF(p)		((SLAB_PAGE *)(slab_top + \
+  ((uint8_t *)(p) - slab_top) / MRBC_ALLOC_SLAB_PAGE_SIZE * MRBC_ALLOC_SLAB_PAGE_SIZE))
+#define IS_SLAB_PTR(p)		((uint8_t *)(p) >= slab_top && \
+				 (uint8_t *)(p) < slab_top + MRBC_ALLOC_SLAB_SIZE)
+#endif
+
+/*
+  define scratch arena header
+*/
+#if defined(MRBC_USE_SCRATCH_ARENA)
+typedef struct SCRATCH_ARENA {
+  struct SCRATCH_ARENA *next;	//!< link of all arenas.
+  uint8_t *top;			//!< top of the first chunk.
+  uint8_t *bump;		//!< next allocation point in the current chunk.
+  uint16_t n_chunks;		//!< num of chunks.
+  uint16_t cur;			//!< current chunk.
+  uint16_t n_live;		//!< total num of live objects.
+  uint8_t flag_delete;		//!< release when all objects are freed.
+  uint16_t live[];		//!< num of live objects in each chunk.
+} SCRATCH_ARENA;
+
+#define SCRATCH_CHUNK_TOP(a,i)	((a)->top + (i) * MRBC_SCRATCH_CHUNK_SIZE)
+#define SCRATCH_END(a)		SCRATCH_CHUNK_TOP((a), (a)->n_chunks)
+#define IS_SCRATCH_PTR(p)	((uint8_t *)(p) >= scratch_lo && \
+				 (uint8_t *)(p) < scratch_hi)
+#endif
+
 #define MSB_BIT1_FLI 0x8000
 #define MSB_BIT1_SLI 0x80
 #define NLZ_FLI(x) nlz16(x)
@@ -229,9 +321,24 @@ typedef struct MEMORY_POOL {
 // memory pool
 static MEMORY_POOL *memory_pool;
 
+#if MRBC_ALLOC_SLAB_SIZE > 0
+// slab area
+static uint8_t *slab_top;		// NULL if not used.
+static SLAB_PAGE *slab_empty_pages;
+static SLAB_PAGE *slab_partial_pages[MRBC_ALLOC_SLAB_CLASSES];
+static unsigned int slab_used;		// total size of used slots.
+#endif
+
+#if defined(MRBC_USE_SCRATCH_ARENA)
+// scratch arenas
+static SCRATCH_ARENA *scratch_list;
+static SCRATCH_ARENA *scratch_current;	// selected arena, or NULL.
+static uint8_t *scratch_lo, *scratch_hi;	// range of all arenas. (and blocks between them)
+#endif
+
 #if defined(MRBC_USE_ALLOC_PROF)
 static int profiling = 0;
-static struct MRBC_ALLOC_PROF alloc_prof = {0, 0, 0};
+static struct MRBC_ALLOC_PROF alloc_prof = {0, 0, 0, 0};
 #endif
 
 /***** Global variables *****************************************************/
@@ -384,6 +491,10 @@ static void alloc_profile(void)
     block = PHYS_NEXT(block);
   }
 
+#if MRBC_ALLOC_SLAB_SIZE > 0
+  if( slab_top ) used -= MRBC_ALLOC_SLAB_SIZE - slab_used;
+#endif
+
   if (alloc_prof.max < used) alloc_prof.max = used;
   if (used < alloc_prof.min) alloc_prof.min = used;
 }
@@ -428,6 +539,314 @@ static inline void merge_block(FREE_BLOCK *target, FREE_BLOCK *next)
 }
 
 
+#if MRBC_ALLOC_SLAB_SIZE > 0
+//================================================================
+/*! initialize slab area. carve it from the memory pool.
+
+  @param  pool_size	size of memory pool.
+*/
+static void slab_init(unsigned int pool_size)
+{
+  slab_top = 0;
+  slab_empty_pages = 0;
+  memset( slab_partial_pages, 0, sizeof(slab_partial_pages) );
+  slab_used = 0;
+
+  // too small pool, don't use.
+  if( pool_size < MRBC_ALLOC_SLAB_SIZE * 4 ) return;
+
+  uint8_t *top = mrbc_raw_alloc( MRBC_ALLOC_SLAB_SIZE );
+  if( !top ) return;
+  SET_VM_ID( BLOCK_ADRS(top), 0xff );
+
+  for( int i = MRBC_ALLOC_SLAB_SIZE / MRBC_ALLOC_SLAB_PAGE_SIZE - 1; i >= 0; i-- ) {
+    SLAB_PAGE *page = (SLAB_PAGE *)(top + i * MRBC_ALLOC_SLAB_PAGE_SIZE);
+    page->size_class = SLAB_NO_CLASS;
+    page->next = slab_empty_pages;
+    slab_empty_pages = page;
+  }
+  slab_top = top;
+}
+
+
+//================================================================
+/*! assign the empty page to the size class, and make free slot list.
+
+  @param  page	pointer to the empty page.
+  @param  cls	size class.
+*/
+static void slab_format_page(SLAB_PAGE *page, unsigned int cls)
+{
+  MRBC_ALLOC_MEMSIZE_T slot_size = SLAB_SLOT_SIZE(cls);
+  uint8_t *p = (uint8_t *)SLAB_SLOT_TOP(page);
+  uint8_t *end = (uint8_t *)page + MRBC_ALLOC_SLAB_PAGE_SIZE - slot_size;
+  USED_BLOCK **link = &page->free_slot;
+
+  for( ; p <= end; p += slot_size ) {
+    USED_BLOCK *slot = (USED_BLOCK *)p;
+    slot->size = slot_size | 0x02;	// flag prev=1, used=0
+    *link = slot;
+    link = &SLAB_NEXT_FREE(slot);
+  }
+  *link = NULL;
+
+  page->size_class = cls;
+  page->n_used = 0;
+}
+
+
+//================================================================
+/*! allocate memory from slab area
+
+  @param  size	request size. (<= SLAB_MAX_SIZE)
+  @return void * pointer to allocated memory.
+  @retval NULL	no free slot and no empty page.
+*/
+static void * slab_alloc(unsigned int size)
+{
+  unsigned int cls = size ? (size - 1) / SLAB_UNIT : 0;
+  SLAB_PAGE *page = slab_partial_pages[cls];
+
+  if( !page ) {
+    page = slab_empty_pages;
+    if( !page ) return NULL;
+
+    slab_empty_pages = page->next;
+    slab_format_page( page, cls );
+    page->next = page->prev = NULL;
+    slab_partial_pages[cls] = page;
+  }
+
+  USED_BLOCK *slot = page->free_slot;
+  page->free_slot = SLAB_NEXT_FREE(slot);
+  page->n_used++;
+
+  // page is full, remove from the partial list.
+  if( !page->free_slot ) {
+    slab_partial_pages[cls] = page->next;
+    if( page->next ) page->next->prev = NULL;
+  }
+
+  SET_USED_BLOCK(slot);
+  SET_VM_ID( slot, 0 );
+  slab_used += BLOCK_SIZE(slot);
+
+#if defined(MRBC_DEBUG)
+  memset( (uint8_t *)slot + sizeof(USED_BLOCK), 0xaa,
+          BLOCK_SIZE(slot) - sizeof(USED_BLOCK) );
+#endif
+
+  return (uint8_t *)slot + sizeof(USED_BLOCK);
+}
+
+
+//================================================================
+/*! release memory to slab area
+
+  @param  ptr	pointer in the slab area.
+*/
+static void slab_free(void *ptr)
+{
+  USED_BLOCK *slot = BLOCK_ADRS(ptr);
+  SLAB_PAGE *page = SLAB_PAGE_OF(slot);
+  unsigned int cls = page->size_class;
+
+#if defined(MRBC_DEBUG)
+  if( cls == SLAB_NO_CLASS || IS_FREE_BLOCK(slot) ) {
+    static const char msg[] = "mrbc_raw_free(): double free detected.\n";
+    hal_write(2, msg, sizeof(msg)-1);
+    return;
+  }
+  SET_VM_ID( slot, 0xff );
+  memset( ptr, 0xff, BLOCK_SIZE(slot) - sizeof(USED_BLOCK) );
+#endif
+
+  SET_FREE_BLOCK(slot);
+  slab_used -= BLOCK_SIZE(slot);
+
+  // page was full, add to the partial list.
+  if( !page->free_slot ) {
+    page->prev = NULL;
+    page->next = slab_partial_pages[cls];
+    if( page->next ) page->next->prev = page;
+    slab_partial_pages[cls] = page;
+  }
+  SLAB_NEXT_FREE(slot) = page->free_slot;
+  page->free_slot = slot;
+
+  // page is empty, return it to the empty list.
+  // but keep the last page of the class, to avoid re-formatting.
+  if( --page->n_used != 0 ) return;
+  if( slab_partial_pages[cls] == page && page->next == NULL ) return;
+
+  if( page->prev ) {
+    page->prev->next = page->next;
+  } else {
+    slab_partial_pages[cls] = page->next;
+  }
+  if( page->next ) page->next->prev = page->prev;
+
+  page->size_class = SLAB_NO_CLASS;
+  page->next = slab_empty_pages;
+  slab_empty_pages = page;
+}
+#endif
+
+
+#if defined(MRBC_USE_SCRATCH_ARENA)
+//================================================================
+/*! recalculate the address range of all scratch arenas.
+*/
+static void scratch_update_range(void)
+{
+  scratch_lo = scratch_hi = 0;
+
+  for( SCRATCH_ARENA *a = scratch_list; a; a = a->next ) {
+    if( !scratch_lo || a->top < scratch_lo ) scratch_lo = a->top;
+    if( SCRATCH_END(a) > scratch_hi ) scratch_hi = SCRATCH_END(a);
+  }
+}
+
+
+//================================================================
+/*! find the scratch arena that has the pointer.
+
+  @param  ptr	pointer to check.
+  @return	pointer to the arena, or NULL.
+*/
+static SCRATCH_ARENA * scratch_find(const void *ptr)
+{
+  SCRATCH_ARENA *a = scratch_current;
+  if( a && (uint8_t *)ptr >= a->top && (uint8_t *)ptr < SCRATCH_END(a) ) {
+    return a;
+  }
+
+  for( a = scratch_list; a; a = a->next ) {
+    if( (uint8_t *)ptr >= a->top && (uint8_t *)ptr < SCRATCH_END(a) ) break;
+  }
+  return a;
+}
+
+
+//================================================================
+/*! release the scratch arena to the memory pool.
+
+  @param  arena	pointer to the arena.
+*/
+static void scratch_release(SCRATCH_ARENA *arena)
+{
+  SCRATCH_ARENA **pp = &scratch_list;
+  while( *pp != arena ) pp = &(*pp)->next;
+  *pp = arena->next;
+  if( scratch_current == arena ) scratch_current = 0;
+  scratch_update_range();
+
+  mrbc_raw_free( arena );
+}
+
+
+//================================================================
+/*! allocate memory from the scratch arena
+
+  @param  arena	pointer to the arena.
+  @param  size	request size.
+  @return void * pointer to allocated memory.
+  @retval NULL	too large, or no empty chunk.
+*/
+static void * scratch_alloc(SCRATCH_ARENA *arena, unsigned int size)
+{
+  MRBC_ALLOC_MEMSIZE_T alloc_size = size + sizeof(USED_BLOCK);
+  alloc_size += (-alloc_size & 3);	// align 4 byte
+  if( alloc_size > MRBC_SCRATCH_CHUNK_SIZE ) return NULL;
+
+  // doesn't fit in the current chunk, move to the next empty chunk.
+  if( arena->bump + alloc_size > SCRATCH_CHUNK_TOP(arena, arena->cur + 1) ) {
+    unsigned int i = arena->cur;
+    do {
+      if( ++i >= arena->n_chunks ) i = 0;
+      if( i == arena->cur ) return NULL;
+    } while( arena->live[i] != 0 );
+
+    arena->cur = i;
+    arena->bump = SCRATCH_CHUNK_TOP(arena, i);
+  }
+
+  USED_BLOCK *target = (USED_BLOCK *)arena->bump;
+  target->size = alloc_size | 0x03;	// flag prev=1, used=1
+  SET_VM_ID( target, 0 );
+  arena->bump += alloc_size;
+  arena->live[arena->cur]++;
+  arena->n_live++;
+
+#if defined(MRBC_DEBUG)
+  memset( (uint8_t *)target + sizeof(USED_BLOCK), 0xaa,
+          alloc_size - sizeof(USED_BLOCK) );
+#endif
+
+  return (uint8_t *)target + sizeof(USED_BLOCK);
+}
+
+
+//================================================================
+/*! release memory to the scratch arena
+
+  @param  arena	pointer to the arena that has the pointer.
+  @param  ptr	pointer in the arena.
+*/
+static void scratch_free(SCRATCH_ARENA *arena, void *ptr)
+{
+  USED_BLOCK *target = BLOCK_ADRS(ptr);
+  unsigned int i = ((uint8_t *)target - arena->top) / MRBC_SCRATCH_CHUNK_SIZE;
+
+#if defined(MRBC_DEBUG)
+  if( IS_FREE_BLOCK(target) || arena->live[i] == 0 ) {
+    static const char msg[] = "mrbc_raw_free(): double free detected.\n";
+    hal_write(2, msg, sizeof(msg)-1);
+    return;
+  }
+  memset( ptr, 0xff, BLOCK_SIZE(target) - sizeof(USED_BLOCK) );
+#endif
+  SET_FREE_BLOCK(target);
+
+  arena->n_live--;
+  if( --arena->live[i] != 0 ) return;
+
+  // the chunk is empty. rewind if it is the current one.
+  if( i == arena->cur ) arena->bump = SCRATCH_CHUNK_TOP(arena, i);
+  if( arena->flag_delete && arena->n_live == 0 ) scratch_release( arena );
+}
+
+
+//================================================================
+/*! resize the last object in the current chunk in place.
+
+  @param  arena	pointer to the arena that has the pointer.
+  @param  ptr	pointer in the arena.
+  @param  size	request size.
+  @return	true if resized.
+*/
+static int scratch_resize(SCRATCH_ARENA *arena, void *ptr, unsigned int size)
+{
+  USED_BLOCK *target = BLOCK_ADRS(ptr);
+  MRBC_ALLOC_MEMSIZE_T alloc_size = size + sizeof(USED_BLOCK);
+  alloc_size += (-alloc_size & 3);	// align 4 byte
+
+  if( alloc_size <= BLOCK_SIZE(target) ) return 1;	// shrink. keep it.
+
+  // only the last object in the current chunk can be expanded.
+  if( (uint8_t *)target + BLOCK_SIZE(target) != arena->bump ) return 0;
+  if( ((uint8_t *)target - arena->top) / MRBC_SCRATCH_CHUNK_SIZE !=
+      arena->cur ) return 0;
+  if( (uint8_t *)target + alloc_size >
+      SCRATCH_CHUNK_TOP(arena, arena->cur + 1) ) return 0;
+
+  arena->bump = (uint8_t *)target + alloc_size;
+  target->size = alloc_size | (target->size & 0x03);
+  return 1;
+}
+#endif
+
+
 /***** Global functions *****************************************************/
 //================================================================
 /*! initialize
@@ -472,6 +891,10 @@ void mrbc_init_alloc(void *ptr, unsigned int size)
   SET_VM_ID( used_block, 0xff );
 
   add_free_block( memory_pool, free_block );
+
+#if MRBC_ALLOC_SLAB_SIZE > 0
+  slab_init( size );
+#endif
 }
 
 
@@ -487,6 +910,13 @@ void mrbc_cleanup_alloc(void)
 #endif
 
   memory_pool = 0;
+#if MRBC_ALLOC_SLAB_SIZE > 0
+  slab_top = 0;
+#endif
+#if defined(MRBC_USE_SCRATCH_ARENA)
+  scratch_list = scratch_current = 0;
+  scratch_lo = scratch_hi = 0;
+#endif
 }
 
 
@@ -499,6 +929,31 @@ void mrbc_cleanup_alloc(void)
 */
 void * mrbc_raw_alloc(unsigned int size)
 {
+#if defined(MRBC_USE_SCRATCH_ARENA)
+  if( scratch_current ) {
+    void *ptr = scratch_alloc(scratch_current, size);
+    if( ptr ) {
+#if defined(MRBC_USE_ALLOC_PROF)
+      if( profiling ) alloc_prof.n_alloc++;
+#endif
+      return ptr;
+    }
+  }
+#endif
+
+#if MRBC_ALLOC_SLAB_SIZE > 0
+  if( size <= SLAB_MAX_SIZE && slab_top ) {
+    void *ptr = slab_alloc(size);
+    if( ptr ) {
+#if defined(MRBC_USE_ALLOC_PROF)
+      if( profiling ) alloc_prof.n_alloc++;
+      alloc_profile();
+#endif
+      return ptr;
+    }
+  }
+#endif
+
   MEMORY_POOL *pool = memory_pool;
   MRBC_ALLOC_MEMSIZE_T alloc_size = size + sizeof(USED_BLOCK);
 
@@ -602,6 +1057,7 @@ void * mrbc_raw_alloc(unsigned int size)
 #endif
 
 #if defined(MRBC_USE_ALLOC_PROF)
+  if( profiling ) alloc_prof.n_alloc++;
   alloc_profile();
 #endif
 
@@ -658,8 +1114,17 @@ void * mrbc_raw_alloc_no_free(unsigned int size)
 
   return (uint8_t *)tail + sizeof(USED_BLOCK);
 
- FALLBACK:
+ FALLBACK:;
+#if defined(MRBC_USE_SCRATCH_ARENA)
+  // never place it in the scratch arena.
+  SCRATCH_ARENA *arena = scratch_current;
+  scratch_current = 0;
+  void *ptr = mrbc_raw_alloc(alloc_size);
+  scratch_current = arena;
+  return ptr;
+#else
   return mrbc_raw_alloc(alloc_size);
+#endif
 }
 
 
@@ -694,6 +1159,25 @@ void * mrbc_raw_calloc(unsigned int nmemb, unsigned int size)
 */
 void mrbc_raw_free(void *ptr)
 {
+#if defined(MRBC_USE_SCRATCH_ARENA)
+  // other blocks may lie between the arenas, so find the arena.
+  SCRATCH_ARENA *arena = IS_SCRATCH_PTR(ptr) ? scratch_find(ptr) : 0;
+  if( arena ) {
+    scratch_free(arena, ptr);
+    return;
+  }
+#endif
+
+#if MRBC_ALLOC_SLAB_SIZE > 0
+  if( IS_SLAB_PTR(ptr) ) {
+    slab_free(ptr);
+#if defined(MRBC_USE_ALLOC_PROF)
+    alloc_profile();
+#endif
+    return;
+  }
+#endif
+
   MEMORY_POOL *pool = memory_pool;
 
 #if defined(MRBC_DEBUG)
@@ -811,6 +1295,22 @@ void * mrbc_raw_realloc(void *ptr, unsigned int size)
   // check minimum alloc size.
   if( alloc_size < MRBC_MIN_MEMORY_BLOCK_SIZE ) alloc_size = MRBC_MIN_MEMORY_BLOCK_SIZE;
 
+#if defined(MRBC_USE_SCRATCH_ARENA)
+  SCRATCH_ARENA *arena = IS_SCRATCH_PTR(ptr) ? scratch_find(ptr) : 0;
+  if( arena ) {
+    if( scratch_resize(arena, ptr, size) ) return ptr;
+    goto ALLOC_AND_COPY;
+  }
+#endif
+
+#if MRBC_ALLOC_SLAB_SIZE > 0
+  // slot in the slab area can't resize.
+  if( IS_SLAB_PTR(ptr) ) {
+    if( size <= BLOCK_SIZE(target) - sizeof(USED_BLOCK) ) return ptr;
+    goto ALLOC_AND_COPY;
+  }
+#endif
+
   // expand? part1.
   // next phys block is free and enough size?
   if( alloc_size > BLOCK_SIZE(target) ) {
@@ -865,6 +1365,100 @@ void * mrbc_raw_realloc(void *ptr, unsigned int size)
 }
 
 
+#if defined(MRBC_USE_SCRATCH_ARENA)
+//================================================================
+/*! create a scratch arena.
+
+  @param  size	arena size. (rounded down to the chunk size)
+  @return	pointer to the arena, or NULL.
+  @note
+  The arena is carved from the memory pool. Select it by
+  mrbc_scratch_select() to allocate objects from it.
+*/
+void * mrbc_scratch_new(unsigned int size)
+{
+  unsigned int n_chunks = size / MRBC_SCRATCH_CHUNK_SIZE;
+  if( n_chunks == 0 ) return NULL;
+
+  unsigned int hdr_size = sizeof(SCRATCH_ARENA) + sizeof(uint16_t) * n_chunks;
+  hdr_size += (-hdr_size & 3);
+
+  SCRATCH_ARENA *arena = mrbc_raw_alloc( hdr_size + n_chunks * MRBC_SCRATCH_CHUNK_SIZE );
+  if( !arena ) return NULL;	// ENOMEM
+  SET_VM_ID( BLOCK_ADRS(arena), 0xff );
+
+  arena->top = (uint8_t *)arena + hdr_size;
+  arena->bump = arena->top;
+  arena->n_chunks = n_chunks;
+  arena->cur = 0;
+  arena->n_live = 0;
+  arena->flag_delete = 0;
+  memset( arena->live, 0, sizeof(uint16_t) * n_chunks );
+
+  arena->next = scratch_list;
+  scratch_list = arena;
+  scratch_update_range();
+
+  return arena;
+}
+
+
+//================================================================
+/*! delete the scratch arena.
+
+  @param  arena	pointer to the arena.
+  @note
+  If some objects in the arena are still alive, the arena is released
+  when the last one is freed.
+*/
+void mrbc_scratch_delete(void *arena)
+{
+  SCRATCH_ARENA *a = arena;
+  if( !a ) return;
+
+  if( scratch_current == a ) scratch_current = 0;
+  if( a->n_live == 0 ) {
+    scratch_release( a );
+  } else {
+    a->flag_delete = 1;
+  }
+}
+
+
+//================================================================
+/*! select the scratch arena for the following allocations.
+
+  @param  arena	pointer to the arena, or NULL to use the memory pool.
+  @return	previous selected arena.
+*/
+void * mrbc_scratch_select(void *arena)
+{
+  SCRATCH_ARENA *prev = scratch_current;
+  scratch_current = arena;
+  return prev;
+}
+
+
+//================================================================
+/*! statistics of the scratch arena.
+
+  @param  arena	pointer to the arena.
+  @param  ret	pointer to return values.
+*/
+void mrbc_scratch_statistics(void *arena, struct MRBC_SCRATCH_STATISTICS *ret)
+{
+  SCRATCH_ARENA *a = arena;
+
+  ret->total = a->n_chunks * MRBC_SCRATCH_CHUNK_SIZE;
+  ret->n_live = a->n_live;
+  ret->pinned_chunks = 0;
+  for( int i = 0; i < a->n_chunks; i++ ) {
+    if( a->live[i] != 0 ) ret->pinned_chunks++;
+  }
+}
+#endif
+
+
 //================================================================
 /*! allocated memory size
 
@@ -930,6 +1524,26 @@ void mrbc_free_all(const struct VM *vm)
   USED_BLOCK *next;
   int vm_id = vm->vm_id;
 
+#if MRBC_ALLOC_SLAB_SIZE > 0
+  if( slab_top ) {
+    for( uint8_t *p = slab_top; p < slab_top + MRBC_ALLOC_SLAB_SIZE;
+	 p += MRBC_ALLOC_SLAB_PAGE_SIZE ) {
+      SLAB_PAGE *page = (SLAB_PAGE *)p;
+      if( page->size_class == SLAB_NO_CLASS ) continue;
+
+      MRBC_ALLOC_MEMSIZE_T slot_size = SLAB_SLOT_SIZE(page->size_class);
+      uint8_t *slot = (uint8_t *)SLAB_SLOT_TOP(page);
+      uint8_t *end = p + MRBC_ALLOC_SLAB_PAGE_SIZE - slot_size;
+      for( ; slot <= end; slot += slot_size ) {
+	if( IS_USED_BLOCK((USED_BLOCK *)slot) &&
+	    GET_VM_ID(slot) == vm_id ) {
+	  slab_free( slot + sizeof(USED_BLOCK) );
+	}
+      }
+    }
+  }
+#endif
+
   while( target < (USED_BLOCK *)BPOOL_END(pool) ) {
     next = PHYS_NEXT(target);
     if( IS_FREE_BLOCK(next) ) next = PHYS_NEXT(next);
@@ -995,6 +1609,14 @@ void mrbc_alloc_statistics( struct MRBC_ALLOC_STATISTICS *ret )
     }
     block = PHYS_NEXT(block);
   }
+
+#if MRBC_ALLOC_SLAB_SIZE > 0
+  // unused part of the slab area is counted as free.
+  if( slab_top ) {
+    ret->used -= MRBC_ALLOC_SLAB_SIZE - slab_used;
+    ret->free += MRBC_ALLOC_SLAB_SIZE - slab_used;
+  }
+#endif
 }
 
 
@@ -1007,6 +1629,7 @@ void mrbc_alloc_start_profiling(void)
   if (profiling) return;
   profiling = 1;
   alloc_prof.max = 0;
+  alloc_prof.n_alloc = 0;
   alloc_profile();
   alloc_prof.initial = alloc_prof.min = alloc_prof.max;
 }
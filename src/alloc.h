@@ -50,6 +50,17 @@ struct MRBC_ALLOC_PROF {
   unsigned long initial;
   unsigned long max;
   unsigned long min;
+  unsigned long n_alloc;	//!< num of allocations while profiling.
+};
+
+
+/*!@brief
+  Return value structure for mrbc_scratch_statistics function.
+*/
+struct MRBC_SCRATCH_STATISTICS {
+  unsigned int total;		//!< size of the arena.
+  unsigned int n_live;		//!< num of live objects.
+  unsigned int pinned_chunks;	//!< num of chunks that have live objects.
 };
 
 
@@ -88,6 +99,13 @@ int mrbc_get_vm_id(void *ptr);
 #define mrbc_get_vm_id(ptr)	0
 #endif
 
+#if defined(MRBC_USE_SCRATCH_ARENA)
+void *mrbc_scratch_new(unsigned int size);
+void mrbc_scratch_delete(void *arena);
+void *mrbc_scratch_select(void *arena);
+void mrbc_scratch_statistics(void *arena, struct MRBC_SCRATCH_STATISTICS *ret);
+#endif
+
 void mrbc_alloc_statistics(struct MRBC_ALLOC_STATISTICS *ret);
 void mrbc_alloc_start_profiling(void);
 void mrbc_alloc_stop_profiling(void);
@@ -106,6 +124,9 @@ void mrbc_alloc_print_memory_pool(void);
 #if defined(MRBC_ALLOC_VMID)
 #error "Can't use MRBC_ALLOC_LIBC with MRBC_ALLOC_VMID"
 #endif
+#if defined(MRBC_USE_SCRATCH_ARENA)
+#error "Can't use MRBC_ALLOC_LIBC with MRBC_USE_SCRATCH_ARENA"
+#endif
 
 static inline void mrbc_init_alloc(void *ptr, unsigned int size) {}
 static inline void mrbc_cleanup_alloc(void) {}
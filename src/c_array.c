@@ -1173,6 +1173,99 @@ static void c_array_uniq_self(struct VM *vm, mrbc_value v[], int argc)
 }
 
 
+//================================================================
+/*! (method) each, each_index, each_with_index
+
+  The block is called by the VM. (see mrbc_iter_start)
+  work[0] is the index.
+*/
+static int c_array_each_step(struct VM *vm, mrbc_value *recv, mrbc_value *work, mrbc_value *blk)
+{
+  int i = work[0].i;
+  if( i >= mrbc_array_size(recv) ) return -1;
+
+  blk[1] = recv->array->data[i];
+  mrbc_incref( &blk[1] );
+  work[0].i++;
+  return 1;
+}
+
+static int c_array_each_index_step(struct VM *vm, mrbc_value *recv, mrbc_value *work, mrbc_value *blk)
+{
+  int i = work[0].i;
+  if( i >= mrbc_array_size(recv) ) return -1;
+
+  blk[1] = mrbc_integer_value(i);
+  work[0].i++;
+  return 1;
+}
+
+static int c_array_each_with_index_step(struct VM *vm, mrbc_value *recv, mrbc_value *work, mrbc_value *blk)
+{
+  int i = work[0].i;
+  if( i >= mrbc_array_size(recv) ) return -1;
+
+  blk[1] = recv->array->data[i];
+  mrbc_incref( &blk[1] );
+  blk[2] = mrbc_integer_value(i);
+  work[0].i++;
+  return 2;
+}
+
+static void c_array_each(struct VM *vm, mrbc_value v[], int argc)
+{
+  mrbc_iter_start( vm, v, argc, c_array_each_step,
+		   mrbc_integer_value(0), mrbc_nil_value() );
+}
+
+static void c_array_each_index(struct VM *vm, mrbc_value v[], int argc)
+{
+  mrbc_iter_start( vm, v, argc, c_array_each_index_step,
+		   mrbc_integer_value(0), mrbc_nil_value() );
+}
+
+static void c_array_each_with_index(struct VM *vm, mrbc_value v[], int argc)
+{
+  mrbc_iter_start( vm, v, argc, c_array_each_with_index_step,
+		   mrbc_integer_value(0), mrbc_nil_value() );
+}
+
+
+//================================================================
+/*! (method) collect, map
+
+  work[0] is the index, work[1] is the result array.
+*/
+static int c_array_collect_step(struct VM *vm, mrbc_value *recv, mrbc_value *work, mrbc_value *blk)
+{
+  int i = work[0].i;
+  if( i > 0 ) {
+    if( mrbc_array_push( &work[1], &blk[0] ) == 0 ) blk[0].tt = MRBC_TT_EMPTY;
+  }
+
+  if( i >= mrbc_array_size(recv) ) {
+    mrbc_decref( recv );
+    *recv = work[1];
+    work[1].tt = MRBC_TT_EMPTY;
+    return -1;
+  }
+
+  blk[1] = recv->array->data[i];
+  mrbc_incref( &blk[1] );
+  work[0].i++;
+  return 1;
+}
+
+static void c_array_collect(struct VM *vm, mrbc_value v[], int argc)
+{
+  mrbc_value ret = mrbc_array_new( vm, mrbc_array_size(v) );
+  if( !ret.array ) return;	// ENOMEM
+
+  mrbc_iter_start( vm, v, argc, c_array_collect_step,
+		   mrbc_integer_value(0), ret );
+}
+
+
 #if MRBC_USE_STRING
 //================================================================
 /*! (method) inspect, to_s
@@ -1282,6 +1375,11 @@ static void c_array_join(struct VM *vm, mrbc_value v[], int argc)
   METHOD( "minmax",	c_array_minmax )
   METHOD( "uniq",	c_array_uniq )
   METHOD( "uniq!",	c_array_uniq_self )
+  METHOD( "each",	c_array_each )
+  METHOD( "each_index",	c_array_each_index )
+  METHOD( "each_with_index", c_array_each_with_index )
+  METHOD( "collect",	c_array_collect )
+  METHOD( "map",	c_array_collect )
 #if MRBC_USE_STRING
   METHOD( "inspect",	c_array_inspect )
   METHOD( "to_s",	c_array_inspect )
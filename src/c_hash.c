@@ -58,6 +58,19 @@
 #include "mrubyc.h"
 
 /***** Constat values *******************************************************/
+#if MRBC_HASH_INDEX_THRESHOLD > 0
+// Integers beyond this are compared with Float in rounded value.
+#if MRBC_USE_FLOAT == 1
+#define HASH_EXACT_INT_MAX (1L << 24)
+#elif MRBC_USE_FLOAT == 2
+#define HASH_EXACT_INT_MAX (1LL << 53)
+#endif
+
+// n_indexed value that means the index needs to be rebuilt.
+#define HASH_INDEX_INVALID 0xffff
+#endif
+
+
 /***** Macros ***************************************************************/
 /***** Typedefs *************************************************************/
 /***** Function prototypes **************************************************/
@@ -65,6 +78,175 @@
 /***** Global variables *****************************************************/
 /***** Signal catching functions ********************************************/
 /***** Local functions ******************************************************/
+#if MRBC_HASH_INDEX_THRESHOLD > 0
+//================================================================
+/*! mix the bits of hash value.
+*/
+static inline unsigned int hash_mix( uint32_t h )
+{
+  h ^= h >> 16;
+  h *= 0x45d9f3b;
+  h ^= h >> 16;
+  return h;
+}
+
+
+//================================================================
+/*! calculate hash value of the integer.
+*/
+static inline uint32_t hash_calc_int( mrbc_int_t i )
+{
+  uint32_t h = (uint32_t)i;
+#if defined(MRBC_INT64)
+  h ^= (uint32_t)(i >> 32);
+#endif
+  return h;
+}
+
+
+#if MRBC_USE_FLOAT
+//================================================================
+/*! calculate hash value of the float.
+*/
+static uint32_t hash_calc_float( mrbc_float_t d )
+{
+  // integral value has same hash value as Integer.
+  const mrbc_float_t lim = (mrbc_float_t)((mrbc_int_t)1 << (sizeof(mrbc_int_t) * 8 - 2)) * 2;
+  if( -lim <= d && d < lim ) {
+    mrbc_int_t i = (mrbc_int_t)d;
+    if( (mrbc_float_t)i == d ) return hash_calc_int( i );
+  }
+
+  const uint8_t *p = (const uint8_t *)&d;
+  uint32_t h = 0;
+  for( int n = 0; n < sizeof(d); n++ ) {
+    h = h * 17 + *p++;
+  }
+  return h;
+}
+#endif
+
+
+//================================================================
+/*! calculate hash value of the key.
+
+  @param  key	pointer to key value.
+  @return	hash value.
+  @note	Values that are equal by mrbc_compare() must have the same hash value.
+*/
+static unsigned int hash_calc( const mrbc_value *key )
+{
+  uint32_t h;
+
+  switch( mrbc_type(*key) ) {
+  case MRBC_TT_EMPTY:		// same as nil.
+    return MRBC_TT_NIL;
+
+  case MRBC_TT_INTEGER: {
+    mrbc_int_t i = mrbc_integer(*key);
+#if MRBC_USE_FLOAT == 1 || (MRBC_USE_FLOAT && defined(MRBC_INT64))
+    if( i > HASH_EXACT_INT_MAX || i < -HASH_EXACT_INT_MAX ) {
+      h = hash_calc_float( i );
+      break;
+    }
+#endif
+    h = hash_calc_int( i );
+    break;
+  }
+
+#if MRBC_USE_FLOAT
+  case MRBC_TT_FLOAT:
+    h = hash_calc_float( mrbc_float(*key) );
+    break;
+#endif
+
+  case MRBC_TT_SYMBOL:
+    h = mrbc_symbol(*key);
+    break;
+
+  case MRBC_TT_CLASS:
+  case MRBC_TT_MODULE:
+  case MRBC_TT_OBJECT:
+  case MRBC_TT_PROC:
+    h = (uint32_t)(uintptr_t)key->cls;
+    break;
+
+#if MRBC_USE_STRING
+  case MRBC_TT_STRING: {
+    const uint8_t *p = (const uint8_t *)mrbc_string_ptr(key);
+    int n = mrbc_string_size(key);
+    h = n;
+    while( --n >= 0 ) {
+      h = h * 17 + *p++;
+    }
+    break;
+  }
+#endif
+
+  default:
+    // compared by contents. (Array, Range, Hash, ...)
+    return mrbc_type(*key);
+  }
+
+  return hash_mix( h );
+}
+
+
+//================================================================
+/*! make the search index up to date.
+
+  @param  h	pointer to hash handle.
+  @return	0 if index is usable, or -1 (ENOMEM).
+  @details
+  Data are only appended to the tail, except mrbc_hash_remove() and
+  mrbc_hash_clear(). Thus it registers only the data added since last call.
+*/
+static int hash_index_update( mrbc_hash *h )
+{
+  int n_pairs = h->n_stored / 2;
+
+  if( h->n_indexed > h->n_stored || h->index_size < n_pairs * 2 ) {
+    // rebuild the index. load factor is kept under 0.5
+    unsigned int size = h->index_size ? h->index_size : 16;
+    while( size < n_pairs * 2 ) size *= 2;
+    if( size > 0x8000 ) return -1;
+
+    if( size != h->index_size ) {
+      if( h->index ) mrbc_raw_free( h->index );
+      h->index = mrbc_raw_alloc( sizeof(uint16_t) * size );
+      if( !h->index ) {		// ENOMEM
+	h->index_size = 0;
+	return -1;
+      }
+      mrbc_set_vm_id( h->index, mrbc_get_vm_id(h) );
+      h->index_size = size;
+    }
+    memset( h->index, 0, sizeof(uint16_t) * h->index_size );
+    h->n_indexed = 0;
+  }
+
+  // register new data.
+  unsigned int mask = h->index_size - 1;
+  for( int i = h->n_indexed / 2; i < n_pairs; i++ ) {
+    const mrbc_value *key = &h->data[i * 2];
+    unsigned int idx = hash_calc( key ) & mask;
+
+    while( h->index[idx] != 0 ) {
+      // If the key duplicates, the first one takes priority. (same as linear)
+      if( mrbc_compare( &h->data[(h->index[idx]-1) * 2], key ) == 0 ) goto NEXT;
+      idx = (idx + 1) & mask;
+    }
+    h->index[idx] = i + 1;
+  NEXT:
+    ;
+  }
+  h->n_indexed = h->n_stored;
+
+  return 0;
+}
+#endif
+
+
 /***** Global functions *****************************************************/
 
 //================================================================
@@ -94,6 +276,11 @@ mrbc_value mrbc_hash_new(struct VM *vm, int size)
   h->data_size = size * 2;
   h->n_stored = 0;
   h->data = data;
+#if MRBC_HASH_INDEX_THRESHOLD > 0
+  h->index = NULL;
+  h->index_size = 0;
+  h->n_indexed = 0;
+#endif
 
   value.hash = h;
   return value;
@@ -107,7 +294,9 @@ mrbc_value mrbc_hash_new(struct VM *vm, int size)
 */
 void mrbc_hash_delete(mrbc_value *hash)
 {
-  // TODO: delete other members (for search).
+#if MRBC_HASH_INDEX_THRESHOLD > 0
+  if( hash->hash->index ) mrbc_raw_free( hash->hash->index );
+#endif
 
   mrbc_array_delete(hash);
 }
@@ -122,6 +311,23 @@ void mrbc_hash_delete(mrbc_value *hash)
 */
 mrbc_value * mrbc_hash_search(const mrbc_value *hash, const mrbc_value *key)
 {
+#if MRBC_HASH_INDEX_THRESHOLD > 0
+  mrbc_hash *h = hash->hash;
+
+  if( h->n_stored >= MRBC_HASH_INDEX_THRESHOLD * 2 &&
+      hash_index_update( h ) == 0 ) {
+    unsigned int mask = h->index_size - 1;
+    unsigned int idx = hash_calc( key ) & mask;
+
+    while( h->index[idx] != 0 ) {
+      mrbc_value *p1 = &h->data[(h->index[idx]-1) * 2];
+      if( mrbc_compare(p1, key) == 0 ) return p1;
+      idx = (idx + 1) & mask;
+    }
+    return NULL;
+  }
+#endif
+
   mrbc_value *p1 = hash->hash->data;
   const mrbc_value *p2 = p1 + hash->hash->n_stored;
 
@@ -235,7 +441,9 @@ mrbc_value mrbc_hash_remove(mrbc_value *hash, const mrbc_value *key)
 
   memmove(v, v+2, (char*)(h->data + h->n_stored) - (char*)v);
 
-  // TODO: re-index hash table if need.
+#if MRBC_HASH_INDEX_THRESHOLD > 0
+  h->n_indexed = HASH_INDEX_INVALID;	// the positions were shifted.
+#endif
 
   return val;
 }
@@ -262,7 +470,9 @@ mrbc_value mrbc_hash_remove_by_id(mrbc_value *hash, mrbc_sym sym_id)
 
   memmove(v, v+2, (char*)(h->data + h->n_stored) - (char*)v);
 
-  // TODO: re-index hash table if need.
+#if MRBC_HASH_INDEX_THRESHOLD > 0
+  h->n_indexed = HASH_INDEX_INVALID;	// the positions were shifted.
+#endif
 
   return val;
 }
@@ -277,7 +487,9 @@ void mrbc_hash_clear(mrbc_value *hash)
 {
   mrbc_array_clear(hash);
 
-  // TODO: re-index hash table if need.
+#if MRBC_HASH_INDEX_THRESHOLD > 0
+  hash->hash->n_indexed = HASH_INDEX_INVALID;
+#endif
 }
 
 
@@ -325,8 +537,6 @@ mrbc_value mrbc_hash_dup( struct VM *vm, mrbc_value *src )
     mrbc_incref(p1++);
   }
 
-  // TODO: dup other members.
-
   return ret;
 }
 
@@ -406,8 +616,6 @@ static void c_hash_delete(struct VM *vm, mrbc_value v[], int argc)
 
   mrbc_value ret = mrbc_hash_remove(v, v+1);
 
-  // TODO: re-index hash table if need.
-
   SET_RETURN(ret);
 }
 
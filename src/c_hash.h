@@ -17,6 +17,7 @@
 /***** Feature test switches ************************************************/
 /***** System headers *******************************************************/
 //@cond
+#include "vm_config.h"
 #include <stdint.h>
 //@endcond
 
@@ -46,7 +47,11 @@ typedef struct RHash {
   uint16_t n_stored;	//!< num of stored.
   mrbc_value *data;	//!< pointer to allocated memory.
 
-  // TODO: and other member for search.
+#if MRBC_HASH_INDEX_THRESHOLD > 0
+  uint16_t *index;	//!< search index. (open addressing) or NULL.
+  uint16_t index_size;	//!< num of index slots. (power of 2)
+  uint16_t n_indexed;	//!< num of data (key and value) in the index.
+#endif
 
 } mrbc_hash;
 
@@ -93,6 +98,9 @@ static inline int mrbc_hash_size(const mrbc_value *hash) {
 */
 static inline void mrbc_hash_clear_vm_id(mrbc_value *hash) {
   mrbc_array_clear_vm_id(hash);
+#if MRBC_HASH_INDEX_THRESHOLD > 0
+  if( hash->hash->index ) mrbc_set_vm_id( hash->hash->index, 0 );
+#endif
 }
 #endif
 
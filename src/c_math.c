@@ -37,7 +37,7 @@ static double to_double( struct VM *vm, const mrbc_value *v )
 {
   switch( mrbc_type(*v) ) {
   case MRBC_TT_INTEGER:	return (double)v->i;
-  case MRBC_TT_FLOAT:	return (double)v->d;
+  case MRBC_TT_FLOAT:	return (double)mrbc_float(*v);
   default: break;
   }
 
@@ -165,7 +165,7 @@ static void c_math_ldexp(struct VM *vm, mrbc_value v[], int argc)
   int exp;
   switch( mrbc_type(v[2]) ) {
   case MRBC_TT_INTEGER:	exp = v[2].i;		break;
-  case MRBC_TT_FLOAT:	exp = (int)v[2].d;	break;
+  case MRBC_TT_FLOAT:	exp = (int)mrbc_float(v[2]);	break;
   default:
     mrbc_raise(vm, MRBC_CLASS(TypeError), 0);
     return;
@@ -244,10 +244,10 @@ static void c_math_tanh(struct VM *vm, mrbc_value v[], int argc)
 */
 void mrbc_init_module_math(void)
 {
-  static mrbc_value e = mrbc_float_value(0, M_E);
+  mrbc_value e = mrbc_float_value(0, M_E);
   mrbc_set_class_const( MRBC_CLASS(Math), MRBC_SYM(E), &e );
 
-  static mrbc_value pi = mrbc_float_value(0, M_PI);
+  mrbc_value pi = mrbc_float_value(0, M_PI);
   mrbc_set_class_const( MRBC_CLASS(Math), MRBC_SYM(PI), &pi );
 }
 
@@ -65,6 +65,12 @@ static void c_integer_positive(struct VM *vm, mrbc_value v[], int argc)
 static void c_integer_negative(struct VM *vm, mrbc_value v[], int argc)
 {
   mrbc_int_t num = mrbc_integer(v[0]);
+#if defined(MRBC_INT_OVERFLOW_CHECK)
+  if( num == MRBC_INT_MIN ) {
+    MRBC_INT_OVERFLOW( vm, v, -(mrbc_float_t)num );
+    return;
+  }
+#endif
   SET_INT_RETURN( -num );
 }
 
@@ -79,7 +85,20 @@ static void c_integer_power(struct VM *vm, mrbc_value v[], int argc)
 
     if( mrbc_integer(v[1]) < 0 ) x = 0;
     for( int i = 0; i < mrbc_integer(v[1]); i++ ) {
+#if defined(MRBC_INT_OVERFLOW_CHECK)
+      if( mrbc_int_mul_overflow( x, mrbc_integer(v[0]), &x ) ) {
+#if MRBC_USE_FLOAT
+	mrbc_float_t f = 1;
+	for( i = 0; i < mrbc_integer(v[1]); i++ ) {
+	  f *= mrbc_integer(v[0]);
+	}
+#endif
+	MRBC_INT_OVERFLOW( vm, v, f );
+	return;
+      }
+#else
       x *= mrbc_integer(v[0]);
+#endif
     }
     SET_INT_RETURN( x );
   }
@@ -110,6 +129,11 @@ static void c_integer_mod(struct VM *vm, mrbc_value v[], int argc)
     return;
   }
 
+  if( v1 == -1 ) {	// avoid overflow of MIN % -1
+    SET_INT_RETURN( 0 );
+    return;
+  }
+
   mrbc_int_t ret = v0 % v1;
 
   if( (ret != 0) && ((v0 ^ v1) < 0) ) ret += v1;
@@ -198,6 +222,12 @@ static void c_integer_rshift(struct VM *vm, mrbc_value v[], int argc)
 static void c_integer_abs(struct VM *vm, mrbc_value v[], int argc)
 {
   if( mrbc_integer(v[0]) < 0 ) {
+#if defined(MRBC_INT_OVERFLOW_CHECK)
+    if( mrbc_integer(v[0]) == MRBC_INT_MIN ) {
+      MRBC_INT_OVERFLOW( vm, v, -(mrbc_float_t)mrbc_integer(v[0]) );
+      return;
+    }
+#endif
     mrbc_integer(v[0]) = -mrbc_integer(v[0]);
   }
 }
@@ -229,14 +259,91 @@ static void c_numeric_clamp(struct VM *vm, mrbc_value v[], int argc)
     return;
   }
   if (mrbc_compare(&v[0], &min) < 0) {
+    mrbc_incref(&min);
     SET_RETURN(min);
     return;
   }
   if (mrbc_compare(&max, &v[0]) < 0) {
+    mrbc_incref(&max);
     SET_RETURN(max);
     return;
   }
-  SET_RETURN(v[0]); /* return self */
+  /* return self */
+}
+
+
+//================================================================
+/*! (method) times, upto, downto
+
+  The block is called by the VM. (see mrbc_iter_start)
+  work[0] is the counter, work[1] is the limit.
+*/
+static int c_integer_upto_step(struct VM *vm, mrbc_value *recv, mrbc_value *work, mrbc_value *blk)
+{
+  if( work[0].i > work[1].i ) return -1;
+
+  blk[1] = mrbc_integer_value( work[0].i++ );
+  return 1;
+}
+
+static int c_integer_downto_step(struct VM *vm, mrbc_value *recv, mrbc_value *work, mrbc_value *blk)
+{
+  if( work[0].i < work[1].i ) return -1;
+
+  blk[1] = mrbc_integer_value( work[0].i-- );
+  return 1;
+}
+
+static int c_integer_iter_limit(struct VM *vm, mrbc_value v[], int argc, mrbc_int_t *limit, int flag_ceil)
+{
+  if( argc != 1 ) {
+    mrbc_raise(vm, MRBC_CLASS(ArgumentError), "wrong number of arguments");
+    return -1;
+  }
+
+  switch( mrbc_type(v[1]) ) {
+  case MRBC_TT_INTEGER:
+    *limit = mrbc_integer(v[1]);
+    return 0;
+
+#if MRBC_USE_FLOAT
+  case MRBC_TT_FLOAT: {
+    mrbc_float_t f = mrbc_float(v[1]);
+    *limit = (mrbc_int_t)f;
+    if( !flag_ceil && *limit > f ) (*limit)--;
+    if( flag_ceil && *limit < f ) (*limit)++;
+    return 0;
+  }
+#endif
+
+  default:
+    mrbc_raise(vm, MRBC_CLASS(TypeError), "comparison failed");
+    return -1;
+  }
+}
+
+static void c_integer_times(struct VM *vm, mrbc_value v[], int argc)
+{
+  mrbc_iter_start( vm, v, argc, c_integer_upto_step,
+		   mrbc_integer_value(0), mrbc_integer_value(v->i - 1) );
+}
+
+static void c_integer_upto(struct VM *vm, mrbc_value v[], int argc)
+{
+  mrbc_int_t limit;
+  if( c_integer_iter_limit( vm, v, argc, &limit, 0 ) != 0 ) return;
+
+  mrbc_iter_start( vm, v, argc, c_integer_upto_step,
+		   mrbc_integer_value(v->i), mrbc_integer_value(limit) );
+}
+
+static void c_integer_downto(struct VM *vm, mrbc_value v[], int argc)
+{
+  mrbc_int_t limit;
+  if( c_integer_iter_limit( vm, v, argc, &limit, 1 ) != 0 ) return;
+
+  mrbc_iter_start( vm, v, argc, c_integer_downto_step,
+		   mrbc_integer_value(v->i), mrbc_integer_value(limit) );
 }
 
 
@@ -316,6 +423,9 @@ static void c_integer_inspect(struct VM *vm, mrbc_value v[], int argc)
   METHOD( "abs",	c_integer_abs )
   METHOD( "to_i",	c_ineffect )
   METHOD( "clamp",	c_numeric_clamp )
+  METHOD( "times",	c_integer_times )
+  METHOD( "upto",	c_integer_upto )
+  METHOD( "downto",	c_integer_downto )
 #if MRBC_USE_FLOAT
   METHOD( "to_f",	c_integer_to_f )
 #endif
@@ -332,6 +442,41 @@ static void c_integer_inspect(struct VM *vm, mrbc_value v[], int argc)
 /***** Float class **********************************************************/
 #if MRBC_USE_FLOAT
 
+#if defined(MRBC_USE_COMPACT_VALUE)
+//================================================================
+/*! constructor
+
+  @param  vm	pointer to VM.
+  @param  d	number.
+  @return	Float object, or nil and NoMemoryError is raised if no memory.
+*/
+mrbc_value mrbc_float_new(struct VM *vm, mrbc_float_t d)
+{
+  struct RFloat *h = mrbc_alloc(vm, sizeof(struct RFloat));
+  if( !h ) {	// ENOMEM
+    mrbc_raise(vm, MRBC_CLASS(NoMemoryError), 0);
+    return mrbc_nil_value();
+  }
+
+  MRBC_INIT_OBJECT_HEADER( h, "FL" );
+  h->d = d;
+
+  return (mrbc_value){.tt = MRBC_TT_FLOAT, .flt = h};
+}
+
+
+//================================================================
+/*! destructor
+
+  @param  v	pointer to target value.
+*/
+void mrbc_float_delete(mrbc_value *v)
+{
+  mrbc_raw_free( v->flt );
+}
+#endif
+
+
 //================================================================
 /*! (operator) unary +
 */
@@ -375,7 +520,7 @@ static void c_float_power(struct VM *vm, mrbc_value v[], int argc)
 static void c_float_abs(struct VM *vm, mrbc_value v[], int argc)
 {
   if( mrbc_float(v[0]) < 0 ) {
-    mrbc_float(v[0]) = -mrbc_float(v[0]);
+    SET_FLOAT_RETURN( -mrbc_float(v[0]) );
   }
 }
 
@@ -403,7 +548,7 @@ static void c_float_inspect(struct VM *vm, mrbc_value v[], int argc)
 
   char buf[16];
 
-  snprintf( buf, sizeof(buf), "%g", v->d );
+  snprintf( buf, sizeof(buf), "%g", mrbc_float(v[0]) );
   mrbc_value value = mrbc_string_new_cstr(vm, buf);
   SET_RETURN(value);
 }
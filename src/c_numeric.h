@@ -15,10 +15,153 @@
 #ifndef MRBC_SRC_C_NUMERIC_H_
 #define MRBC_SRC_C_NUMERIC_H_
 
+/***** Feature test switches ************************************************/
+/***** System headers *******************************************************/
+//@cond
+#include "vm_config.h"
+//@endcond
+
+/***** Local headers ********************************************************/
+#include "value.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
+/***** Constant values ******************************************************/
+#if defined(__clang__) || (defined(__GNUC__) && __GNUC__ >= 5)
+#define MRBC_HAS_BUILTIN_OVERFLOW
+#endif
+
+/***** Macros ***************************************************************/
+/*!
+  @def MRBC_INT_OVERFLOW(vm, v, d)
+  set the result of overflowed Integer operation to v.
+  d is the result calculated by Float. (raise RangeError without Float)
+*/
+#if MRBC_USE_FLOAT
+#define MRBC_INT_OVERFLOW(vm, v, d)	(*(v) = mrbc_float_value((vm), (d)))
+#else
+#define MRBC_INT_OVERFLOW(vm, v, d)	\
+  mrbc_raise((vm), MRBC_CLASS(RangeError), "integer overflow")
+#endif
+
+/***** Typedefs *************************************************************/
+#if MRBC_USE_FLOAT && defined(MRBC_USE_COMPACT_VALUE)
+//================================================================
+/*!@brief
+  Boxed Float object. (MRBC_USE_COMPACT_VALUE only)
+
+  @extends RBasic
+*/
+struct RFloat {
+  MRBC_OBJECT_HEADER;
+
+  mrbc_float_t d;		//!< value.
+};
+#endif
+
+
+/***** Global variables *****************************************************/
+/***** Function prototypes **************************************************/
+//@cond
+#if MRBC_USE_FLOAT && defined(MRBC_USE_COMPACT_VALUE)
+mrbc_value mrbc_float_new(struct VM *vm, mrbc_float_t d);
+void mrbc_float_delete(mrbc_value *v);
+#endif
+//@endcond
+
+
+/***** Inline functions *****************************************************/
+//================================================================
+/*! add Integers with overflow check.
+
+  @param  a	operand.
+  @param  b	operand.
+  @param  ret	pointer to the result. (wrapped around if overflow)
+  @return	non zero if overflow.
+*/
+static inline int mrbc_int_add_overflow(mrbc_int_t a, mrbc_int_t b, mrbc_int_t *ret)
+{
+#if defined(MRBC_HAS_BUILTIN_OVERFLOW)
+  return __builtin_add_overflow(a, b, ret);
+#else
+  mrbc_int_t r = (mrbc_int_t)((mrbc_uint_t)a + (mrbc_uint_t)b);
+  *ret = r;
+  return ((a ^ r) & (b ^ r)) < 0;
+#endif
+}
+
+
+//================================================================
+/*! subtract Integers with overflow check.
+
+  @param  a	operand.
+  @param  b	operand.
+  @param  ret	pointer to the result. (wrapped around if overflow)
+  @return	non zero if overflow.
+*/
+static inline int mrbc_int_sub_overflow(mrbc_int_t a, mrbc_int_t b, mrbc_int_t *ret)
+{
+#if defined(MRBC_HAS_BUILTIN_OVERFLOW)
+  return __builtin_sub_overflow(a, b, ret);
+#else
+  mrbc_int_t r = (mrbc_int_t)((mrbc_uint_t)a - (mrbc_uint_t)b);
+  *ret = r;
+  return ((a ^ b) & (a ^ r)) < 0;
+#endif
+}
+
+
+//================================================================
+/*! multiply Integers with overflow check.
+
+  @param  a	operand.
+  @param  b	operand.
+  @param  ret	pointer to the result.
+  @return	non zero if overflow.
+*/
+static inline int mrbc_int_mul_overflow(mrbc_int_t a, mrbc_int_t b, mrbc_int_t *ret)
+{
+#if defined(MRBC_HAS_BUILTIN_OVERFLOW)
+  return __builtin_mul_overflow(a, b, ret);
+#elif defined(MRBC_INT64)
+  if( a > 0 ? (b > 0 ? a > MRBC_INT_MAX / b : b < MRBC_INT_MIN / a)
+	    : (b > 0 ? a < MRBC_INT_MIN / b : (a != 0 && b < MRBC_INT_MAX / a)) ) {
+    return 1;
+  }
+  *ret = a * b;
+  return 0;
+#else
+  int64_t r = (int64_t)a * b;
+  *ret = (mrbc_int_t)r;
+  return r != *ret;
+#endif
+}
+
+
+#if MRBC_USE_FLOAT && defined(MRBC_USE_COMPACT_VALUE)
+//================================================================
+/*! set a Float to the value, release the old value.
+
+  The box is reused if the value is its only owner,
+  so the arithmetic on a Float local variable doesn't allocate memory.
+
+  @param  vm	pointer to VM.
+  @param  v	pointer to the target value.
+  @param  d	number.
+*/
+static inline void mrbc_float_replace(struct VM *vm, mrbc_value *v, mrbc_float_t d)
+{
+  if( v->tt == MRBC_TT_FLOAT && v->flt->ref_count == 1 ) {
+    v->flt->d = d;
+    return;
+  }
+
+  mrbc_value nv = mrbc_float_new(vm, d);
+  mrbc_decref(v);
+  *v = nv;
+}
+#endif
 
 
 #ifdef __cplusplus
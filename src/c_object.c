@@ -309,7 +309,7 @@ static void c_object_raise(struct VM *vm, mrbc_value v[], int argc)
   // case 2. raise "message"
   if( argc == 1 && mrbc_type(v[1]) == MRBC_TT_STRING ) {
     vm->exception = mrbc_exception_new( vm, MRBC_CLASS(RuntimeError),
-			mrbc_string_cstr(&v[1]), mrbc_string_size(&v[1]) );
+			mrbc_string_ptr(&v[1]), mrbc_string_size(&v[1]) );
   } else
 
   // case 3. raise ExceptionClass
@@ -328,14 +328,14 @@ static void c_object_raise(struct VM *vm, mrbc_value v[], int argc)
   if( argc == 2 && mrbc_type(v[1]) == MRBC_TT_CLASS
                 && mrbc_type(v[2]) == MRBC_TT_STRING ) {
     vm->exception = mrbc_exception_new( vm, v[1].cls,
-			mrbc_string_cstr(&v[2]), mrbc_string_size(&v[2]) );
+			mrbc_string_ptr(&v[2]), mrbc_string_size(&v[2]) );
   } else
 
   // case 6. raise ExceptionObject, "param"
   if( argc == 2 && mrbc_type(v[1]) == MRBC_TT_EXCEPTION
                 && mrbc_type(v[2]) == MRBC_TT_STRING ) {
     vm->exception = mrbc_exception_new( vm, v[1].exception->cls,
-			mrbc_string_cstr(&v[2]), mrbc_string_size(&v[2]) );
+			mrbc_string_ptr(&v[2]), mrbc_string_size(&v[2]) );
   } else {
 
     // fail.
@@ -590,6 +590,8 @@ static void c_object_include(struct VM *vm, mrbc_value v[], int argc)
     };
     self->super = alias;
   }
+
+  mrbc_method_cache_invalidate();
 }
 
 
@@ -637,12 +639,18 @@ static void c_object_sprintf(struct VM *vm, mrbc_value v[], int argc)
     return;
   }
 
+  const char *fstr = mrbc_string_cstr(format);
+  if( !fstr ) {
+    mrbc_raise(vm, MRBC_CLASS(NoMemoryError), 0);
+    return;
+  }
+
   int buflen = BUF_INC_STEP;
   char *buf = mrbc_alloc(vm, buflen);
   if( !buf ) { return; }	// ENOMEM raise?
 
   mrbc_printf_t pf;
-  mrbc_printf_init( &pf, buf, buflen, mrbc_string_cstr(format) );
+  mrbc_printf_init( &pf, buf, buflen, fstr );
 
   int i = 2;
   int ret;
@@ -663,13 +671,13 @@ static void c_object_sprintf(struct VM *vm, mrbc_value v[], int argc)
       if( mrbc_type(v[i]) == MRBC_TT_INTEGER ) {
 	ret = mrbc_printf_char( &pf, v[i].i );
       } else if( mrbc_type(v[i]) == MRBC_TT_STRING ) {
-	ret = mrbc_printf_char( &pf, mrbc_string_cstr(&v[i])[0] );
+	ret = mrbc_printf_char( &pf, mrbc_string_ptr(&v[i])[0] );
       }
       break;
 
     case 's':
       if( mrbc_type(v[i]) == MRBC_TT_STRING ) {
-	ret = mrbc_printf_bstr( &pf, mrbc_string_cstr(&v[i]),
+	ret = mrbc_printf_bstr( &pf, mrbc_string_ptr(&v[i]),
 				     mrbc_string_size(&v[i]), ' ');
       } else {
 	const char *s;
@@ -690,10 +698,16 @@ static void c_object_sprintf(struct VM *vm, mrbc_value v[], int argc)
 	ret = mrbc_printf_int( &pf, v[i].i, 10);
 #if MRBC_USE_FLOAT
       } else if( mrbc_type(v[i]) == MRBC_TT_FLOAT ) {
-	ret = mrbc_printf_int( &pf, (mrbc_int_t)v[i].d, 10);
+	ret = mrbc_printf_int( &pf, (mrbc_int_t)mrbc_float(v[i]), 10);
 #endif
       } else if( mrbc_type(v[i]) == MRBC_TT_STRING ) {
-	mrbc_int_t ival = atol(mrbc_string_cstr(&v[i]));
+	const char *s = mrbc_string_cstr(&v[i]);
+	if( !s ) {
+	  mrbc_raise(vm, MRBC_CLASS(NoMemoryError), 0);
+	  mrbc_free(vm, pf.buf);
+	  return;
+	}
+	mrbc_int_t ival = atol(s);
 	ret = mrbc_printf_int( &pf, ival, 10 );
       }
       break;
@@ -725,7 +739,7 @@ static void c_object_sprintf(struct VM *vm, mrbc_value v[], int argc)
     case 'g':
     case 'G':
       if( mrbc_type(v[i]) == MRBC_TT_FLOAT ) {
-	ret = mrbc_printf_float( &pf, v[i].d );
+	ret = mrbc_printf_float( &pf, mrbc_float(v[i]) );
       } else if( mrbc_type(v[i]) == MRBC_TT_INTEGER ) {
 	ret = mrbc_printf_float( &pf, v[i].i );
       }
@@ -768,7 +782,7 @@ static void c_object_sprintf(struct VM *vm, mrbc_value v[], int argc)
 static void c_object_printf(struct VM *vm, mrbc_value v[], int argc)
 {
   c_object_sprintf(vm, v, argc);
-  mrbc_nprint( mrbc_string_cstr(v), mrbc_string_size(v) );
+  mrbc_nprint( mrbc_string_ptr(v), mrbc_string_size(v) );
   SET_NIL_RETURN();
 }
 #endif
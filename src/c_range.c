@@ -163,6 +163,36 @@ static void c_range_exclude_end(struct VM *vm, mrbc_value v[], int argc)
 }
 
 
+//================================================================
+/*! (method) each
+
+  Integer range only. The block is called by the VM.
+  work[0] is the counter, work[1] is the limit.
+*/
+static int c_range_each_step(struct VM *vm, mrbc_value *recv, mrbc_value *work, mrbc_value *blk)
+{
+  if( work[0].i > work[1].i ) return -1;
+
+  blk[1] = mrbc_integer_value( work[0].i++ );
+  return 1;
+}
+
+static void c_range_each(struct VM *vm, mrbc_value v[], int argc)
+{
+  mrbc_range *range = v->range;
+
+  if( mrbc_type(range->first) != MRBC_TT_INTEGER ||
+      mrbc_type(range->last) != MRBC_TT_INTEGER ) {
+    mrbc_raise(vm, MRBC_CLASS(TypeError), "can't iterate");
+    return;
+  }
+
+  mrbc_int_t limit = mrbc_integer(range->last) - !!range->flag_exclude;
+  mrbc_iter_start( vm, v, argc, c_range_each_step,
+		   range->first, mrbc_integer_value(limit) );
+}
+
+
 
 #if MRBC_USE_STRING
 //================================================================
@@ -205,6 +235,7 @@ static void c_range_inspect(struct VM *vm, mrbc_value v[], int argc)
   METHOD("first",	c_range_first )
   METHOD("last",	c_range_last )
   METHOD("exclude_end?", c_range_exclude_end )
+  METHOD("each",		c_range_each )
 #if MRBC_USE_STRING
   METHOD("inspect",	c_range_inspect )
   METHOD("to_s",	c_range_inspect )
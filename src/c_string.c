@@ -50,6 +50,79 @@ static int is_space( int ch )
 }
 
 
+//================================================================
+/*! drop the reference to the shared buffer.
+
+  @param  h	pointer to string handle (view).
+*/
+static void string_release_shared( mrbc_string *h )
+{
+  mrbc_string *owner = h->shared;
+  h->shared = NULL;
+
+  if( --owner->ref_count == 0 ) {
+    mrbc_raw_free( owner->data );
+    mrbc_raw_free( owner );
+  }
+}
+
+
+//================================================================
+/*! make the string own a buffer of at least len bytes and '\0'.
+
+  @param  h	pointer to string handle.
+  @param  len	required buffer size without '\0'.
+  @return	mrbc_error_code
+*/
+static int string_reserve( mrbc_string *h, int len )
+{
+  uint8_t *str;
+
+  if( !h->shared ) {
+    if( len <= h->capa ) return 0;
+
+    str = mrbc_raw_realloc( h->data, len+1 );
+    if( !str ) return E_NOMEMORY_ERROR;
+
+  } else {
+    // copy out of the shared buffer.
+    if( len < h->size ) len = h->size;
+
+    str = mrbc_raw_alloc( len+1 );
+    if( !str ) return E_NOMEMORY_ERROR;
+    mrbc_set_vm_id( str, mrbc_get_vm_id(h) );
+
+    memcpy( str, h->data, h->size );
+    str[h->size] = '\0';
+    string_release_shared( h );
+  }
+
+  h->data = str;
+  h->capa = len;
+
+  return 0;
+}
+
+
+//================================================================
+/*! make room for appending, growing the buffer by half again.
+
+  @param  h	pointer to string handle.
+  @param  len	required buffer size without '\0'.
+  @return	mrbc_error_code
+*/
+static int string_grow( mrbc_string *h, int len )
+{
+  if( !h->shared && len <= h->capa ) return 0;
+
+  int capa = h->capa + (h->capa >> 1);
+  if( capa > (MRBC_STRING_SIZE_T)~0 ) capa = (MRBC_STRING_SIZE_T)~0;
+  if( capa < len ) capa = len;
+
+  return string_reserve( h, capa );
+}
+
+
 /***** Global functions *****************************************************/
 //================================================================
 /*! constructor
@@ -77,7 +150,9 @@ mrbc_value mrbc_string_new(struct VM *vm, const void *src, int len)
 
   MRBC_INIT_OBJECT_HEADER( h, "ST" );
   h->size = len;
+  h->capa = len;
   h->data = str;
+  h->shared = NULL;
 
   /*
     Copy a source string.
@@ -114,7 +189,9 @@ mrbc_value mrbc_string_new_alloc(struct VM *vm, void *buf, int len)
 
   MRBC_INIT_OBJECT_HEADER( h, "ST" );
   h->size = len;
+  h->capa = len;
   h->data = buf;
+  h->shared = NULL;
 
   value.string = h;
   return value;
@@ -128,7 +205,11 @@ mrbc_value mrbc_string_new_alloc(struct VM *vm, void *buf, int len)
 */
 void mrbc_string_delete(mrbc_value *str)
 {
-  mrbc_raw_free(str->string->data);
+  if( str->string->shared ) {
+    string_release_shared( str->string );
+  } else {
+    mrbc_raw_free(str->string->data);
+  }
   mrbc_raw_free(str->string);
 }
 
@@ -139,9 +220,19 @@ void mrbc_string_delete(mrbc_value *str)
 */
 void mrbc_string_clear(mrbc_value *str)
 {
-  mrbc_raw_realloc(str->string->data, 1);
-  str->string->data[0] = '\0';
-  str->string->size = 0;
+  mrbc_string *h = str->string;
+
+  h->size = 0;
+  if( h->shared ) {
+    if( string_reserve( h, 0 ) != 0 ) return;	// ENOMEM
+  } else {
+    uint8_t *p = mrbc_raw_realloc(h->data, 1);
+    if( p ) {
+      h->data = p;
+      h->capa = 0;
+    }
+  }
+  h->data[0] = '\0';
 }
 
 
@@ -151,8 +242,14 @@ void mrbc_string_clear(mrbc_value *str)
 */
 void mrbc_string_clear_vm_id(mrbc_value *str)
 {
-  mrbc_set_vm_id( str->string, 0 );
-  mrbc_set_vm_id( str->string->data, 0 );
+  mrbc_string *h = str->string;
+
+  mrbc_set_vm_id( h, 0 );
+  if( h->shared ) {
+    h = h->shared;
+    mrbc_set_vm_id( h, 0 );
+  }
+  mrbc_set_vm_id( h->data, 0 );
 }
 #endif
 
@@ -160,23 +257,86 @@ void mrbc_string_clear_vm_id(mrbc_value *str)
 //================================================================
 /*! duplicate string
 
+  The new string shares the buffer with s1 until either is modified.
+
   @param  vm	pointer to VM.
   @param  s1	pointer to target value
   @return	new string as s1 + s2
 */
 mrbc_value mrbc_string_dup(struct VM *vm, mrbc_value *s1)
 {
-  mrbc_string *h1 = s1->string;
+  return mrbc_string_substr( vm, s1, 0, s1->string->size );
+}
 
-  mrbc_value value = mrbc_string_new(vm, NULL, h1->size);
-  if( value.string == NULL ) return value;		// ENOMEM
 
-  memcpy( value.string->data, h1->data, h1->size + 1 );
+//================================================================
+/*! substring sharing the buffer (src[pos, len])
+
+  On first share, the buffer is handed over to a hidden owner object
+  and src itself becomes a view of it.
+
+  @param  vm	pointer to VM.
+  @param  src	pointer to source string.
+  @param  pos	start position. (must be in range)
+  @param  len	length. (must be in range)
+  @return	new string
+*/
+mrbc_value mrbc_string_substr(struct VM *vm, mrbc_value *src, int pos, int len)
+{
+  mrbc_string *h = src->string;
+  mrbc_string *owner = h->shared;
+
+  if( len < MRBC_STRING_SHARE_MIN || (owner && owner->ref_count == UINT16_MAX) ) {
+    return mrbc_string_new( vm, h->data + pos, len );
+  }
+
+  mrbc_value value = {.tt = MRBC_TT_STRING};
+  mrbc_string *view = mrbc_alloc(vm, sizeof(mrbc_string));
+  if( !view ) return value;		// ENOMEM
+
+  if( !owner ) {
+    owner = mrbc_alloc(vm, sizeof(mrbc_string));
+    if( !owner ) {			// ENOMEM
+      mrbc_raw_free( view );
+      return value;
+    }
+    mrbc_set_vm_id( owner, mrbc_get_vm_id(h) );
+    MRBC_INIT_OBJECT_HEADER( owner, "ST" );
+    owner->size = h->size;
+    owner->capa = h->capa;
+    owner->data = h->data;
+    owner->shared = NULL;
+
+    h->capa = 0;
+    h->shared = owner;
+  }
+
+  MRBC_INIT_OBJECT_HEADER( view, "ST" );
+  view->size = len;
+  view->capa = 0;
+  view->data = h->data + pos;
+  view->shared = owner;
+  owner->ref_count++;
 
+  value.string = view;
   return value;
 }
 
 
+//================================================================
+/*! make the string own its buffer, before writing to it.
+
+  @param  str	pointer to target value
+  @return	mrbc_error_code
+*/
+int mrbc_string_modify(mrbc_value *str)
+{
+  if( !str->string->shared ) return 0;
+
+  return string_reserve( str->string, str->string->size );
+}
+
+
 //================================================================
 /*! add string (s1 + s2)
 
@@ -194,7 +354,8 @@ mrbc_value mrbc_string_add(struct VM *vm, const mrbc_value *s1, const mrbc_value
   if( value.string == NULL ) return value;		// ENOMEM
 
   memcpy( value.string->data,            h1->data, h1->size );
-  memcpy( value.string->data + h1->size, h2->data, h2->size + 1 );
+  memcpy( value.string->data + h1->size, h2->data, h2->size );
+  value.string->data[ value.string->size ] = '\0';
 
   return value;
 }
@@ -212,18 +373,17 @@ int mrbc_string_append(mrbc_value *s1, const mrbc_value *s2)
   int len1 = s1->string->size;
   int len2 = (mrbc_type(*s2) == MRBC_TT_STRING) ? s2->string->size : 1;
 
-  uint8_t *str = mrbc_raw_realloc(s1->string->data, len1+len2+1);
-  if( !str ) return E_NOMEMORY_ERROR;
+  if( string_grow( s1->string, len1+len2 ) != 0 ) return E_NOMEMORY_ERROR;
+  uint8_t *str = s1->string->data;
 
   if( mrbc_type(*s2) == MRBC_TT_STRING ) {
-    memcpy(str + len1, s2->string->data, len2 + 1);
+    memcpy(str + len1, s2->string->data, len2);
   } else if( mrbc_type(*s2) == MRBC_TT_INTEGER ) {
     str[len1] = s2->i;
-    str[len1+1] = '\0';
   }
+  str[len1 + len2] = '\0';
 
   s1->string->size = len1 + len2;
-  s1->string->data = str;
 
   return 0;
 }
@@ -241,8 +401,8 @@ int mrbc_string_append_cbuf(mrbc_value *s1, const void *s2, int len2)
 {
   int len1 = s1->string->size;
 
-  uint8_t *str = mrbc_raw_realloc(s1->string->data, len1+len2+1);
-  if( !str ) return E_NOMEMORY_ERROR;
+  if( string_grow( s1->string, len1+len2 ) != 0 ) return E_NOMEMORY_ERROR;
+  uint8_t *str = s1->string->data;
 
   if( s2 ) {
     memcpy(str + len1, s2, len2);
@@ -252,7 +412,6 @@ int mrbc_string_append_cbuf(mrbc_value *s1, const void *s2, int len2)
   }
 
   s1->string->size = len1 + len2;
-  s1->string->data = str;
 
   return 0;
 }
@@ -268,13 +427,13 @@ int mrbc_string_append_cbuf(mrbc_value *s1, const void *s2, int len2)
 */
 int mrbc_string_index(const mrbc_value *src, const mrbc_value *pattern, int offset)
 {
-  char *p1 = mrbc_string_cstr(src) + offset;
-  char *p2 = mrbc_string_cstr(pattern);
+  const char *p1 = mrbc_string_ptr(src) + offset;
+  const char *p2 = mrbc_string_ptr(pattern);
   int try_cnt = mrbc_string_size(src) - mrbc_string_size(pattern) - offset;
 
   while( try_cnt >= 0 ) {
     if( memcmp( p1, p2, mrbc_string_size(pattern) ) == 0 ) {
-      return p1 - mrbc_string_cstr(src);	// matched.
+      return p1 - mrbc_string_ptr(src);	// matched.
     }
     try_cnt--;
     p1++;
@@ -293,7 +452,7 @@ int mrbc_string_index(const mrbc_value *src, const mrbc_value *pattern, int offs
 */
 int mrbc_string_strip(mrbc_value *src, int mode)
 {
-  char *p1 = mrbc_string_cstr(src);
+  char *p1 = (char *)src->string->data;
   char *p2 = p1 + mrbc_string_size(src) - 1;
 
   // left-side
@@ -315,10 +474,21 @@ int mrbc_string_strip(mrbc_value *src, int mode)
   int new_size = p2 - p1 + 1;
   if( mrbc_string_size(src) == new_size ) return 0;
 
-  char *buf = mrbc_string_cstr(src);
+  // a view only narrows the window.
+  if( src->string->shared ) {
+    src->string->data = (uint8_t *)p1;
+    src->string->size = new_size;
+    return 1;
+  }
+
+  char *buf = (char *)src->string->data;
   if( p1 != buf ) memmove( buf, p1, new_size );
   buf[new_size] = '\0';
-  mrbc_raw_realloc(buf, new_size+1);	// shrink suitable size.
+  buf = mrbc_raw_realloc(buf, new_size+1);	// shrink suitable size.
+  if( buf ) {
+    src->string->data = (uint8_t *)buf;
+    src->string->capa = new_size;
+  }
   src->string->size = new_size;
 
   return 1;
@@ -333,21 +503,22 @@ int mrbc_string_strip(mrbc_value *src, int mode)
 */
 int mrbc_string_chomp(mrbc_value *src)
 {
-  char *p1 = mrbc_string_cstr(src);
+  if( mrbc_string_size(src) == 0 ) return 0;
+
+  char *p1 = (char *)src->string->data;
   char *p2 = p1 + mrbc_string_size(src) - 1;
 
   if( *p2 == '\n' ) {
     p2--;
   }
-  if( *p2 == '\r' ) {
+  if( p1 <= p2 && *p2 == '\r' ) {
     p2--;
   }
 
   int new_size = p2 - p1 + 1;
   if( mrbc_string_size(src) == new_size ) return 0;
 
-  char *buf = mrbc_string_cstr(src);
-  buf[new_size] = '\0';
+  if( !src->string->shared ) p1[new_size] = '\0';
   src->string->size = new_size;
 
   return 1;
@@ -368,6 +539,10 @@ int mrbc_string_upcase(mrbc_value *str)
   while (len != 0) {
     len--;
     if ('a' <= data[len] && data[len] <= 'z') {
+      if( count == 0 ) {	// copy-on-write
+	if( mrbc_string_modify(str) != 0 ) return 0;
+	data = str->string->data;
+      }
       data[len] = data[len] - ('a' - 'A');
       count++;
     }
@@ -390,6 +565,10 @@ int mrbc_string_downcase(mrbc_value *str)
   while (len != 0) {
     len--;
     if ('A' <= data[len] && data[len] <= 'Z') {
+      if( count == 0 ) {	// copy-on-write
+	if( mrbc_string_modify(str) != 0 ) return 0;
+	data = str->string->data;
+      }
       data[len] = data[len] + ('a' - 'A');
       count++;
     }
@@ -459,7 +638,7 @@ static void c_string_mul(struct VM *vm, mrbc_value v[], int argc)
 
   uint8_t *p = value.string->data;
   for( int i = 0; i < v[1].i; i++ ) {
-    memcpy( p, mrbc_string_cstr(&v[0]), mrbc_string_size(&v[0]) );
+    memcpy( p, mrbc_string_ptr(&v[0]), mrbc_string_size(&v[0]) );
     p += mrbc_string_size(&v[0]);
   }
   *p = 0;
@@ -495,7 +674,12 @@ static void c_string_to_i(struct VM *vm, mrbc_value v[], int argc)
     }
   }
 
-  mrbc_int_t i = mrbc_atoi( mrbc_string_cstr(v), base );
+  const char *s = mrbc_string_cstr(v);
+  if( !s ) {
+    mrbc_raise(vm, MRBC_CLASS(NoMemoryError), 0);
+    return;
+  }
+  mrbc_int_t i = mrbc_atoi( s, base );
 
   SET_INT_RETURN( i );
 }
@@ -507,7 +691,12 @@ static void c_string_to_i(struct VM *vm, mrbc_value v[], int argc)
 */
 static void c_string_to_f(struct VM *vm, mrbc_value v[], int argc)
 {
-  mrbc_float_t d = atof(mrbc_string_cstr(v));
+  const char *s = mrbc_string_cstr(v);
+  if( !s ) {
+    mrbc_raise(vm, MRBC_CLASS(NoMemoryError), 0);
+    return;
+  }
+  mrbc_float_t d = atof(s);
 
   SET_FLOAT_RETURN( d );
 }
@@ -589,7 +778,7 @@ static void c_string_slice(struct VM *vm, mrbc_value v[], int argc)
   if( v[1].tt == MRBC_TT_RANGE && len < 0 ) len = 0;
   if( len < 0 ) goto RETURN_NIL;
 
-  mrbc_value ret = mrbc_string_new(vm, mrbc_string_cstr(v) + pos, len);
+  mrbc_value ret = mrbc_string_substr(vm, v, pos, len);
   if( !ret.string ) goto RETURN_NIL;		// ENOMEM
 
   SET_RETURN(ret);
@@ -666,21 +855,13 @@ static void c_string_insert(struct VM *vm, mrbc_value v[], int argc)
   }
 
   int len3 = len1 + len2 - len;			// final length.
+  if( string_reserve( v->string, len3 ) != 0 ) return;	// expand, or copy-on-write
   uint8_t *str = v->string->data;
-  if( len1 < len3 ) {
-    str = mrbc_realloc(vm, str, len3+1);	// expand
-    if( !str ) return;
-  }
 
   memmove( str + pos + len2, str + pos + len, len1 - pos - len + 1 );
-  memcpy( str + pos, mrbc_string_cstr(val), len2 );
+  memcpy( str + pos, mrbc_string_ptr(val), len2 );
 
-  if( len1 > len3 ) {
-    str = mrbc_realloc(vm, str, len3+1);	// shrink
-  }
-
-  v->string->size = len1 + len2 - len;
-  v->string->data = str;
+  v->string->size = len3;
 
   // return val
   mrbc_decref(&v[0]);
@@ -756,7 +937,7 @@ static void c_string_getbyte(struct VM *vm, mrbc_value v[], int argc)
     idx += len;
   }
   if( idx >= 0 ) {
-    SET_INT_RETURN( ((uint8_t *)mrbc_string_cstr(&v[0]))[idx] );
+    SET_INT_RETURN( ((const uint8_t *)mrbc_string_ptr(&v[0]))[idx] );
   } else {
     SET_NIL_RETURN();
   }
@@ -785,7 +966,8 @@ static void c_string_setbyte(struct VM *vm, mrbc_value v[], int argc)
     return;
   }
 
-  mrbc_string_cstr(&v[0])[idx] = dat;
+  if( mrbc_string_modify(&v[0]) != 0 ) return;	// ENOMEM
+  v[0].string->data[idx] = dat;
 
   SET_INT_RETURN( dat );
 }
@@ -830,7 +1012,7 @@ static void c_string_inspect(struct VM *vm, mrbc_value v[], int argc)
 {
   char buf[10] = "\\x";
   mrbc_value ret = mrbc_string_new_cstr(vm, "\"");
-  const unsigned char *s = (const unsigned char *)mrbc_string_cstr(v);
+  const unsigned char *s = (const unsigned char *)mrbc_string_ptr(v);
 
   for( int i = 0; i < mrbc_string_size(v); i++ ) {
     if( s[i] < ' ' || 0x7f <= s[i] ) {	// tiny isprint()
@@ -858,7 +1040,7 @@ static void c_string_ord(struct VM *vm, mrbc_value v[], int argc)
     return;
   }
 
-  int i = ((uint8_t *)mrbc_string_cstr(v))[0];
+  int i = ((const uint8_t *)mrbc_string_ptr(v))[0];
 
   SET_INT_RETURN( i );
 }
@@ -894,14 +1076,15 @@ static void c_string_slice_self(struct VM *vm, mrbc_value v[], int argc)
   if( len < 0 ) goto RETURN_NIL;
   if( argc == 1 && len <= 0 ) goto RETURN_NIL;
 
-  mrbc_value ret = mrbc_string_new(vm, mrbc_string_cstr(v) + pos, len);
+  if( len > 0 && mrbc_string_modify(v) != 0 ) goto RETURN_NIL;	// ENOMEM
+  mrbc_value ret = mrbc_string_new(vm, mrbc_string_ptr(v) + pos, len);
   if( !ret.string ) goto RETURN_NIL;		// ENOMEM
 
   if( len > 0 ) {
-    memmove( mrbc_string_cstr(v) + pos, mrbc_string_cstr(v) + pos + len,
-	     mrbc_string_size(v) - pos - len + 1 );
+    // keep the capacity for following appends.
+    uint8_t *str = v->string->data;
+    memmove( str + pos, str + pos + len, mrbc_string_size(v) - pos - len + 1 );
     v->string->size = mrbc_string_size(v) - len;
-    mrbc_raw_realloc( mrbc_string_cstr(v), mrbc_string_size(v)+1 );
   }
 
   SET_RETURN(ret);
@@ -950,7 +1133,7 @@ static void c_string_split(struct VM *vm, mrbc_value v[], int argc)
     return;
   }
 
-  int flag_strip = (mrbc_string_cstr(&sep)[0] == ' ') &&
+  int flag_strip = (mrbc_string_ptr(&sep)[0] == ' ') &&
 		   (mrbc_string_size(&sep) == 1);
   int offset = 0;
   int sep_len = mrbc_string_size(&sep);
@@ -961,7 +1144,7 @@ static void c_string_split(struct VM *vm, mrbc_value v[], int argc)
 
     if( flag_strip ) {
       for( ; offset < mrbc_string_size(&v[0]); offset++ ) {
-	if( !is_space( mrbc_string_cstr(&v[0])[offset] )) break;
+	if( !is_space( mrbc_string_ptr(&v[0])[offset] )) break;
       }
       if( offset > mrbc_string_size(&v[0])) break;
     }
@@ -976,7 +1159,7 @@ static void c_string_split(struct VM *vm, mrbc_value v[], int argc)
     if( flag_strip ) {
       pos = offset;
       for( ; pos < mrbc_string_size(&v[0]); pos++ ) {
-	if( is_space( mrbc_string_cstr(&v[0])[pos] )) break;
+	if( is_space( mrbc_string_ptr(&v[0])[pos] )) break;
       }
       len = pos - offset;
       goto SPLIT_ITEM;
@@ -997,7 +1180,7 @@ static void c_string_split(struct VM *vm, mrbc_value v[], int argc)
   SPLIT_ITEM:
     if( pos < 0 ) len = mrbc_string_size(&v[0]) - offset;
 
-    mrbc_value v1 = mrbc_string_new(vm, mrbc_string_cstr(&v[0]) + offset, len);
+    mrbc_value v1 = mrbc_string_substr(vm, &v[0], offset, len);
     mrbc_array_push( &ret, &v1 );
 
     if( pos < 0 ) break;
@@ -1104,7 +1287,12 @@ static void c_string_strip_self(struct VM *vm, mrbc_value v[], int argc)
 */
 static void c_string_to_sym(struct VM *vm, mrbc_value v[], int argc)
 {
-  mrbc_value ret = mrbc_symbol_new(vm, mrbc_string_cstr(&v[0]));
+  const char *s = mrbc_string_cstr(&v[0]);
+  if( !s ) {
+    mrbc_raise(vm, MRBC_CLASS(NoMemoryError), 0);
+    return;
+  }
+  mrbc_value ret = mrbc_symbol_new(vm, s);
 
   SET_RETURN(ret);
 }
@@ -1139,7 +1327,7 @@ static void tr_free_pattern( struct tr_pattern *pat )
 
 static struct tr_pattern * tr_parse_pattern( struct VM *vm, const mrbc_value *v_pattern, int flag_reverse_enable )
 {
-  const char *pattern = mrbc_string_cstr( v_pattern );
+  const char *pattern = mrbc_string_ptr( v_pattern );
   int pattern_length = mrbc_string_size( v_pattern );
   int flag_reverse = 0;
   struct tr_pattern *ret = NULL;
@@ -1253,13 +1441,17 @@ static int tr_main( struct VM *vm, mrbc_value v[], int argc )
   struct tr_pattern *rep = tr_parse_pattern( vm, &v[2], 0 );
 
   int flag_changed = 0;
-  char *s = mrbc_string_cstr( &v[0] );
+  char *s = (char *)v[0].string->data;
   int len = mrbc_string_size( &v[0] );
 
   for( int i = 0; i < len; i++ ) {
     int n = tr_find_character( pat, s[i] );
     if( n < 0 ) continue;
 
+    if( !flag_changed ) {	// copy-on-write
+      if( mrbc_string_modify( &v[0] ) != 0 ) break;
+      s = (char *)v[0].string->data;
+    }
     flag_changed = 1;
     if( rep == NULL ) {
       memmove( s + i, s + i + 1, len - i );
@@ -1273,15 +1465,17 @@ static int tr_main( struct VM *vm, mrbc_value v[], int argc )
   tr_free_pattern( pat );
   tr_free_pattern( rep );
 
-  v[0].string->size = len;
-  v[0].string->data[len] = 0;
+  if( flag_changed ) {
+    v[0].string->size = len;
+    v[0].string->data[len] = 0;
+  }
 
   return flag_changed;
 }
 
 static void c_string_tr(struct VM *vm, mrbc_value v[], int argc)
 {
-  mrbc_value ret = mrbc_string_dup( vm, &v[0] );
+  mrbc_value ret = mrbc_string_new( vm, mrbc_string_ptr(&v[0]), mrbc_string_size(&v[0]) );
   SET_RETURN( ret );
   tr_main(vm, v, argc);
 }
@@ -1314,7 +1508,7 @@ static void c_string_start_with(struct VM *vm, mrbc_value v[], int argc)
   if( mrbc_string_size(&v[0]) < mrbc_string_size(&v[1]) ) {
     ret = 0;
   } else {
-    ret = (memcmp( mrbc_string_cstr(&v[0]), mrbc_string_cstr(&v[1]),
+    ret = (memcmp( mrbc_string_ptr(&v[0]), mrbc_string_ptr(&v[1]),
 		   mrbc_string_size(&v[1]) ) == 0);
   }
 
@@ -1337,7 +1531,7 @@ static void c_string_end_with(struct VM *vm, mrbc_value v[], int argc)
   if( offset < 0 ) {
     ret = 0;
   } else {
-    ret = (memcmp( mrbc_string_cstr(&v[0]) + offset, mrbc_string_cstr(&v[1]),
+    ret = (memcmp( mrbc_string_ptr(&v[0]) + offset, mrbc_string_ptr(&v[1]),
 		   mrbc_string_size(&v[1]) ) == 0);
   }
 
@@ -1384,7 +1578,7 @@ static void c_string_bytes(struct VM *vm, mrbc_value v[], int argc)
 */
 static void c_string_upcase(struct VM *vm, mrbc_value v[], int argc)
 {
-  mrbc_value ret = mrbc_string_dup(vm, &v[0]);
+  mrbc_value ret = mrbc_string_new(vm, mrbc_string_ptr(&v[0]), mrbc_string_size(&v[0]));
   mrbc_string_upcase(&ret);
   SET_RETURN(ret);
 }
@@ -1405,7 +1599,7 @@ static void c_string_upcase_self(struct VM *vm, mrbc_value v[], int argc)
 */
 static void c_string_downcase(struct VM *vm, mrbc_value v[], int argc)
 {
-  mrbc_value ret = mrbc_string_dup(vm, &v[0]);
+  mrbc_value ret = mrbc_string_new(vm, mrbc_string_ptr(&v[0]), mrbc_string_size(&v[0]));
   mrbc_string_downcase(&ret);
   SET_RETURN(ret);
 }
@@ -33,6 +33,11 @@ extern "C" {
 #define MRBC_STRING_SIZE_T uint16_t
 #endif
 
+// Substrings shorter than this are copied instead of shared.
+#if !defined(MRBC_STRING_SHARE_MIN)
+#define MRBC_STRING_SHARE_MIN 4
+#endif
+
 /***** Macros ***************************************************************/
 #define RSTRING_LEN(str)	mrbc_string_size(&str)
 #define RSTRING_PTR(str)	mrbc_string_cstr(&str)
@@ -42,13 +47,21 @@ extern "C" {
 /*!@brief
   String object.
 
+  A string either owns its buffer, or is a view into a buffer owned by
+  the hidden string object pointed by `shared`. Views are read-only;
+  any destructive method copies the bytes out first (copy-on-write).
+  A view is not always terminated by '\0', use mrbc_string_cstr() when
+  a C string is needed.
+
   @extends RBasic
 */
 typedef struct RString {
   MRBC_OBJECT_HEADER;
 
   MRBC_STRING_SIZE_T size;	//!< string length.
+  MRBC_STRING_SIZE_T capa;	//!< buffer size without '\0'. 0 if shared.
   uint8_t *data;		//!< pointer to allocated buffer.
+  struct RString *shared;	//!< owner of the shared buffer, or NULL.
 
 } mrbc_string;
 
@@ -62,6 +75,8 @@ void mrbc_string_delete(mrbc_value *str);
 void mrbc_string_clear(mrbc_value *str);
 void mrbc_string_clear_vm_id(mrbc_value *str);
 mrbc_value mrbc_string_dup(struct VM *vm, mrbc_value *s1);
+mrbc_value mrbc_string_substr(struct VM *vm, mrbc_value *src, int pos, int len);
+int mrbc_string_modify(mrbc_value *str);
 mrbc_value mrbc_string_add(struct VM *vm, const mrbc_value *s1, const mrbc_value *s2);
 int mrbc_string_append(mrbc_value *s1, const mrbc_value *s2);
 int mrbc_string_append_cbuf(mrbc_value *s1, const void *s2, int len2);
@@ -110,11 +125,25 @@ static inline int mrbc_string_size(const mrbc_value *str)
   return str->string->size;
 }
 
+//================================================================
+/*! get pointer to the bytes, not always terminated by '\0'.
+*/
+static inline const char * mrbc_string_ptr(const mrbc_value *v)
+{
+  return (const char*)v->string->data;
+}
+
 //================================================================
 /*! get c-language string (char *)
+
+  A view that ends before its owner's '\0' is copied out first.
+  @return	pointer to the string, or NULL if no memory to copy.
 */
 static inline char * mrbc_string_cstr(const mrbc_value *v)
 {
+  if( v->string->shared && v->string->data[v->string->size] != '\0' ) {
+    if( mrbc_string_modify( (mrbc_value *)v ) != 0 ) return NULL; // ENOMEM
+  }
   return (char*)v->string->data;
 }
 
@@ -53,6 +53,9 @@ mrbc_class * const mrbc_class_tbl[MRBC_TT_MAXVAL+1] = {
   0,                            // MRBC_TT_EXCEPTION = 15,
 };
 
+//! method definition epoch. incremented when any method is (re)defined.
+uint32_t mrbc_method_epoch;
+
 
 /***** Signal catching functions ********************************************/
 /***** Local functions ******************************************************/
@@ -317,6 +320,8 @@ void mrbc_define_method(struct VM *vm, mrbc_class *cls, const char *name, mrbc_f
   method->func = cfunc;
   method->next = cls->method_link;
   cls->method_link = method;
+
+  mrbc_method_cache_invalidate();
 }
 
 
@@ -627,6 +632,30 @@ int mrbc_run_mrblib(const void *bytecode)
 #include "_autogen_builtin_class.h"
 #undef MRBC_DEFINE_BUILTIN_CLASS_TABLE
 
+//================================================================
+/*! drop the methods in the method link, that the class also has
+    as a built-in (native) method.
+*/
+static void drop_shadowed_methods( mrbc_class *cls )
+{
+  const struct RBuiltinClass *c = (const struct RBuiltinClass *)cls;
+  mrbc_method **pp = &cls->method_link;
+
+  while( *pp ) {
+    mrbc_method *method = *pp;
+    int i;
+    for( i = 0; i < c->num_builtin_method; i++ ) {
+      if( c->method_symbols[i] == method->sym_id ) break;
+    }
+    if( i < c->num_builtin_method ) {
+      *pp = method->next;
+    } else {
+      pp = &method->next;
+    }
+  }
+}
+
+
 //================================================================
 /*! initialize all classes.
  */
@@ -652,4 +681,10 @@ void mrbc_init_class(void)
 
   extern const uint8_t mrblib_bytecode[];
   mrbc_run_mrblib(mrblib_bytecode);
+
+  // native methods take precedence over the ones defined in mrblib.
+  for( int i = 0; i < sizeof(MRBC_BuiltinClass)/sizeof(struct MRBC_BuiltinClass); i++ ) {
+    drop_shadowed_methods( MRBC_BuiltinClass[i].cls );
+  }
+  mrbc_method_cache_invalidate();
 }
@@ -182,6 +182,16 @@ typedef struct RMethod {
 } mrbc_method;
 
 
+//================================================================
+/*!@brief
+  Return value structure for mrbc_method_cache_statistics function.
+*/
+struct MRBC_METHOD_CACHE_STATISTICS {
+  unsigned long hit;		//!< num of cache hits.
+  unsigned long miss;		//!< num of cache misses.
+};
+
+
 //================================================================
 /*!@brief
   for mrbc_define_method_list function.
@@ -194,6 +204,7 @@ struct MRBC_DEFINE_METHOD_LIST {
 
 /***** Global variables *****************************************************/
 extern struct RClass * const mrbc_class_tbl[];
+extern uint32_t mrbc_method_epoch;
 #include "_autogen_builtin_class.h"
 
 // for old version compatibility.
@@ -253,6 +264,18 @@ static inline mrbc_class *find_class_by_object(const mrbc_value *obj)
 }
 
 
+//================================================================
+/*! Invalidate all inline method caches.
+
+  @details
+  Call this when a method table or class hierarchy is changed.
+*/
+static inline void mrbc_method_cache_invalidate(void)
+{
+  mrbc_method_epoch++;
+}
+
+
 //================================================================
 /*! Define the destructor
 
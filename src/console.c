@@ -351,7 +351,7 @@ int mrbc_p_sub(const mrbc_value *v)
 #if MRBC_USE_STRING
   case MRBC_TT_STRING:{
     mrbc_putchar('"');
-    const unsigned char *s = (const unsigned char *)mrbc_string_cstr(v);
+    const unsigned char *s = (const unsigned char *)mrbc_string_ptr(v);
 
     for( int i = 0; i < mrbc_string_size(v); i++ ) {
       if( s[i] < ' ' || 0x7f <= s[i] ) {	// tiny isprint()
@@ -379,7 +379,7 @@ int mrbc_p_sub(const mrbc_value *v)
 
 #if 0
   // display reference counter
-  if( mrbc_type(*v) > MRBC_TT_INC_DEC_THRESHOLD ) {
+  if( MRBC_TT_HAS_REFCOUNT(mrbc_type(*v)) ) {
     mrbc_printf("#%d", v->obj->ref_count);
   }
 #endif
@@ -429,7 +429,7 @@ int mrbc_print_sub(const mrbc_value *v)
   case MRBC_TT_TRUE:	mrbc_print("true");		break;
   case MRBC_TT_INTEGER:	mrbc_printf("%D", v->i);	break;
 #if MRBC_USE_FLOAT
-  case MRBC_TT_FLOAT:	mrbc_printf("%g", v->d);	break;
+  case MRBC_TT_FLOAT:	mrbc_printf("%g", mrbc_float(*v));	break;
 #endif
   case MRBC_TT_SYMBOL:	mrbc_print_symbol(v->sym_id);	break;
   case MRBC_TT_CLASS:   // fall through.
@@ -467,9 +467,9 @@ int mrbc_print_sub(const mrbc_value *v)
 
 #if MRBC_USE_STRING
   case MRBC_TT_STRING:
-    mrbc_nprint( mrbc_string_cstr(v), mrbc_string_size(v) );
+    mrbc_nprint( mrbc_string_ptr(v), mrbc_string_size(v) );
     if( mrbc_string_size(v) != 0 &&
-	mrbc_string_cstr(v)[ mrbc_string_size(v) - 1 ] == '\n' ) ret = 1;
+	mrbc_string_ptr(v)[ mrbc_string_size(v) - 1 ] == '\n' ) ret = 1;
     break;
 #endif
 
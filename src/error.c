@@ -266,7 +266,7 @@ static void c_exception_new(struct VM *vm, mrbc_value v[], int argc)
 
   mrbc_value value;
   if( argc == 1 && mrbc_type(v[1]) == MRBC_TT_STRING ) {
-    value = mrbc_exception_new(vm, v[0].cls, mrbc_string_cstr(&v[1]), mrbc_string_size(&v[1]));
+    value = mrbc_exception_new(vm, v[0].cls, mrbc_string_ptr(&v[1]), mrbc_string_size(&v[1]));
   } else {
     value = mrbc_exception_new(vm, v[0].cls, NULL, 0);
   }
@@ -29,6 +29,10 @@ static mrbc_kv_handle handle_const;	//!< for global(Object) constants.
 static mrbc_kv_handle handle_global;	//!< for global variables.
 
 /***** Global variables *****************************************************/
+//! constant definition serial. incremented when any constant is (re)defined.
+uint32_t mrbc_const_serial;
+
+
 /***** Signal catching functions ********************************************/
 /***** Local functions ******************************************************/
 /***** Global functions *****************************************************/
@@ -40,6 +44,7 @@ void mrbc_init_global(void)
 {
   mrbc_kv_init_handle( 0, &handle_const, 30 );
   mrbc_kv_init_handle( 0, &handle_global, 0 );
+  mrbc_const_serial++;
 }
 
 
@@ -49,12 +54,15 @@ void mrbc_init_global(void)
   @param  sym_id	symbol ID.
   @param  v		pointer to mrbc_value.
   @return		mrbc_error_code.
+  @details
+  This invalidates all constant caches, because the table may move.
 */
 int mrbc_set_const( mrbc_sym sym_id, mrbc_value *v )
 {
   if( mrbc_kv_get( &handle_const, sym_id ) != NULL ) {
     mrbc_printf("warning: already initialized constant.\n");
   }
+  mrbc_const_serial++;
 
   return mrbc_kv_set( &handle_const, sym_id, v );
 }
@@ -75,7 +83,7 @@ int mrbc_set_class_const( const struct RClass *cls, mrbc_sym sym_id, mrbc_value
   make_nested_symbol_s( buf, cls->sym_id, sym_id );
   mrbc_sym id = mrbc_symbol( mrbc_symbol_new( 0, buf ));
 
-  return mrbc_set_const( id, v );
+  return mrbc_set_const( id, v );	// includes mrbc_const_serial++
 }
 
 
@@ -219,7 +227,7 @@ void mrbc_debug_dump_const( void )
 
     mrbc_printf(" = ");
     mrbc_p_sub( &kv->value );
-    if( mrbc_type(kv->value) <= MRBC_TT_INC_DEC_THRESHOLD ) {
+    if( !MRBC_TT_HAS_REFCOUNT(mrbc_type(kv->value)) ) {
       mrbc_printf(".tt=%d\n", mrbc_type(kv->value));
     } else {
       mrbc_printf(".tt=%d.ref=%d\n", mrbc_type(kv->value), kv->value.obj->ref_count);
@@ -244,7 +252,7 @@ void mrbc_debug_dump_global( void )
 
     mrbc_printf(" %04x:%s = ", kv->sym_id, mrbc_symid_to_str(kv->sym_id));
     mrbc_p_sub( &kv->value );
-    if( mrbc_type(kv->value) <= MRBC_TT_INC_DEC_THRESHOLD ) {
+    if( !MRBC_TT_HAS_REFCOUNT(mrbc_type(kv->value)) ) {
       mrbc_printf(" .tt=%d\n", mrbc_type(kv->value));
     } else {
       mrbc_printf(" .tt=%d refcnt=%d\n", mrbc_type(kv->value), kv->value.obj->ref_count);
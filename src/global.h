@@ -26,6 +26,8 @@ extern "C" {
 /***** Macros ***************************************************************/
 /***** Typedefs *************************************************************/
 /***** Global variables *****************************************************/
+extern uint32_t mrbc_const_serial;
+
 /***** Function prototypes **************************************************/
 //@cond
 void mrbc_init_global(void);
@@ -299,6 +299,23 @@ mrbc_value * mrbc_kv_get(mrbc_kv_handle *kvh, mrbc_sym sym_id)
 }
 
 
+//================================================================
+/*! get the index of data
+
+  @param  kvh		pointer to key-value handle.
+  @param  sym_id	symbol ID.
+  @return		index of kvh->data, or -1 if not found.
+*/
+int mrbc_kv_index(mrbc_kv_handle *kvh, mrbc_sym sym_id)
+{
+  int idx = binary_search(kvh, sym_id);
+  if( idx < 0 ) return -1;
+  if( kvh->data[idx].sym_id != sym_id ) return -1;
+
+  return idx;
+}
+
+
 #if 0
 //================================================================
 /*! setter - only append tail
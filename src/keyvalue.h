@@ -83,6 +83,7 @@ void mrbc_kv_clear_vm_id(mrbc_kv_handle *kvh);
 int mrbc_kv_resize(mrbc_kv_handle *kvh, int size);
 int mrbc_kv_set(mrbc_kv_handle *kvh, mrbc_sym sym_id, mrbc_value *set_val);
 mrbc_value *mrbc_kv_get(mrbc_kv_handle *kvh, mrbc_sym sym_id);
+int mrbc_kv_index(mrbc_kv_handle *kvh, mrbc_sym sym_id);
 int mrbc_kv_append(mrbc_kv_handle *kvh, mrbc_sym sym_id, mrbc_value *set_val);
 int mrbc_kv_reorder(mrbc_kv_handle *kvh);
 int mrbc_kv_remove(mrbc_kv_handle *kvh, mrbc_sym sym_id);
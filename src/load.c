@@ -23,6 +23,12 @@
 
 /***** Local headers ********************************************************/
 #include "mrubyc.h"
+#if defined(MRBC_USE_SUPERINSTRUCTION)
+#include "opcode.h"
+#endif
+#if defined(MRBC_USE_IMAGE)
+#include "_autogen_builtin_symbol_hash.h"
+#endif
 
 /***** Constat values *******************************************************/
 // for mrb file structure.
@@ -34,6 +40,15 @@ static const int SIZE_RITE_CATCH_HANDLER = 13;
 static const char IREP[4] = "IREP";
 static const char END[4] = "END\0";
 
+#if defined(MRBC_USE_IMAGE) && !defined(MRBC_IREP_SINGLE_BLOCK)
+#error "MRBC_USE_IMAGE needs MRBC_IREP_SINGLE_BLOCK."
+#endif
+
+// bytecode in flash is referenced in place, so it is never fused.
+#if !defined(hal_is_ram_address)
+#define hal_is_ram_address(p) 0
+#endif
+
 
 /*! IREP TT */
 enum irep_pool_type {
@@ -53,6 +68,238 @@ enum irep_pool_type {
 /***** Signal catching functions ********************************************/
 /***** Local functions ******************************************************/
 
+#if defined(MRBC_USE_SUPERINSTRUCTION)
+/*! operand formats */
+enum {
+  OPR_Z, OPR_B, OPR_BB, OPR_BBB, OPR_BS, OPR_BSS, OPR_S, OPR_W,
+};
+
+//! operand format of each opcode.
+static const uint8_t opr_format[] = {
+  [OP_NOP] = OPR_Z, [OP_MOVE] = OPR_BB, [OP_LOADL] = OPR_BB,
+  [OP_LOADI] = OPR_BB, [OP_LOADINEG] = OPR_BB, [OP_LOADI__1] = OPR_B,
+  [OP_LOADI_0] = OPR_B, [OP_LOADI_1] = OPR_B, [OP_LOADI_2] = OPR_B,
+  [OP_LOADI_3] = OPR_B, [OP_LOADI_4] = OPR_B, [OP_LOADI_5] = OPR_B,
+  [OP_LOADI_6] = OPR_B, [OP_LOADI_7] = OPR_B, [OP_LOADI16] = OPR_BS,
+  [OP_LOADI32] = OPR_BSS, [OP_LOADSYM] = OPR_BB, [OP_LOADNIL] = OPR_B,
+  [OP_LOADSELF] = OPR_B, [OP_LOADT] = OPR_B, [OP_LOADF] = OPR_B,
+  [OP_GETGV] = OPR_BB, [OP_SETGV] = OPR_BB, [OP_GETSV] = OPR_BB,
+  [OP_SETSV] = OPR_BB, [OP_GETIV] = OPR_BB, [OP_SETIV] = OPR_BB,
+  [OP_GETCV] = OPR_BB, [OP_SETCV] = OPR_BB, [OP_GETCONST] = OPR_BB,
+  [OP_SETCONST] = OPR_BB, [OP_GETMCNST] = OPR_BB, [OP_SETMCNST] = OPR_BB,
+  [OP_GETUPVAR] = OPR_BBB, [OP_SETUPVAR] = OPR_BBB, [OP_GETIDX] = OPR_B,
+  [OP_SETIDX] = OPR_B, [OP_JMP] = OPR_S, [OP_JMPIF] = OPR_BS,
+  [OP_JMPNOT] = OPR_BS, [OP_JMPNIL] = OPR_BS, [OP_JMPUW] = OPR_S,
+  [OP_EXCEPT] = OPR_B, [OP_RESCUE] = OPR_BB, [OP_RAISEIF] = OPR_B,
+  [OP_SSEND] = OPR_BBB, [OP_SSENDB] = OPR_BBB, [OP_SEND] = OPR_BBB,
+  [OP_SENDB] = OPR_BBB, [OP_CALL] = OPR_Z, [OP_SUPER] = OPR_BB,
+  [OP_ARGARY] = OPR_BS, [OP_ENTER] = OPR_W, [OP_KEY_P] = OPR_BB,
+  [OP_KEYEND] = OPR_Z, [OP_KARG] = OPR_BB, [OP_RETURN] = OPR_B,
+  [OP_RETURN_BLK] = OPR_B, [OP_BREAK] = OPR_B, [OP_BLKPUSH] = OPR_BS,
+  [OP_ADD] = OPR_B, [OP_ADDI] = OPR_BB, [OP_SUB] = OPR_B, [OP_SUBI] = OPR_BB,
+  [OP_MUL] = OPR_B, [OP_DIV] = OPR_B, [OP_EQ] = OPR_B, [OP_LT] = OPR_B,
+  [OP_LE] = OPR_B, [OP_GT] = OPR_B, [OP_GE] = OPR_B, [OP_ARRAY] = OPR_BB,
+  [OP_ARRAY2] = OPR_BBB, [OP_ARYCAT] = OPR_B, [OP_ARYPUSH] = OPR_BB,
+  [OP_ARYDUP] = OPR_B, [OP_AREF] = OPR_BBB, [OP_ASET] = OPR_BBB,
+  [OP_APOST] = OPR_BBB, [OP_INTERN] = OPR_B, [OP_SYMBOL] = OPR_BB,
+  [OP_STRING] = OPR_BB, [OP_STRCAT] = OPR_B, [OP_HASH] = OPR_BB,
+  [OP_HASHADD] = OPR_BB, [OP_HASHCAT] = OPR_B, [OP_LAMBDA] = OPR_BB,
+  [OP_BLOCK] = OPR_BB, [OP_METHOD] = OPR_BB, [OP_RANGE_INC] = OPR_B,
+  [OP_RANGE_EXC] = OPR_B, [OP_OCLASS] = OPR_B, [OP_CLASS] = OPR_BB,
+  [OP_MODULE] = OPR_BB, [OP_EXEC] = OPR_BB, [OP_DEF] = OPR_BB,
+  [OP_ALIAS] = OPR_BB, [OP_UNDEF] = OPR_B, [OP_SCLASS] = OPR_B,
+  [OP_TCLASS] = OPR_B, [OP_DEBUG] = OPR_BBB, [OP_ERR] = OPR_B,
+  [OP_EXT1] = OPR_Z, [OP_EXT2] = OPR_Z, [OP_EXT3] = OPR_Z, [OP_STOP] = OPR_Z,
+};
+
+//! operand size of each format.
+static const uint8_t opr_size[] = { 0, 1, 2, 3, 3, 5, 2, 3 };
+
+
+//================================================================
+/*! Fuse instruction pairs into superinstructions.
+
+  @param  inst	A pointer to the instruction sequence. (RAM)
+  @param  ilen	num of bytes in the instruction sequence.
+  @note
+  The opcode of the first instruction is replaced, and both instructions
+  are kept in place. So jumps into the second one still work.
+*/
+static void fuse_instructions(uint8_t *inst, int ilen)
+{
+  uint8_t *p = inst;
+  const uint8_t *end = inst + ilen;
+
+  while( p < end ) {
+    int op = *p;
+    if( op > OP_STOP ) return;	// unknown opcode.
+
+    // skip OP_EXTn and the extended instruction. (never fused)
+    if( op == OP_EXT1 || op == OP_EXT2 || op == OP_EXT3 ) {
+      int ext = op - OP_EXT1 + 1;
+      if( ++p >= end || *p > OP_STOP ) return;
+      int fmt = opr_format[*p];
+      p += 1 + opr_size[fmt];
+      if( (ext & 1) && fmt >= OPR_B && fmt <= OPR_BSS ) p++;
+      if( (ext & 2) && (fmt == OPR_BB || fmt == OPR_BBB) ) p++;
+      continue;
+    }
+
+    uint8_t *p2 = p + 1 + opr_size[opr_format[op]];
+    if( p2 >= end ) return;
+
+    switch( op ) {
+    case OP_LOADI: if( *p2 == OP_ADD ) *p = OP_X_LOADI_ADD;		break;
+    case OP_MOVE:  if( *p2 == OP_SEND ) *p = OP_X_MOVE_SEND;		break;
+    case OP_LT:    if( *p2 == OP_JMPNOT ) *p = OP_X_LT_JMPNOT;	break;
+    case OP_GETIV: if( *p2 == OP_SEND ) *p = OP_X_GETIV_SEND;		break;
+    }
+    p = p2;
+  }
+}
+#endif
+
+
+//================================================================
+/*! Will the IREPs be fused into superinstructions?
+
+  @param  vm	A pointer to VM.
+  @param  bin	A pointer to the bytecode.
+  @return	true if the instruction sequences are copied and fused.
+  @note
+  Only the bytecode already in RAM is fused. Copying the bytecode in flash
+  costs as much RAM as the program itself.
+*/
+static inline int use_superinstruction(const struct VM *vm, const uint8_t *bin)
+{
+#if defined(MRBC_USE_SUPERINSTRUCTION)
+  return !vm->flag_no_superinstruction && hal_is_ram_address(bin);
+#else
+  return 0;
+#endif
+}
+
+
+//================================================================
+/*! Get the length of instance variable name table.
+
+  @param  p	A pointer to the symbols block. (n of symbol)
+  @return	num of symbols if any symbol begins with '@', or 0.
+*/
+static int calc_ivar_table_len(const uint8_t *p)
+{
+  uint16_t slen = bin_to_uint16(p);	p += 2;
+
+  for( int i = 0; i < slen; i++ ) {
+    if( p[2] == '@' ) return slen;
+    p += bin_to_uint16(p) + 3;
+  }
+
+  return 0;
+}
+
+
+//================================================================
+/*! Calculate the size of mrbc_irep for one irep.
+
+  @param  rlen	num of child ireps.
+  @param  plen	num of pools.
+  @param  slen	num of symbols.
+  @param  ivlen	length of instance variable name table.
+  @param  isiz	size of the copy of instructions, or 0 if not copied.
+  @return	size in bytes.
+*/
+static unsigned int calc_irep_size(int rlen, int plen, int slen, int ivlen, int isiz)
+{
+  unsigned int siz = sizeof(mrbc_sym) * (slen + ivlen) + sizeof(uint16_t) * plen;
+  siz += (-siz & 0x03);	// padding. 32bit align.
+  isiz += (-isiz & 0x03);
+  return sizeof(mrbc_irep) + siz + sizeof(mrbc_irep*) * rlen + isiz;
+}
+
+
+#if defined(MRBC_IREP_SINGLE_BLOCK)
+//================================================================
+/*! Skip the pool block.
+
+  @param  p	A pointer to the pool block. (n of pool)
+  @return	A pointer to the next block, or NULL if unknown type.
+*/
+static const uint8_t * skip_pool(const uint8_t *p)
+{
+  uint16_t plen = bin_to_uint16(p);	p += 2;
+
+  for( int i = 0; i < plen; i++ ) {
+    switch( *p++ ) {
+    case IREP_TT_STR:
+    case IREP_TT_SSTR:	p += bin_to_uint16(p) + 3;	break;
+    case IREP_TT_INT32:	p += 4;	break;
+    case IREP_TT_INT64:
+    case IREP_TT_FLOAT:	p += 8;	break;
+    default:		return NULL;
+    }
+  }
+
+  return p;
+}
+
+
+//================================================================
+/*! Calculate the total size of mrbc_irep tree.
+
+  @param  bin	A pointer to RITE ISEQ.
+  @param  len	Returns the parsed length.
+  @param  flag_copy_inst  instructions are copied to the block.
+  @return	total size, or 0 if error.
+*/
+static unsigned int calc_irep_tree_size(const uint8_t *bin, int *len, int flag_copy_inst)
+{
+  const uint8_t *p = bin + 4 + 2 + 2;	// skip record size, nlocals, nregs.
+  int rlen = bin_to_uint16(p);		p += 2;
+  int clen = bin_to_uint16(p);		p += 2;
+  uint32_t ilen = bin_to_uint32(p);	p += 4;
+  p += ilen + SIZE_RITE_CATCH_HANDLER * clen;
+
+  int plen = bin_to_uint16(p);
+  p = skip_pool(p);
+  if( !p ) return 0;
+  int slen = bin_to_uint16(p);
+
+  int isiz = flag_copy_inst ? ilen + SIZE_RITE_CATCH_HANDLER * clen : 0;
+  unsigned int total = calc_irep_size(rlen, plen, slen, calc_ivar_table_len(p), isiz);
+  int total_len = bin_to_uint32(bin);
+
+  for( int i = 0; i < rlen; i++ ) {
+    int len1;
+    unsigned int siz = calc_irep_tree_size(bin + total_len, &len1, flag_copy_inst);
+    if( siz == 0 ) return 0;
+    total += siz;
+    total_len += len1;
+  }
+
+  *len = total_len;
+  return total;
+}
+
+
+//================================================================
+/*! Is the irep tree referenced by any method?
+
+  @param  irep	Pointer to mrbc_irep.
+  @return	true if referenced.
+*/
+static int is_irep_tree_referenced(const struct IREP *irep)
+{
+  if( irep->ref_count != 0 ) return 1;
+
+  for( int i = 0; i < irep->rlen; i++ ) {
+    if( is_irep_tree_referenced( mrbc_irep_child_irep(irep, i) )) return 1;
+  }
+  return 0;
+}
+#endif
+
+
 //================================================================
 /*! Parse header section.
 
@@ -95,6 +342,7 @@ static int load_header(struct VM *vm, const uint8_t *bin)
   @param  vm	A pointer to VM.
   @param  bin	A pointer to RITE ISEQ.
   @param  len	Returns the parsed length.
+  @param  buf	Memory block to place mrbc_irep, or NULL to allocate.
   @return	Pointer to allocated mrbc_irep or NULL
 
   <pre>
@@ -126,7 +374,7 @@ static int load_header(struct VM *vm, const uint8_t *bin)
      ...	symbol data
   </pre>
 */
-static mrbc_irep * load_irep_1(struct VM *vm, const uint8_t *bin, int *len)
+static mrbc_irep * load_irep_1(struct VM *vm, const uint8_t *bin, int *len, uint8_t **buf)
 {
   mrbc_irep irep;
   const uint8_t *p = bin + 4;	// 4 = skip record size.
@@ -176,13 +424,16 @@ static mrbc_irep * load_irep_1(struct VM *vm, const uint8_t *bin, int *len)
     p += siz;
   }
 
-  // num of symbols, offset of tbl_ireps.
+  // num of symbols, offset of tbl_ivars and tbl_ireps.
+  int ivlen = calc_ivar_table_len(p);
   uint16_t slen = bin_to_uint16(p);	p += 2;
   uint32_t siz = sizeof(mrbc_sym) * slen;
   if( siz > 0xffff ) goto ERROR_TOO_LARGE;
   irep.ofs_pools = siz;
 
   siz += sizeof(uint16_t) * plen;
+  irep.ofs_ivars = ivlen ? siz : 0;
+  siz += sizeof(mrbc_sym) * ivlen;
   if( siz > 0xffff ) goto ERROR_TOO_LARGE;
   siz += (-siz & 0x03);	// padding. 32bit align.
   irep.ofs_ireps = siz;
@@ -192,16 +443,37 @@ static mrbc_irep * load_irep_1(struct VM *vm, const uint8_t *bin, int *len)
   irep.slen = slen;
 #endif
 
-  // allocate new irep
-  siz = sizeof(mrbc_irep) + siz + sizeof(mrbc_irep*) * irep.rlen;
-  mrbc_irep *p_irep = mrbc_raw_alloc( siz );
-  if( !p_irep ) {	// ENOMEM
-    mrbc_raise(vm, MRBC_CLASS(NoMemoryError),0);
-    return NULL;
+  // allocate new irep, or take it from the block.
+  int isiz = 0;
+  if( use_superinstruction(vm, bin) ) {
+    isiz = irep.ilen + SIZE_RITE_CATCH_HANDLER * irep.clen;
+  }
+  siz = calc_irep_size( irep.rlen, plen, slen, ivlen, isiz );
+  mrbc_irep *p_irep;
+  if( buf ) {
+    p_irep = (mrbc_irep *)*buf;
+    *buf += siz;
+  } else {
+    p_irep = mrbc_raw_alloc( siz );
+    if( !p_irep ) {	// ENOMEM
+      mrbc_raise(vm, MRBC_CLASS(NoMemoryError),0);
+      return NULL;
+    }
   }
   *p_irep = irep;
 
+#if defined(MRBC_USE_SUPERINSTRUCTION)
+  // copy the instructions and catch handlers after tbl_ireps, and fuse them.
+  if( isiz ) {
+    uint8_t *inst = p_irep->data + irep.ofs_ireps + sizeof(mrbc_irep*) * irep.rlen;
+    memcpy( inst, irep.inst, isiz );
+    fuse_instructions( inst, irep.ilen );
+    p_irep->inst = inst;
+  }
+#endif
+
   // make a symbol ID table. (tbl_syms[slen])
+  // and instance variable names without '@'. (tbl_ivars[slen])
   mrbc_sym *tbl_syms = mrbc_irep_tbl_syms(p_irep);
   for( int i = 0; i < slen; i++ ) {
     int siz = bin_to_uint16(p) + 1;	p += 2;
@@ -218,6 +490,18 @@ static mrbc_irep * load_irep_1(struct VM *vm, const uint8_t *bin, int *len)
       return NULL;
     }
     *tbl_syms++ = sym;
+
+    if( ivlen ) {
+      sym = 0;
+      if( sym_str[0] == '@' ) {
+	sym = mrbc_str_to_symid( sym_str + 1 );
+	if( sym < 0 ) {
+	  mrbc_raise(vm, MRBC_CLASS(Exception), "Overflow MAX_SYMBOLS_COUNT");
+	  return NULL;
+	}
+      }
+      mrbc_irep_ivar_id(p_irep, i) = sym;
+    }
     p += (siz);
   }
 
@@ -258,19 +542,20 @@ static mrbc_irep * load_irep_1(struct VM *vm, const uint8_t *bin, int *len)
   @param  vm	A pointer to VM.
   @param  bin	A pointer to RITE ISEQ.
   @param  len	Returns the parsed length.
+  @param  buf	Memory block to place mrbc_irep, or NULL to allocate.
   @return	Pointer to allocated mrbc_irep or NULL
 */
-static mrbc_irep *load_irep(struct VM *vm, const uint8_t *bin, int *len)
+static mrbc_irep *load_irep(struct VM *vm, const uint8_t *bin, int *len, uint8_t **buf)
 {
   int len1;
-  mrbc_irep *irep = load_irep_1(vm, bin, &len1);
+  mrbc_irep *irep = load_irep_1(vm, bin, &len1, buf);
   if( !irep ) return NULL;
   int total_len = len1;
 
   mrbc_irep **tbl_ireps = mrbc_irep_tbl_ireps(irep);
 
   for( int i = 0; i < irep->rlen; i++ ) {
-    tbl_ireps[i] = load_irep(vm, bin + total_len, &len1);
+    tbl_ireps[i] = load_irep(vm, bin + total_len, &len1, buf);
     if( ! tbl_ireps[i] ) return NULL;
     total_len += len1;
   }
@@ -293,6 +578,12 @@ int mrbc_load_mrb(struct VM *vm, const void *bytecode)
 {
   const uint8_t *bin = bytecode;
 
+#if defined(MRBC_USE_IMAGE)
+  if( memcmp(bin, MRBC_IMAGE_IDENT, 4) == 0 ) {
+    return mrbc_load_image(vm, bin);
+  }
+#endif
+
   vm->exception = mrbc_nil_value();
   if( load_header(vm, bin) != 0 ) return -1;
 
@@ -323,15 +614,138 @@ int mrbc_load_mrb(struct VM *vm, const void *bytecode)
 */
 int mrbc_load_irep(struct VM *vm, const void *bytecode)
 {
-  const uint8_t *bin = bytecode;
+  const uint8_t *bin = (const uint8_t *)bytecode + SIZE_RITE_SECTION_HEADER;
+  uint8_t *block = 0;
+
+#if defined(MRBC_IREP_SINGLE_BLOCK)
+  // all mrbc_irep in one memory block.
+  int len;
+  unsigned int siz = calc_irep_tree_size( bin, &len, use_superinstruction(vm, bin) );
+  if( siz != 0 ) {
+    block = mrbc_raw_alloc( siz );
+    if( !block ) {	// ENOMEM
+      mrbc_raise(vm, MRBC_CLASS(NoMemoryError),0);
+      return -1;
+    }
+  }
+  // if size can't be calculated, load_irep() reports the error.
+#endif
 
-  vm->top_irep = load_irep( vm, bin + SIZE_RITE_SECTION_HEADER, 0 );
-  if( vm->top_irep == NULL ) return -1;
+  uint8_t *buf = block;
+  vm->top_irep = load_irep( vm, bin, 0, block ? &buf : 0 );
+  if( vm->top_irep == NULL ) {
+    if( block ) mrbc_raw_free( block );
+    return -1;
+  }
 
   return mrbc_israised(vm);
 }
 
 
+#if defined(MRBC_USE_IMAGE)
+//================================================================
+/*! Load the pre-linked image. (made by host/mrbc_image)
+
+  The mrbc_irep block is copied to RAM and relocated, the code is
+  referenced in place. No RITE parsing is needed.
+
+  @param  vm		Pointer to VM.
+  @param  image		Pointer to image.
+  @return int		zero if no error.
+*/
+int mrbc_load_image(struct VM *vm, const void *image)
+{
+  const uint8_t *img = image;
+  struct MRBC_IMAGE_HEADER hdr;
+  memcpy( &hdr, img, sizeof(hdr) );	// image may not be aligned.
+
+  vm->exception = mrbc_nil_value();
+  if( memcmp(hdr.ident, MRBC_IMAGE_IDENT, 4) != 0 ) {
+    mrbc_raise( vm, MRBC_CLASS(Exception), "Illegal image");
+    return -1;
+  }
+  if( hdr.version != MRBC_IMAGE_VERSION ||
+      hdr.sizeof_ptr != sizeof(void *) ||
+      hdr.sizeof_irep != sizeof(mrbc_irep) ||
+      hdr.n_builtin_symbols != MRBC_BUILTIN_SYMBOL_COUNT ) {
+    mrbc_raise( vm, MRBC_CLASS(Exception), "Image mismatch with the VM");
+    return -1;
+  }
+
+  uint8_t *block = mrbc_raw_alloc( hdr.size_ireps );
+  if( !block ) {	// ENOMEM
+    mrbc_raise(vm, MRBC_CLASS(NoMemoryError),0);
+    return -1;
+  }
+  memcpy( block, img + hdr.ofs_ireps, hdr.size_ireps );
+
+  // relocation. symbol entries are sorted by the name index.
+  const uint8_t *code = img + hdr.ofs_code;
+  const uint8_t *p_reloc = img + hdr.ofs_relocs;
+  const char *sym_str = (const char *)img + hdr.ofs_symbols;
+  int sym_idx = 0;
+  mrbc_sym sym_id = -1;
+
+  for( int i = 0; i < hdr.n_relocs; i++ ) {
+    struct MRBC_IMAGE_RELOC reloc;
+    memcpy( &reloc, p_reloc, sizeof(reloc) );
+    p_reloc += sizeof(reloc);
+    uint8_t *p = block + reloc.offset;
+    const uint8_t *ptr;
+
+    switch( reloc.type ) {
+    case MRBC_IMAGE_RELOC_IREP:
+      memcpy( &ptr, p, sizeof(ptr) );
+      ptr = block + (uintptr_t)ptr;
+      memcpy( p, &ptr, sizeof(ptr) );
+      break;
+
+    case MRBC_IMAGE_RELOC_CODE:
+      memcpy( &ptr, p, sizeof(ptr) );
+      ptr = code + (uintptr_t)ptr;
+      memcpy( p, &ptr, sizeof(ptr) );
+      break;
+
+    case MRBC_IMAGE_RELOC_SYMBOL:
+      while( sym_idx < reloc.index ) {
+	sym_str += strlen(sym_str) + 1;
+	sym_idx++;
+	sym_id = -1;
+      }
+      if( sym_id < 0 ) {
+	const char *s = sym_str;
+	if( vm->flag_permanence == 1 ) {
+	  int siz = strlen(sym_str) + 1;
+	  char *s1 = mrbc_raw_alloc_no_free(siz);
+	  memcpy( s1, sym_str, siz );
+	  s = s1;
+	}
+	sym_id = mrbc_str_to_symid( s );
+	if( sym_id < 0 ) {
+	  mrbc_raise(vm, MRBC_CLASS(Exception), "Overflow MAX_SYMBOLS_COUNT");
+	  goto ERROR;
+	}
+      }
+      memcpy( p, &sym_id, sizeof(sym_id) );
+      break;
+
+    default:
+      mrbc_raise( vm, MRBC_CLASS(Exception), "Illegal image");
+      goto ERROR;
+    }
+  }
+
+  vm->top_irep = (mrbc_irep *)block;
+  return 0;
+
+
+ ERROR:
+  mrbc_raw_free( block );
+  return -1;
+}
+#endif
+
+
 //================================================================
 /*! release mrbc_irep holds memory
 
@@ -339,6 +753,11 @@ int mrbc_load_irep(struct VM *vm, const void *bytecode)
 */
 void mrbc_irep_free(struct IREP *irep)
 {
+#if defined(MRBC_IREP_SINGLE_BLOCK)
+  // the block is kept while any method refers to a part of it.
+  if( !is_irep_tree_referenced(irep) ) mrbc_raw_free( irep );
+
+#else
   // release child ireps.
   for( int i = 0; i < irep->rlen; i++ ) {
     mrbc_irep_free( mrbc_irep_child_irep(irep, i) );
@@ -347,6 +766,7 @@ void mrbc_irep_free(struct IREP *irep)
   if( irep->ref_count == 0 ) {
     mrbc_raw_free( irep );
   }
+#endif
 }
 
 
@@ -379,7 +799,7 @@ mrbc_value mrbc_irep_pool_value(struct VM *vm, int n)
 
 #if MRBC_USE_FLOAT
   case IREP_TT_FLOAT:
-    mrbc_set_float(&obj, bin_to_double64(p));
+    obj = mrbc_float_value(vm, bin_to_double64(p));
     break;
 #endif
 
@@ -27,16 +27,66 @@
 extern "C" {
 #endif
 /***** Constat values *******************************************************/
+#define MRBC_IMAGE_IDENT	"MRBI"
+#define MRBC_IMAGE_VERSION	2
+
+
 /***** Macros ***************************************************************/
 /***** Typedefs *************************************************************/
 // pre define of some struct
 struct IREP;
 
+//================================================================
+/*!@brief
+  Header of the pre-linked image. (see host/mrbc_image.c)
+
+  <pre>
+  All fields are in the byte order of the target.
+   header
+   mrbc_irep block	flattened mrbc_irep tree, as in the target RAM.
+   relocation table	struct MRBC_IMAGE_RELOC[n_relocs]
+   symbol names		n_symbols of NUL terminated strings.
+   code			IREP records of the RITE binary.
+  </pre>
+*/
+struct MRBC_IMAGE_HEADER {
+  char ident[4];		//!< MRBC_IMAGE_IDENT
+  uint8_t version;		//!< MRBC_IMAGE_VERSION
+  uint8_t sizeof_ptr;		//!< sizeof(void *) of the target.
+  uint16_t sizeof_irep;		//!< sizeof(mrbc_irep) of the target.
+  uint16_t n_builtin_symbols;	//!< num of built-in symbols of the target.
+  uint16_t n_symbols;		//!< num of symbol names.
+  uint32_t n_relocs;		//!< num of relocation entries.
+  uint32_t size_ireps;		//!< size of mrbc_irep block.
+  uint32_t ofs_ireps;		//!< offset of mrbc_irep block.
+  uint32_t ofs_relocs;		//!< offset of relocation table.
+  uint32_t ofs_symbols;		//!< offset of symbol names.
+  uint32_t ofs_code;		//!< offset of code.
+  uint32_t size;		//!< total size of the image.
+};
+
+//================================================================
+/*!@brief
+  Relocation entry of the image.
+*/
+struct MRBC_IMAGE_RELOC {
+  uint32_t offset;		//!< offset in mrbc_irep block.
+  uint16_t type;		//!< enum MRBC_IMAGE_RELOC_TYPE
+  uint16_t index;		//!< symbol name index. (RELOC_SYMBOL only)
+};
+
+enum MRBC_IMAGE_RELOC_TYPE {
+  MRBC_IMAGE_RELOC_IREP = 1,	//!< pointer, add address of mrbc_irep block.
+  MRBC_IMAGE_RELOC_CODE = 2,	//!< pointer, add address of code.
+  MRBC_IMAGE_RELOC_SYMBOL = 3,	//!< mrbc_sym, set ID of the symbol name.
+};
+
 /***** Global variables *****************************************************/
 /***** Function prototypes **************************************************/
 //@cond
 int mrbc_load_mrb(struct VM *vm, const void *bytecode);
 int mrbc_load_irep(struct VM *vm, const void *bytecode);
+int mrbc_load_image(struct VM *vm, const void *image);
 void mrbc_irep_free(struct IREP *irep);
 mrbc_value mrbc_irep_pool_value(struct VM *vm, int n);
 //@endcond
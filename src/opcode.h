@@ -227,6 +227,13 @@ enum OPCODE {
   OP_EXT2       = 0x67, //!< Z    make 2nd operand (b) 16bit
   OP_EXT3       = 0x68, //!< Z    make 1st and 2nd operands 16bit
   OP_STOP       = 0x69, //!< Z    stop VM
+
+  // private extended opcodes. fused superinstructions made by load.c.
+  // The instruction pair is kept in place, only the first opcode is replaced.
+  OP_X_LOADI_ADD  = 0x6a, //!< BB   OP_LOADI + OP_ADD
+  OP_X_MOVE_SEND  = 0x6b, //!< BB   OP_MOVE + OP_SEND
+  OP_X_LT_JMPNOT  = 0x6c, //!< B    OP_LT + OP_JMPNOT
+  OP_X_GETIV_SEND = 0x6d, //!< BB   OP_GETIV + OP_SEND
 };
 
 
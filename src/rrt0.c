@@ -34,6 +34,10 @@
 
 /***** Typedefs *************************************************************/
 /***** Function prototypes **************************************************/
+static void queue_receive( mrbc_tcb *tcb );
+static int event_resume( mrbc_tcb *tcb );
+
+
 /***** Local variables ******************************************************/
 #define NUM_TASK_QUEUE 4
 static mrbc_tcb *task_queue_[NUM_TASK_QUEUE];
@@ -42,12 +46,202 @@ static mrbc_tcb *task_queue_[NUM_TASK_QUEUE];
 #define q_waiting_   (task_queue_[2])
 #define q_suspended_ (task_queue_[3])
 static volatile uint32_t tick_;
-static volatile uint32_t wakeup_tick_ = (1 << 16); // no significant meaning.
+
+// ready queue index. bitmap of the priorities that have ready tasks,
+// and the last task of each priority in q_ready_.
+#define NUM_PRIORITY 256
+static uint32_t ready_map_[NUM_PRIORITY / 32];
+static uint8_t ready_map_group_;	// bit n: ready_map_[n] != 0
+static mrbc_tcb *ready_tail_[NUM_PRIORITY];
+static mrbc_tcb * volatile running_task_;
+
+// sleeping tasks, binary min-heap ordered by wakeup_tick.
+static mrbc_tcb *sleep_heap_[MAX_VM_COUNT];
+static uint8_t n_sleep_;
+
+// events posted by interrupt handlers, handled at the next tick.
+static const void * volatile pending_event_[MRBC_NUM_PENDING_EVENT];
+static volatile uint8_t flag_pending_event_;	// 1: posted, 2: lost some.
 
 
 /***** Global variables *****************************************************/
 /***** Signal catching functions ********************************************/
 /***** Functions ************************************************************/
+//================================================================
+/*! compare the wakeup tick of sleeping tasks.
+*/
+static inline int sleep_before(const mrbc_tcb *t1, const mrbc_tcb *t2)
+{
+  return (int32_t)(t1->wakeup_tick - t2->wakeup_tick) < 0;
+}
+
+
+//================================================================
+/*! move the task in the sleep heap to the proper position.
+
+  @param  i	index of the task.
+*/
+static void sleep_heap_fix(int i)
+{
+  mrbc_tcb *t = sleep_heap_[i];
+
+  // up
+  while( i > 0 ) {
+    int parent = (i - 1) / 2;
+    if( !sleep_before( t, sleep_heap_[parent] )) break;
+    sleep_heap_[i] = sleep_heap_[parent];
+    sleep_heap_[i]->sleep_idx = i + 1;
+    i = parent;
+  }
+
+  // down
+  while( 1 ) {
+    int child = i * 2 + 1;
+    if( child >= n_sleep_ ) break;
+    if( child + 1 < n_sleep_ &&
+        sleep_before( sleep_heap_[child + 1], sleep_heap_[child] )) child++;
+    if( !sleep_before( sleep_heap_[child], t )) break;
+    sleep_heap_[i] = sleep_heap_[child];
+    sleep_heap_[i]->sleep_idx = i + 1;
+    i = child;
+  }
+
+  sleep_heap_[i] = t;
+  t->sleep_idx = i + 1;
+}
+
+
+//================================================================
+/*! add the task to the sleep heap.
+*/
+static void sleep_heap_push(mrbc_tcb *p_tcb)
+{
+  assert( n_sleep_ < MAX_VM_COUNT );
+
+  sleep_heap_[n_sleep_] = p_tcb;
+  sleep_heap_fix( n_sleep_++ );
+}
+
+
+//================================================================
+/*! remove the task from the sleep heap.
+*/
+static void sleep_heap_remove(mrbc_tcb *p_tcb)
+{
+  int i = p_tcb->sleep_idx - 1;
+  p_tcb->sleep_idx = 0;
+
+  if( --n_sleep_ == i ) return;
+  sleep_heap_[i] = sleep_heap_[n_sleep_];
+  sleep_heap_fix( i );
+}
+
+
+//================================================================
+/*! Number of leading zeros. 32bit version.
+
+  @param  x	target (must not be zero)
+  @retval int	nlz value
+*/
+static inline int nlz32(uint32_t x)
+{
+#if defined(__GNUC__)
+  return __builtin_clz(x);
+#else
+  int n = 1;
+  if((x >> 16) == 0 ) { n += 16; x <<= 16; }
+  if((x >> 24) == 0 ) { n +=  8; x <<=  8; }
+  if((x >> 28) == 0 ) { n +=  4; x <<=  4; }
+  if((x >> 30) == 0 ) { n +=  2; x <<=  2; }
+  return n - (x >> 31);
+#endif
+}
+
+
+//================================================================
+/*! find the nearest priority that has ready tasks, and higher than given.
+
+  @param  pri	priority.
+  @return	found priority, or -1 if not found.
+*/
+static int ready_find_higher(int pri)
+{
+  int idx = pri / 32;
+  uint32_t map = ready_map_[idx] & ((1UL << (pri % 32)) - 1);
+  if( map == 0 ) {
+    uint8_t group = ready_map_group_ & ((1 << idx) - 1);
+    if( group == 0 ) return -1;
+    idx = 31 - nlz32(group);
+    map = ready_map_[idx];
+  }
+
+  return idx * 32 + 31 - nlz32(map);
+}
+
+
+//================================================================
+/*! Insert task(TCB) to ready queue
+
+  @param  p_tcb	Pointer to target TCB
+
+  The ready queue is a sorted linked list, same as other queues.
+  The insert point is found by the bitmap instead of walking the list.
+*/
+static void q_insert_ready_task(mrbc_tcb *p_tcb)
+{
+  int pri = p_tcb->priority_preemption;
+  mrbc_tcb *p = ready_tail_[pri];
+
+  if( p == NULL ) {
+    int pri2 = ready_find_higher( pri );
+    if( pri2 >= 0 ) p = ready_tail_[pri2];
+
+    ready_map_[pri / 32] |= 1UL << (pri % 32);
+    ready_map_group_ |= 1 << (pri / 32);
+  }
+  ready_tail_[pri] = p_tcb;
+
+  // insert after p.
+  p_tcb->prev = p;
+  if( p == NULL ) {
+    p_tcb->next = q_ready_;
+    q_ready_ = p_tcb;
+  } else {
+    p_tcb->next = p->next;
+    p->next = p_tcb;
+  }
+  if( p_tcb->next ) p_tcb->next->prev = p_tcb;
+}
+
+
+//================================================================
+/*! Delete task(TCB) from ready queue
+
+  @param  p_tcb	Pointer to target TCB
+*/
+static void q_delete_ready_task(mrbc_tcb *p_tcb)
+{
+  int pri = p_tcb->priority_preemption;
+  mrbc_tcb *prev = p_tcb->prev;
+  mrbc_tcb *next = p_tcb->next;
+
+  if( ready_tail_[pri] == p_tcb ) {
+    if( prev && prev->priority_preemption == pri ) {
+      ready_tail_[pri] = prev;
+    } else {
+      ready_tail_[pri] = NULL;
+      ready_map_[pri / 32] &= ~(1UL << (pri % 32));
+      if( ready_map_[pri / 32] == 0 ) ready_map_group_ &= ~(1 << (pri / 32));
+    }
+  }
+
+  if( prev ) prev->next = next; else q_ready_ = next;
+  if( next ) next->prev = prev;
+  p_tcb->next = NULL;
+  p_tcb->prev = NULL;
+}
+
+
 //================================================================
 /*! Insert task(TCB) to task queue
 
@@ -61,12 +255,24 @@ static volatile uint32_t wakeup_tick_ = (1 << 16); // no significant meaning.
 */
 static void q_insert_task(mrbc_tcb *p_tcb)
 {
+  if( p_tcb->state & TASKSTATE_READY ) {
+    q_insert_ready_task( p_tcb );
+    return;
+  }
+
   // select target queue pointer.
   //                    state value = 0  1  2  3  4  5  6  7  8
   //                             /2   0, 0, 1, 1, 2, 2, 3, 3, 4
   static const uint8_t conv_tbl[] = { 0,    1,    2,    0,    3 };
   mrbc_tcb **pp_q = &task_queue_[ conv_tbl[ p_tcb->state / 2 ]];
 
+  // sleeping task is in the sleep heap too.
+  if( p_tcb->state == TASKSTATE_WAITING &&
+      (p_tcb->reason == TASKREASON_SLEEP ||
+       (p_tcb->reason == TASKREASON_EVENT && p_tcb->flag_event_timeout)) ) {
+    sleep_heap_push( p_tcb );
+  }
+
   // in case of insert on top.
   if((*pp_q == NULL) ||
      (p_tcb->priority_preemption < (*pp_q)->priority_preemption)) {
@@ -95,10 +301,17 @@ static void q_insert_task(mrbc_tcb *p_tcb)
 */
 static void q_delete_task(mrbc_tcb *p_tcb)
 {
+  if( p_tcb->state & TASKSTATE_READY ) {
+    q_delete_ready_task( p_tcb );
+    return;
+  }
+
   // select target queue pointer. (same as q_insert_task)
   static const uint8_t conv_tbl[] = { 0,    1,    2,    0,    3 };
   mrbc_tcb **pp_q = &task_queue_[ conv_tbl[ p_tcb->state / 2 ]];
 
+  if( p_tcb->sleep_idx ) sleep_heap_remove( p_tcb );
+
   if( *pp_q == p_tcb ) {
     *pp_q       = p_tcb->next;
     p_tcb->next = NULL;
@@ -125,9 +338,78 @@ static void q_delete_task(mrbc_tcb *p_tcb)
 */
 inline static void preempt_running_task(void)
 {
-  for( mrbc_tcb *t = q_ready_; t != NULL; t = t->next ) {
-    if( t->state == TASKSTATE_RUNNING ) t->vm.flag_preemption = 1;
+  mrbc_tcb *t = running_task_;
+  if( t != NULL && t->state == TASKSTATE_RUNNING ) t->vm.flag_preemption = 1;
+}
+
+
+//================================================================
+/*! wake up the sleeping tasks whose wakeup tick has passed.
+*/
+static void wakeup_sleeping_tasks(void)
+{
+  int flag_preemption = 0;
+
+  while( n_sleep_ != 0 ) {
+    mrbc_tcb *t = sleep_heap_[0];
+    if( (int32_t)(t->wakeup_tick - tick_) >= 0 ) break;
+
+    q_delete_task(t);
+    if( t->reason == TASKREASON_EVENT ) t->event = NULL;	// timed out.
+    t->state  = TASKSTATE_READY;
+    t->reason = 0;
+    q_insert_task(t);
+    flag_preemption = 1;
   }
+
+  if( flag_preemption ) preempt_running_task();
+}
+
+
+//================================================================
+/*! wake up the tasks waiting for the events posted by interrupt handlers.
+
+  If some events were lost because the slots were full, all tasks
+  waiting for any event are woken up. A woken task must check its
+  condition again anyway.
+*/
+static void wakeup_event_tasks(void)
+{
+  const void *event[MRBC_NUM_PENDING_EVENT];
+  int flag_all = (flag_pending_event_ & 2);
+  int flag_preemption = 0;
+
+  flag_pending_event_ = 0;
+  for( int i = 0; i < MRBC_NUM_PENDING_EVENT; i++ ) {
+    event[i] = pending_event_[i];
+    pending_event_[i] = 0;
+  }
+
+  for( int i = 0; i < 2; i++ ) {
+    mrbc_tcb *t = i == 0 ? q_waiting_ : q_suspended_;
+    while( t != NULL ) {
+      mrbc_tcb *next = t->next;
+      if( t->reason != TASKREASON_EVENT ) goto NEXT;
+
+      int j = 0;
+      if( !flag_all ) {
+	while( j < MRBC_NUM_PENDING_EVENT && event[j] != t->event ) j++;
+	if( j == MRBC_NUM_PENDING_EVENT ) goto NEXT;
+      }
+
+      t->reason = 0;
+      if( t->state == TASKSTATE_WAITING ) {	// or resume later.
+	q_delete_task(t);
+	t->state = TASKSTATE_READY;
+	q_insert_task(t);
+	flag_preemption = 1;
+      }
+    NEXT:
+      t = next;
+    }
+  }
+
+  if( flag_preemption ) preempt_running_task();
 }
 
 
@@ -150,32 +432,49 @@ void mrbc_tick(void)
     if( tcb->timeslice == 0 ) tcb->vm.flag_preemption = 1;
   }
 
-  // Check the wakeup tick.
-  if( (int32_t)(wakeup_tick_ - tick_) < 0 ) {
-    int flag_preemption = 0;
-    wakeup_tick_ = tick_ + (1 << 16);
-
-    // Find a wake up task in waiting task queue.
-    tcb = q_waiting_;
-    while( tcb != NULL ) {
-      mrbc_tcb *t = tcb;
-      tcb = tcb->next;
-      if( t->reason != TASKREASON_SLEEP ) continue;
-
-      if( (int32_t)(t->wakeup_tick - tick_) < 0 ) {
-        q_delete_task(t);
-        t->state  = TASKSTATE_READY;
-        t->reason = 0;
-        q_insert_task(t);
-        flag_preemption = 1;
-      } else if( (int32_t)(t->wakeup_tick - wakeup_tick_) < 0 ) {
-        wakeup_tick_ = t->wakeup_tick;
-      }
-    }
+#if defined(MRBC_USE_PROFILER)
+  if( (tcb != NULL) && (tcb->state == TASKSTATE_RUNNING) ) {
+    mrbc_profile_sample( &tcb->vm );
+  }
+#endif
 
-    if( flag_preemption ) preempt_running_task();
+  // Check the wakeup tick. (the nearest one is on top of the heap)
+  if( n_sleep_ != 0 && (int32_t)(sleep_heap_[0]->wakeup_tick - tick_) < 0 ) {
+    wakeup_sleeping_tasks();
   }
+
+  if( flag_pending_event_ ) wakeup_event_tasks();
+}
+
+
+#if defined(MRBC_USE_TICKLESS)
+//================================================================
+/*! idle without the periodic tick until the next wakeup time.
+
+  The tick is stopped while sleeping, and the ticks that have passed
+  are accounted at once after wake up by any interrupt.
+*/
+static void idle_tickless(void)
+{
+  hal_disable_irq();
+  wakeup_sleeping_tasks();
+  if( flag_pending_event_ ) wakeup_event_tasks();
+  if( q_ready_ != NULL ) {	// readied by interrupt.
+    hal_enable_irq();
+    return;
+  }
+
+  // ticks until the nearest wakeup, or 0 if no task is sleeping.
+  uint32_t ticks = 0;
+  if( n_sleep_ != 0 ) ticks = sleep_heap_[0]->wakeup_tick - tick_ + 1;
+
+  tick_ += hal_idle_tickless( ticks );
+  wakeup_sleeping_tasks();
+  if( flag_pending_event_ ) wakeup_event_tasks();
+
+  hal_enable_irq();
 }
+#endif
 
 
 //================================================================
@@ -268,6 +567,10 @@ int mrbc_delete_task(mrbc_tcb *tcb)
   hal_enable_irq();
 
   mrbc_vm_close( &tcb->vm );
+#if defined(MRBC_USE_SCRATCH_ARENA)
+  mrbc_scratch_delete( tcb->scratch );
+  tcb->scratch = 0;
+#endif
 
   return 0;
 }
@@ -291,6 +594,32 @@ void mrbc_set_task_name(mrbc_tcb *tcb, const char *name)
 }
 
 
+//================================================================
+/*! give the task a scratch arena for short-lived objects.
+
+  @param  tcb	target task.
+  @param  size	arena size in bytes. 0 to stop using it.
+  @retval int	zero / no error.
+  @note
+  While the task runs, objects are allocated from the arena first.
+  Objects that live long (e.g. stored in a global) stay in the arena,
+  and only pin the chunk where they are.
+*/
+int mrbc_set_scratch_arena(mrbc_tcb *tcb, unsigned int size)
+{
+#if defined(MRBC_USE_SCRATCH_ARENA)
+  mrbc_scratch_delete( tcb->scratch );
+  tcb->scratch = 0;
+  if( size == 0 ) return 0;
+
+  tcb->scratch = mrbc_scratch_new( size );
+  return tcb->scratch ? 0 : -1;
+#else
+  return -1;
+#endif
+}
+
+
 //================================================================
 /*! find task by name
 
@@ -356,7 +685,11 @@ int mrbc_run(void)
 #if MRBC_SCHEDULER_EXIT
       if( !q_waiting_ && !q_suspended_ ) return ret;
 #endif
+#if defined(MRBC_USE_TICKLESS)
+      idle_tickless();
+#else
       hal_idle_cpu();
+#endif
       continue;
     }
 
@@ -365,14 +698,22 @@ int mrbc_run(void)
     */
     tcb->state = TASKSTATE_RUNNING;   // to execute.
     tcb->timeslice = MRBC_TIMESLICE_TICK_COUNT;
+    queue_receive( tcb );
+    if( tcb->resume_func && event_resume( tcb ) != 0 ) continue;
+#if defined(MRBC_USE_SCRATCH_ARENA)
+    mrbc_scratch_select( tcb->scratch );
+#endif
 
 #if !defined(MRBC_NO_TIMER)
     // Using hardware timer.
+    running_task_ = tcb;
     int ret_vm_run = mrbc_vm_run(&tcb->vm);
+    running_task_ = NULL;
     tcb->vm.flag_preemption = 0;
 #else
     // Emulate time slice preemption.
     int ret_vm_run;
+    running_task_ = tcb;
     tcb->vm.flag_preemption = 1;
     while( tcb->timeslice != 0 ) {
       ret_vm_run = mrbc_vm_run( &tcb->vm );
@@ -380,8 +721,12 @@ int mrbc_run(void)
       if( ret_vm_run != 0 ) break;
       if( tcb->state != TASKSTATE_RUNNING ) break;
     }
+    running_task_ = NULL;
     mrbc_tick();
 #endif
+#if defined(MRBC_USE_SCRATCH_ARENA)
+    mrbc_scratch_select( 0 );
+#endif
 
     /*
       did the task done?
@@ -450,8 +795,11 @@ mrbc_run_step(void)
 
   tcb->state = TASKSTATE_RUNNING;
   tcb->timeslice = MRBC_TIMESLICE_TICK_COUNT;
+  queue_receive(tcb);
 
+  running_task_ = tcb;
   int ret_vm_run = mrbc_vm_run(&tcb->vm);
+  running_task_ = NULL;
   tcb->vm.flag_preemption = 0;
 
   if (ret_vm_run != 0) {
@@ -511,11 +859,6 @@ void mrbc_sleep_ms(mrbc_tcb *tcb, uint32_t ms)
   tcb->state       = TASKSTATE_WAITING;
   tcb->reason      = TASKREASON_SLEEP;
   tcb->wakeup_tick = tick_ + (ms / MRBC_TICK_UNIT) + !!(ms % MRBC_TICK_UNIT);
-
-  if( (int32_t)(tcb->wakeup_tick - wakeup_tick_) < 0 ) {
-    wakeup_tick_ = tcb->wakeup_tick;
-  }
-
   q_insert_task(tcb);
   hal_enable_irq();
 
@@ -536,20 +879,15 @@ void mrbc_wakeup_task(mrbc_tcb *tcb)
     break;
 
   case TASKSTATE_WAITING:
-    if( tcb->reason != TASKREASON_SLEEP ) break;
+    if( tcb->reason != TASKREASON_SLEEP &&
+	tcb->reason != TASKREASON_EVENT ) break;
 
     hal_disable_irq();
     q_delete_task(tcb);
+    tcb->event = NULL;		// as timed out, if waiting for the event.
     tcb->state = TASKSTATE_READY;
     tcb->reason = 0;
     q_insert_task(tcb);
-
-    for( mrbc_tcb *t = q_waiting_; t != NULL; t = t->next ) {
-      if( t->reason != TASKREASON_SLEEP ) continue;
-      if( (int32_t)(t->wakeup_tick - wakeup_tick_) < 0 ) {
-        wakeup_tick_ = t->wakeup_tick;
-      }
-    }
     hal_enable_irq();
     break;
 
@@ -579,11 +917,10 @@ void mrbc_relinquish(mrbc_tcb *tcb)
 */
 void mrbc_change_priority(mrbc_tcb *tcb, int priority)
 {
-  tcb->priority            = priority;
-  tcb->priority_preemption = priority;
-
   hal_disable_irq();
   q_delete_task(tcb);       // reorder task queue according to priority.
+  tcb->priority            = priority;
+  tcb->priority_preemption = priority;
   q_insert_task(tcb);
 
   if( tcb->state & TASKSTATE_READY ) preempt_running_task();
@@ -631,12 +968,6 @@ void mrbc_resume_task(mrbc_tcb *tcb)
   q_insert_task(tcb);
 
   hal_enable_irq();
-
-  if( tcb->reason & TASKREASON_SLEEP ) {
-    if( (int32_t)(tcb->wakeup_tick - wakeup_tick_) < 0 ) {
-      wakeup_tick_ = tcb->wakeup_tick;
-    }
-  }
 }
 
 
@@ -656,8 +987,17 @@ void mrbc_terminate_task(mrbc_tcb *tcb)
   q_delete_task(tcb);
   tcb->state = TASKSTATE_DORMANT;
   q_insert_task(tcb);
+
+  // release the value in the hand of the queue.
+  int flag_release = (tcb->reason == TASKREASON_QUEUE) ?
+    (tcb->queue_ret == NULL) : (tcb->queue_ret != NULL);
+  tcb->reason = 0;
+  tcb->queue_ret = NULL;
+  tcb->resume_func = NULL;
   hal_enable_irq();
 
+  if( flag_release ) mrbc_decref( &tcb->queue_value );
+
   tcb->vm.flag_preemption = 1;
 }
 
@@ -687,6 +1027,132 @@ void mrbc_join_task(mrbc_tcb *tcb, const mrbc_tcb *tcb_join)
 }
 
 
+//================================================================
+/*! get the task that is running now.
+
+  @return	running task, or NULL if called out of the task.
+*/
+mrbc_tcb * mrbc_get_running_task(void)
+{
+  return running_task_;
+}
+
+
+//================================================================
+/*! wait for the event.
+
+  The task waits until an interrupt handler posts the event by
+  mrbc_notify_event_from_isr(), then becomes ready at the next tick.
+  The event is any address that both sides agree with, e.g. a device handle.
+
+  @param  tcb		target task.
+  @param  event		event to wait for.
+  @param  timeout_ms	timeout in milliseconds, or -1 to wait forever.
+  @note	must be called with interrupt disabled, after checking the
+	condition to wait for. so that the event will not be missed.
+*/
+void mrbc_wait_event(mrbc_tcb *tcb, const void *event, int32_t timeout_ms)
+{
+  q_delete_task(tcb);
+  tcb->state  = TASKSTATE_WAITING;
+  tcb->reason = TASKREASON_EVENT;
+  tcb->event  = event;
+  tcb->flag_event_timeout = (timeout_ms >= 0);
+  if( timeout_ms >= 0 ) {
+    tcb->wakeup_tick = tick_ + (timeout_ms / MRBC_TICK_UNIT) +
+				!!(timeout_ms % MRBC_TICK_UNIT);
+  }
+  q_insert_task(tcb);
+
+  tcb->vm.flag_preemption = 1;
+}
+
+
+//================================================================
+/*! set the function that finishes the call waiting for the event.
+
+  A C function can not wait in itself. Instead, it calls mrbc_wait_event()
+  and this, then returns. The func is called before the task runs again,
+  and stores the result to v[0].
+  The func returns 0 if finished, or 1 if the condition is not met yet.
+  In the latter case, the task waits for the event again, until the
+  same deadline. flag_timeout is set if timed out or woken up by others,
+  and then func must finish.
+
+  @param  tcb		target task.
+  @param  func		function.
+  @param  v		v[] of the call.
+  @param  param		parameter for func.
+  @note	called with interrupt disabled, as same as mrbc_wait_event().
+	func is also called with interrupt disabled.
+*/
+void mrbc_set_resume_func(mrbc_tcb *tcb, mrbc_resume_func func, mrbc_value v[], int32_t param)
+{
+  tcb->resume_func = func;
+  tcb->resume_v = v;
+  tcb->resume_param = param;
+}
+
+
+//================================================================
+/*! finish the call waiting for the event, before the task runs.
+
+  @param  tcb		target task.
+  @retval 0		finished. run the task.
+  @retval 1		the task waits again.
+*/
+static int event_resume( mrbc_tcb *tcb )
+{
+  int ret = 0;
+  hal_disable_irq();
+
+  if( tcb->resume_func( tcb, tcb->event == NULL ) == 0 || !tcb->event ) {
+    tcb->resume_func = NULL;
+  } else {
+    q_delete_task(tcb);
+    tcb->state  = TASKSTATE_WAITING;
+    tcb->reason = TASKREASON_EVENT;
+    q_insert_task(tcb);
+    ret = 1;
+  }
+
+  hal_enable_irq();
+  return ret;
+}
+
+
+//================================================================
+/*! post the event from the interrupt handler.
+
+  Only the slot is recorded here, and the waiting tasks are woken up
+  at the next tick. So it can be called from the interrupt handler that
+  nests with the tick interrupt handler.
+
+  @param  event		event.
+  @retval 0		posted.
+  @retval 1		slots are full. all waiting tasks will be woken up.
+*/
+int mrbc_notify_event_from_isr(const void *event)
+{
+  int i;
+  for( i = 0; i < MRBC_NUM_PENDING_EVENT; i++ ) {
+    if( pending_event_[i] == event ) goto POSTED;
+  }
+  for( i = 0; i < MRBC_NUM_PENDING_EVENT; i++ ) {
+    if( pending_event_[i] == 0 ) {
+      pending_event_[i] = event;
+      goto POSTED;
+    }
+  }
+  flag_pending_event_ = 3;
+  return 1;
+
+ POSTED:
+  flag_pending_event_ |= 1;
+  return 0;
+}
+
+
 
 //================================================================
 /*! mutex initialize
@@ -837,6 +1303,265 @@ int mrbc_mutex_trylock( mrbc_mutex *mutex, mrbc_tcb *tcb )
 }
 
 
+//================================================================
+/*! find a task waiting for the queue.
+
+  @param  queue		pointer to queue.
+  @return		waiting task or NULL.
+  @note	The waiting tasks are either all pop or all push, because
+	pop waits only when empty and push waits only when full.
+*/
+static mrbc_tcb * queue_find_waiter( const mrbc_queue *queue )
+{
+  for( int i = 0; i < 2; i++ ) {
+    mrbc_tcb *tcb = i == 0 ? q_waiting_ : q_suspended_;
+    for( ; tcb != NULL; tcb = tcb->next ) {
+      if( tcb->reason == TASKREASON_QUEUE && tcb->queue == queue ) return tcb;
+    }
+  }
+  return NULL;
+}
+
+
+//================================================================
+/*! wake up the task waiting for the queue.
+
+  @param  tcb		target task.
+*/
+static void queue_wakeup( mrbc_tcb *tcb )
+{
+  tcb->reason = 0;
+  if( tcb->state != TASKSTATE_WAITING ) return;	// resume later.
+
+  q_delete_task(tcb);
+  tcb->state = TASKSTATE_READY;
+  q_insert_task(tcb);
+  preempt_running_task();
+}
+
+
+//================================================================
+/*! put the value to the queue, or hand it to the waiting task.
+
+  @param  queue		pointer to queue.
+  @param  val		value.
+  @retval 0		done.
+  @retval -1		queue is full.
+  @note	must be called with interrupt disabled.
+*/
+static int queue_put( mrbc_queue *queue, const mrbc_value *val )
+{
+  if( queue->n_data == 0 ) {
+    mrbc_tcb *tcb = queue_find_waiter( queue );
+    if( tcb ) {
+      tcb->queue_value = *val;
+      queue_wakeup( tcb );
+      return 0;
+    }
+  }
+
+  if( queue->n_data == queue->size ) return -1;
+
+  int idx = queue->head + queue->n_data;
+  if( idx >= queue->size ) idx -= queue->size;
+  queue->data[idx] = *val;
+  queue->n_data++;
+
+  return 0;
+}
+
+
+//================================================================
+/*! get the value from the queue, and take one from the waiting task.
+
+  @param  queue		pointer to queue.
+  @param  ret		pointer to the value store. (old value is released)
+  @note	must be called with interrupt disabled, and queue is not empty.
+*/
+static void queue_get( mrbc_queue *queue, mrbc_value *ret )
+{
+  mrbc_value val = queue->data[queue->head];
+  if( ++queue->head == queue->size ) queue->head = 0;
+
+  if( queue->n_data-- == queue->size ) {
+    mrbc_tcb *tcb = queue_find_waiter( queue );
+    if( tcb ) {
+      int idx = queue->head + queue->n_data;
+      if( idx >= queue->size ) idx -= queue->size;
+      queue->data[idx] = tcb->queue_value;
+      queue->n_data++;
+      queue_wakeup( tcb );
+    }
+  }
+
+  mrbc_decref( ret );
+  *ret = val;
+}
+
+
+//================================================================
+/*! store the value handed over by the queue, before the task runs.
+
+  @param  tcb		target task.
+*/
+static void queue_receive( mrbc_tcb *tcb )
+{
+  if( tcb->queue_ret == NULL || tcb->reason == TASKREASON_QUEUE ) return;
+
+  mrbc_decref( tcb->queue_ret );
+  *tcb->queue_ret = tcb->queue_value;
+  tcb->queue_ret = NULL;
+}
+
+
+//================================================================
+/*! queue initialize
+
+  @param  queue		pointer to mrbc_queue or NULL.
+  @param  size		capacity. (MRBC_QUEUE_BYTES(size) bytes are needed)
+*/
+mrbc_queue * mrbc_queue_init( mrbc_queue *queue, int size )
+{
+  if( queue == NULL ) {
+    queue = mrbc_raw_alloc( MRBC_QUEUE_BYTES(size) );
+    if( queue == NULL ) return NULL;	// ENOMEM
+  }
+
+  queue->size = size;
+  queue->n_data = 0;
+  queue->head = 0;
+
+  return queue;
+}
+
+
+//================================================================
+/*! clear the queue. release all values.
+
+  @param  queue		pointer to queue.
+*/
+void mrbc_queue_clear( mrbc_queue *queue )
+{
+  mrbc_value val = mrbc_nil_value();
+
+  hal_disable_irq();
+  int n = queue->n_data;	// values of waiting tasks are left.
+  while( n-- > 0 ) {
+    queue_get( queue, &val );
+    hal_enable_irq();
+    mrbc_decref( &val );
+    val = mrbc_nil_value();
+    hal_disable_irq();
+  }
+  hal_enable_irq();
+}
+
+
+//================================================================
+/*! push the value to the queue.
+
+  @param  queue		pointer to queue.
+  @param  val		value. the reference is moved to the queue.
+  @param  tcb		pointer to TCB.
+  @retval 0		pushed.
+  @retval 1		queue is full. the task waits until it is pushed.
+*/
+int mrbc_queue_push( mrbc_queue *queue, const mrbc_value *val, mrbc_tcb *tcb )
+{
+  int ret = 0;
+  hal_disable_irq();
+
+  if( queue_put( queue, val ) != 0 ) {
+    // To WAITING state.
+    q_delete_task(tcb);
+    tcb->state  = TASKSTATE_WAITING;
+    tcb->reason = TASKREASON_QUEUE;
+    tcb->queue = queue;
+    tcb->queue_value = *val;
+    tcb->queue_ret = NULL;
+    q_insert_task(tcb);
+    tcb->vm.flag_preemption = 1;
+    ret = 1;
+  }
+
+  hal_enable_irq();
+  return ret;
+}
+
+
+//================================================================
+/*! push the value to the queue from the interrupt handler.
+
+  @param  queue		pointer to queue.
+  @param  val		value. (must not be an object. e.g. Integer)
+  @retval 0		pushed.
+  @retval -1		queue is full. the value is dropped.
+  @note	Interrupts must not be nested with the tick interrupt handler,
+	same as mrbc_tick().
+*/
+int mrbc_queue_push_from_isr( mrbc_queue *queue, const mrbc_value *val )
+{
+  return queue_put( queue, val );
+}
+
+
+//================================================================
+/*! pop the value from the queue.
+
+  @param  queue		pointer to queue.
+  @param  ret		pointer to the value store. (old value is released)
+  @param  tcb		pointer to TCB.
+  @retval 0		popped.
+  @retval 1		queue is empty. the task waits, and the value is
+			stored to *ret before the task runs again.
+*/
+int mrbc_queue_pop( mrbc_queue *queue, mrbc_value *ret, mrbc_tcb *tcb )
+{
+  int r = 0;
+  hal_disable_irq();
+
+  if( queue->n_data != 0 ) {
+    queue_get( queue, ret );
+  } else {
+    // To WAITING state.
+    q_delete_task(tcb);
+    tcb->state  = TASKSTATE_WAITING;
+    tcb->reason = TASKREASON_QUEUE;
+    tcb->queue = queue;
+    tcb->queue_ret = ret;
+    q_insert_task(tcb);
+    tcb->vm.flag_preemption = 1;
+    r = 1;
+  }
+
+  hal_enable_irq();
+  return r;
+}
+
+
+//================================================================
+/*! pop the value from the queue without waiting.
+
+  @param  queue		pointer to queue.
+  @param  ret		pointer to the value store. (old value is released)
+  @retval 0		popped.
+  @retval 1		queue is empty.
+*/
+int mrbc_queue_trypop( mrbc_queue *queue, mrbc_value *ret )
+{
+  int r = 1;
+  hal_disable_irq();
+
+  if( queue->n_data != 0 ) {
+    queue_get( queue, ret );
+    r = 0;
+  }
+
+  hal_enable_irq();
+  return r;
+}
+
+
 //================================================================
 /*! clenaup all resources.
 
@@ -848,6 +1573,12 @@ void mrbc_cleanup(void)
   mrbc_cleanup_symbol();
 
   memset( task_queue_, 0, sizeof(task_queue_) );
+  memset( ready_map_, 0, sizeof(ready_map_) );
+  ready_map_group_ = 0;
+  memset( ready_tail_, 0, sizeof(ready_tail_) );
+  n_sleep_ = 0;
+  memset( (void *)pending_event_, 0, sizeof(pending_event_) );
+  flag_pending_event_ = 0;
 }
 
 
@@ -928,7 +1659,12 @@ static void c_task_get(mrbc_vm *vm, mrbc_value v[], int argc)
 
   // in case of Task.get("TasName")
   else if( v[1].tt == MRBC_TT_STRING ) {
-    tcb = mrbc_find_task( mrbc_string_cstr( &v[1] ) );
+    const char *name = mrbc_string_cstr( &v[1] );
+    if( !name ) {
+      mrbc_raise( vm, MRBC_CLASS(NoMemoryError), 0 );
+      return;
+    }
+    tcb = mrbc_find_task( name );
   }
 
   if( tcb ) {
@@ -1011,7 +1747,12 @@ static void c_task_set_name(mrbc_vm *vm, mrbc_value v[], int argc)
   } else {
     tcb = *(mrbc_tcb **)v[0].instance->data;
   }
-  mrbc_set_task_name( tcb, mrbc_string_cstr(&v[1]) );
+  const char *name = mrbc_string_cstr(&v[1]);
+  if( !name ) {
+    mrbc_raise( vm, MRBC_CLASS(NoMemoryError), 0 );
+    return;
+  }
+  mrbc_set_task_name( tcb, name );
 
   mrbc_incref( &v[1] );
   SET_RETURN( v[1] );
@@ -1196,7 +1937,8 @@ static void c_task_raise(mrbc_vm *vm, mrbc_value v[], int argc)
   vm1->exception = exc;
   vm1->flag_preemption = 2;
 
-  if( tcb->state == TASKSTATE_WAITING && tcb->reason == TASKREASON_SLEEP ) {
+  if( tcb->state == TASKSTATE_WAITING &&
+      (tcb->reason == TASKREASON_SLEEP || tcb->reason == TASKREASON_EVENT) ) {
     void mrbc_wakeup_task(mrbc_tcb *tcb);
     mrbc_wakeup_task( tcb );
   }
@@ -1269,7 +2011,7 @@ static void c_task_create(mrbc_vm *vm, mrbc_value v[], int argc)
 
   if( argc >= 1 && v[1].tt != MRBC_TT_STRING ) goto ERROR_ARGUMENT;
   mrbc_incref( &v[1] );
-  byte_code = mrbc_string_cstr(&v[1]);
+  byte_code = mrbc_string_ptr(&v[1]);	// needs no '\0'.
 
   if( argc >= 2 ) {
     if( v[2].tt != MRBC_TT_INTEGER ) goto ERROR_ARGUMENT;
@@ -1451,6 +2193,126 @@ static void c_mutex_owned(mrbc_vm *vm, mrbc_value v[], int argc)
 
 
 
+/*
+  Queue class
+*/
+//================================================================
+/*! (method) queue constructor
+
+  Queue.new( size = 16 )
+*/
+static void c_queue_new(mrbc_vm *vm, mrbc_value v[], int argc)
+{
+  mrbc_int_t size = 16;
+  if( argc >= 1 ) {
+    if( mrbc_type(v[1]) != MRBC_TT_INTEGER ||
+        mrbc_integer(v[1]) <= 0 || mrbc_integer(v[1]) > 0xffff ) {
+      mrbc_raise(vm, MRBC_CLASS(ArgumentError), 0);
+      return;
+    }
+    size = mrbc_integer(v[1]);
+  }
+
+  *v = mrbc_instance_new(vm, v->cls, MRBC_QUEUE_BYTES(size));
+  if( !v->instance ) return;
+
+  mrbc_queue_init( (mrbc_queue *)(v->instance->data), size );
+}
+
+
+//================================================================
+/*! (destructor) release the values in the queue.
+
+*/
+static void c_queue_destructor(mrbc_value *v)
+{
+  mrbc_queue_clear( (mrbc_queue *)(v->instance->data) );
+}
+
+
+//================================================================
+/*! (method) push the value. waits while the queue is full.
+
+  queue.push( obj ) -> self
+  queue << obj      -> self
+*/
+static void c_queue_push(mrbc_vm *vm, mrbc_value v[], int argc)
+{
+  if( argc != 1 ) {
+    mrbc_raise(vm, MRBC_CLASS(ArgumentError), 0);
+    return;
+  }
+
+  mrbc_incref( &v[1] );
+  mrbc_queue_push( (mrbc_queue *)v->instance->data, &v[1], VM2TCB(vm) );
+}
+
+
+//================================================================
+/*! (method) pop the value. waits while the queue is empty.
+
+  queue.pop( non_block = false ) -> obj
+  (note) returns nil if non_block and the queue is empty.
+*/
+static void c_queue_pop(mrbc_vm *vm, mrbc_value v[], int argc)
+{
+  mrbc_queue *queue = (mrbc_queue *)v->instance->data;
+
+  if( argc >= 1 && mrbc_type(v[1]) != MRBC_TT_NIL &&
+      mrbc_type(v[1]) != MRBC_TT_FALSE ) {
+    if( mrbc_queue_trypop( queue, v ) != 0 ) SET_NIL_RETURN();
+    return;
+  }
+
+  // the value is stored to v[0] when the task is woken up.
+  mrbc_queue_pop( queue, v, VM2TCB(vm) );
+}
+
+
+//================================================================
+/*! (method) number of values in the queue.
+
+*/
+static void c_queue_size(mrbc_vm *vm, mrbc_value v[], int argc)
+{
+  mrbc_queue *queue = (mrbc_queue *)v->instance->data;
+  SET_INT_RETURN( queue->n_data );
+}
+
+
+//================================================================
+/*! (method) capacity of the queue.
+
+*/
+static void c_queue_max(mrbc_vm *vm, mrbc_value v[], int argc)
+{
+  mrbc_queue *queue = (mrbc_queue *)v->instance->data;
+  SET_INT_RETURN( queue->size );
+}
+
+
+//================================================================
+/*! (method) queue empty?
+
+*/
+static void c_queue_empty(mrbc_vm *vm, mrbc_value v[], int argc)
+{
+  mrbc_queue *queue = (mrbc_queue *)v->instance->data;
+  SET_BOOL_RETURN( queue->n_data == 0 );
+}
+
+
+//================================================================
+/*! (method) remove all values.
+
+*/
+static void c_queue_clear(mrbc_vm *vm, mrbc_value v[], int argc)
+{
+  mrbc_queue_clear( (mrbc_queue *)v->instance->data );
+}
+
+
+
 //================================================================
 /*! (method) get tick counter
 */
@@ -1459,6 +2321,63 @@ static void c_vm_tick(mrbc_vm *vm, mrbc_value v[], int argc)
   SET_INT_RETURN(tick_);
 }
 
+#if defined(MRBC_USE_PROFILER)
+//================================================================
+/*! (method) profiler
+
+  VM.profile(true)	# start profiling. (clear the data)
+  VM.profile(false)	# stop profiling.
+  VM.profile		#=> {"Class#method"=>ticks, ...}
+  VM.profile(:opcode)	#=> {"OP_SEND"=>count, ...}
+*/
+static void c_vm_profile(mrbc_vm *vm, mrbc_value v[], int argc)
+{
+  if( argc == 1 && mrbc_type(v[1]) == MRBC_TT_TRUE ) {
+    mrbc_profile_start();
+    SET_TRUE_RETURN();
+    return;
+  }
+  if( argc == 1 && mrbc_type(v[1]) == MRBC_TT_FALSE ) {
+    mrbc_profile_stop();
+    SET_FALSE_RETURN();
+    return;
+  }
+
+  mrbc_value ret = mrbc_hash_new(vm, 0);
+  if( !ret.hash ) return;		// ENOMEM
+  char buf[40];
+
+  if( argc == 1 && mrbc_type(v[1]) == MRBC_TT_SYMBOL &&
+      mrbc_symbol(v[1]) == mrbc_search_symid("opcode") ) {
+    for( int i = 0; i < 256; i++ ) {
+      if( mrbc_profile.op_count[i] == 0 ) continue;
+      const char *name = mrbc_profile_opcode_name(i);
+      if( name ) {
+	mrbc_snprintf( buf, sizeof(buf), "OP_%s", name );
+      } else {
+	mrbc_snprintf( buf, sizeof(buf), "0x%02x", i );
+      }
+      mrbc_value key = mrbc_string_new_cstr(vm, buf);
+      mrbc_value val = mrbc_integer_value(mrbc_profile.op_count[i]);
+      mrbc_hash_set( &ret, &key, &val );
+    }
+
+  } else {
+    for( int i = 0; i < MRBC_PROFILE_METHOD_COUNT; i++ ) {
+      const struct MRBC_PROFILE_METHOD *m = &mrbc_profile.method[i];
+      if( m->ticks == 0 ) break;
+      mrbc_profile_method_name( m, buf, sizeof(buf) );
+      mrbc_value key = mrbc_string_new_cstr(vm, buf);
+      mrbc_value val = mrbc_integer_value(m->ticks);
+      mrbc_hash_set( &ret, &key, &val );
+    }
+  }
+
+  SET_RETURN(ret);
+}
+#endif
+
+
 /* MRBC_AUTOGEN_METHOD_TABLE
 
   CLASS("VM")
@@ -1507,6 +2426,27 @@ void mrbc_init(void *heap_ptr, unsigned int size)
 
   mrbc_define_method(0, 0, "sleep", c_sleep);
   mrbc_define_method(0, 0, "sleep_ms", c_sleep_ms);
+
+  // Queue class has a destructor, so it is not a built-in class.
+  static const struct MRBC_DEFINE_METHOD_LIST queue_methods[] = {
+    {"new", c_queue_new},
+    {"push", c_queue_push},
+    {"<<", c_queue_push},
+    {"pop", c_queue_pop},
+    {"shift", c_queue_pop},
+    {"size", c_queue_size},
+    {"length", c_queue_size},
+    {"max", c_queue_max},
+    {"empty?", c_queue_empty},
+    {"clear", c_queue_clear},
+  };
+  mrbc_class *queue = mrbc_define_class(0, "Queue", 0);
+  mrbc_define_method_list(0, queue, queue_methods,
+                          sizeof(queue_methods) / sizeof(queue_methods[0]));
+  mrbc_define_destructor( queue, c_queue_destructor );
+#if defined(MRBC_USE_PROFILER)
+  mrbc_define_method(0, MRBC_CLASS(VM), "profile", c_vm_profile);
+#endif
 }
 
 
@@ -1541,7 +2481,8 @@ void pq(const mrbc_tcb *p_tcb)
   // task priority, state.
   //  st:SsRr
   //     ^ suspended -> S:suspended
-  //      ^ waiting  -> s:sleep m:mutex J:join (uppercase is suspend state)
+  //      ^ waiting  -> s:sleep m:mutex J:join q:queue e:event
+  //                    (uppercase is suspend state)
   //       ^ ready   -> R:ready
   //        ^ running-> r:running
   for( const mrbc_tcb *t = p_tcb; t; t = t->next ) {
@@ -1550,8 +2491,8 @@ void pq(const mrbc_tcb *p_tcb)
     mrbc_tcb t1 = *t;               // Copy the value at this timing.
     mrbc_printf(" st:%c%c%c%c    ",
       (t1.state & TASKSTATE_SUSPENDED)?'S':'-',
-      (t1.state & TASKSTATE_SUSPENDED)? ("-SM!J"[t1.reason]) :
-      (t1.state & TASKSTATE_WAITING)?   ("!sm!j"[t1.reason]) : '-',
+      (t1.state & TASKSTATE_SUSPENDED)? ("-SM!J!!!Q!!!!!!!E"[t1.reason]) :
+      (t1.state & TASKSTATE_WAITING)?   ("!sm!j!!!q!!!!!!!e"[t1.reason]) : '-',
       (t1.state & 0x02)?'R':'-',
       (t1.state & 0x01)?'r':'-' );
 #else
@@ -1575,7 +2516,8 @@ void pq(const mrbc_tcb *p_tcb)
 void pqall(void)
 {
   hal_disable_irq();
-  mrbc_printf("<< tick_ = %d, wakeup_tick_ = %d >>\n", tick_, wakeup_tick_);
+  mrbc_printf("<< tick_ = %d, wakeup_tick = %d >>\n", tick_,
+              n_sleep_ ? sleep_heap_[0]->wakeup_tick : -1);
   mrbc_printf("<<<<< DORMANT >>>>>\n");   pq(q_dormant_);
   mrbc_printf("<<<<< READY >>>>>\n");     pq(q_ready_);
   mrbc_printf("<<<<< WAITING >>>>>\n");   pq(q_waiting_);
@@ -50,6 +50,8 @@ enum MrbcTaskReason {
   TASKREASON_SLEEP = 0x01,
   TASKREASON_MUTEX = 0x02,
   TASKREASON_JOIN  = 0x04,
+  TASKREASON_QUEUE = 0x08,
+  TASKREASON_EVENT = 0x10,
 };
 
 static const int MRBC_TASK_DEFAULT_PRIORITY = 128;
@@ -59,11 +61,20 @@ static const int MRBC_TASK_DEFAULT_STATE = TASKSTATE_READY;
 #define MRBC_TASK_NAME_LEN 15
 #endif
 
+// Num of events that interrupt handlers can post between ticks.
+#if !defined(MRBC_NUM_PENDING_EVENT)
+#define MRBC_NUM_PENDING_EVENT 4
+#endif
+
 
 /***** Macros ***************************************************************/
 /***** Typedefs *************************************************************/
-
+struct RTcb;
 struct RMutex;
+struct RQueue;
+
+//! function that finishes the call waiting for the event.
+typedef int (*mrbc_resume_func)(struct RTcb *tcb, int flag_timeout);
 
 //================================================
 /*!@brief
@@ -74,18 +85,31 @@ typedef struct RTcb {
   uint8_t obj_mark_[4];		//!< set "TCB\0" for debug.
 #endif
   struct RTcb *next;		//!< daisy chain in task queue.
+  struct RTcb *prev;		//!< previous task. (ready queue only)
   uint8_t priority;		//!< task priority. initial value.
   uint8_t priority_preemption;	//!< task priority. effective value.
   volatile uint8_t timeslice;	//!< time slice counter.
   uint8_t state;		//!< task state. defined in MrbcTaskState.
   uint8_t reason;		//!< sub state. defined in MrbcTaskReason.
+  uint8_t sleep_idx;		//!< index in the sleep heap + 1, or 0.
+  uint8_t flag_event_timeout;	//!< waiting for the event with timeout.
   char name[MRBC_TASK_NAME_LEN+1]; //!< task name (optional)
 
   union {
     uint32_t wakeup_tick;	//!< wakeup time for sleep state.
     struct RMutex *mutex;
+    struct RQueue *queue;
   };
   const struct RTcb *tcb_join;  //!< joined task.
+  mrbc_value queue_value;	//!< value handed over by the queue.
+  mrbc_value *queue_ret;	//!< where to store queue_value, or NULL.
+  const void *event;		//!< event to wait for. NULL if timed out.
+  mrbc_resume_func resume_func;	//!< finishes the waiting call, or NULL.
+  mrbc_value *resume_v;		//!< v[] of the waiting call.
+  int32_t resume_param;		//!< parameter of the waiting call.
+#if defined(MRBC_USE_SCRATCH_ARENA)
+  void *scratch;		//!< scratch arena, or NULL.
+#endif
 
   struct VM vm;
 
@@ -104,6 +128,20 @@ typedef struct RMutex {
 #define MRBC_MUTEX_INITIALIZER { 0 }
 
 
+//================================================
+/*!@brief
+  Queue (bounded FIFO of mrbc_value)
+*/
+typedef struct RQueue {
+  uint16_t size;		//!< capacity.
+  volatile uint16_t n_data;	//!< num of stored values.
+  uint16_t head;		//!< index of the oldest value.
+  mrbc_value data[];
+} mrbc_queue;
+
+#define MRBC_QUEUE_BYTES(size) (sizeof(mrbc_queue) + sizeof(mrbc_value) * (size))
+
+
 /***** Global variables *****************************************************/
 /***** Function prototypes **************************************************/
 //@cond
@@ -112,6 +150,7 @@ mrbc_tcb *mrbc_tcb_new(int regs_size, enum MrbcTaskState task_state, int priorit
 mrbc_tcb *mrbc_create_task(const void *byte_code, mrbc_tcb *tcb);
 int mrbc_delete_task(mrbc_tcb *tcb);
 void mrbc_set_task_name(mrbc_tcb *tcb, const char *name);
+int mrbc_set_scratch_arena(mrbc_tcb *tcb, unsigned int size);
 mrbc_tcb *mrbc_find_task(const char *name);
 int mrbc_start_task(mrbc_tcb *tcb);
 int mrbc_run(void);
@@ -122,10 +161,20 @@ void mrbc_suspend_task(mrbc_tcb *tcb);
 void mrbc_resume_task(mrbc_tcb *tcb);
 void mrbc_terminate_task(mrbc_tcb *tcb);
 void mrbc_join_task(mrbc_tcb *tcb, const mrbc_tcb *tcb_join);
+mrbc_tcb *mrbc_get_running_task(void);
+void mrbc_wait_event(mrbc_tcb *tcb, const void *event, int32_t timeout_ms);
+void mrbc_set_resume_func(mrbc_tcb *tcb, mrbc_resume_func func, mrbc_value v[], int32_t param);
+int mrbc_notify_event_from_isr(const void *event);
 mrbc_mutex *mrbc_mutex_init(mrbc_mutex *mutex);
 int mrbc_mutex_lock(mrbc_mutex *mutex, mrbc_tcb *tcb);
 int mrbc_mutex_unlock(mrbc_mutex *mutex, mrbc_tcb *tcb);
 int mrbc_mutex_trylock(mrbc_mutex *mutex, mrbc_tcb *tcb);
+mrbc_queue *mrbc_queue_init(mrbc_queue *queue, int size);
+void mrbc_queue_clear(mrbc_queue *queue);
+int mrbc_queue_push(mrbc_queue *queue, const mrbc_value *val, mrbc_tcb *tcb);
+int mrbc_queue_push_from_isr(mrbc_queue *queue, const mrbc_value *val);
+int mrbc_queue_pop(mrbc_queue *queue, mrbc_value *ret, mrbc_tcb *tcb);
+int mrbc_queue_trypop(mrbc_queue *queue, mrbc_value *ret);
 void mrbc_cleanup(void);
 void mrbc_init(void *heap_ptr, unsigned int size);
 void pq(const mrbc_tcb *p_tcb);
@@ -24,12 +24,18 @@
 /***** Local headers ********************************************************/
 #define MRBC_DEFINE_SYMBOL_TABLE
 #include "_autogen_builtin_symbol.h"
+#include "_autogen_builtin_symbol_hash.h"
 #undef MRBC_DEFINE_SYMBOL_TABLE
 #include "mrubyc.h"
 
 /***** Constant values ******************************************************/
-#if !defined(MRBC_SYMBOL_SEARCH_LINEAR) && !defined(MRBC_SYMBOL_SEARCH_BTREE)
-#define MRBC_SYMBOL_SEARCH_BTREE
+/*
+  MRBC_SYMBOL_SEARCH_HASH	open addressing hash table. (default)
+  MRBC_SYMBOL_SEARCH_LINEAR	linear search. no additional RAM.
+*/
+#if !defined(MRBC_SYMBOL_SEARCH_LINEAR)
+#undef MRBC_SYMBOL_SEARCH_BTREE		// replaced by hash table.
+#define MRBC_SYMBOL_SEARCH_HASH
 #endif
 
 #if MAX_SYMBOLS_COUNT <= UCHAR_MAX
@@ -38,25 +44,50 @@
 #define MRBC_SYMBOL_TABLE_INDEX_TYPE	uint16_t
 #endif
 
+// size of the hash table. (power of 2, over twice of MAX_SYMBOLS_COUNT)
+#if MAX_SYMBOLS_COUNT < 128
+#define SYM_HASH_SIZE 256
+#elif MAX_SYMBOLS_COUNT < 256
+#define SYM_HASH_SIZE 512
+#elif MAX_SYMBOLS_COUNT < 512
+#define SYM_HASH_SIZE 1024
+#elif MAX_SYMBOLS_COUNT < 1024
+#define SYM_HASH_SIZE 2048
+#elif MAX_SYMBOLS_COUNT < 2048
+#define SYM_HASH_SIZE 4096
+#elif MAX_SYMBOLS_COUNT < 4096
+#define SYM_HASH_SIZE 8192
+#else
+#error "MAX_SYMBOLS_COUNT is too large."
+#endif
+
 #define OFFSET_BUILTIN_SYMBOL 256
 
+#if MRBC_BUILTIN_SYMBOL_COUNT > OFFSET_BUILTIN_SYMBOL
+#error "Too many built-in symbols."
+#endif
+
 
 /***** Macros ***************************************************************/
 /***** Typedefs *************************************************************/
 struct SYM_INDEX {
-  uint16_t hash;	//!< hash value, returned by calc_hash().
-#ifdef MRBC_SYMBOL_SEARCH_BTREE
-  MRBC_SYMBOL_TABLE_INDEX_TYPE left;
-  MRBC_SYMBOL_TABLE_INDEX_TYPE right;
-#endif
+  uint32_t hash;	//!< hash value, returned by calc_hash().
   const char *cstr;	//!< point to the symbol string.
 };
 
+// check that _autogen_builtin_symbol_hash.h matches the built-in symbols.
+typedef char check_builtin_symbol_hash[
+  (sizeof(builtin_symbols) / sizeof(builtin_symbols[0]) ==
+   MRBC_BUILTIN_SYMBOL_COUNT) ? 1 : -1];
+
 
 /***** Function prototypes **************************************************/
 /***** Local variables ******************************************************/
 static struct SYM_INDEX sym_index[MAX_SYMBOLS_COUNT];
 static int sym_index_pos;	// point to the last(free) sym_index array.
+#ifdef MRBC_SYMBOL_SEARCH_HASH
+static MRBC_SYMBOL_TABLE_INDEX_TYPE sym_hash_table[SYM_HASH_SIZE];  // index+1
+#endif
 
 
 /***** Global variables *****************************************************/
@@ -64,56 +95,43 @@ static int sym_index_pos;	// point to the last(free) sym_index array.
 /***** Local functions ******************************************************/
 
 //================================================================
-/*! Calculate hash value.
+/*! Calculate hash value. (FNV-1a)
+
+  (note)
+  The same function is used by make_symbol_hash.rb to generate
+  the perfect hash table of built-in symbols.
 
   @param  str		Target string.
-  @return uint16_t	Hash value.
+  @return uint32_t	Hash value.
 */
-static inline uint16_t calc_hash(const char *str)
+static inline uint32_t calc_hash(const char *str)
 {
-  uint16_t h = 0;
+  uint32_t h = 2166136261UL;
 
   while( *str != '\0' ) {
-    h = h * 17 + *str++;
+    h ^= (uint8_t)*str++;
+    h *= 16777619UL;
   }
   return h;
 }
 
 
 //================================================================
-/*! search built-in symbol table
+/*! search built-in symbol table using the perfect hash.
 
+  @param  hash	hash value.
   @param  str	string ptr.
   @return	symbol id. or -1 if not found.
 */
-static int search_builtin_symbol( const char *str )
+static int search_builtin_symbol( uint32_t hash, const char *str )
 {
-  int left = 0;
-  int right = sizeof(builtin_symbols) / sizeof(builtin_symbols[0]);
-
-  while( left < right ) {
-    int mid = (left + right) / 2;
-    const unsigned char *p1 = (const unsigned char *)builtin_symbols[mid];
-    const unsigned char *p2 = (const unsigned char *)str;
-
-    while( 1 ) {	// string compare, same order as cruby.
-      if( *p1 < *p2 ) {
-	left = mid + 1;
-	break;
-      }
-      if( *p1 > *p2 ) {
-	right = mid;
-	break;
-      }
-      if( *p1 == 0 ) {
-	return mid;
-      }
-
-      p1++;
-      p2++;
-    }
-  }
+  uint32_t d = builtin_symbol_disp[hash & (MRBC_BUILTIN_SYMBOL_BUCKETS-1)];
+  int sym_id = builtin_symbol_slot[((hash >> 6) + d * ((hash >> 15) | 1))
+				   & (MRBC_BUILTIN_SYMBOL_SLOTS-1)];
 
+  if( sym_id != 0 && strcmp(str, builtin_symbols[sym_id]) == 0 ) {
+    return sym_id;
+  }
   return -1;
 }
 
@@ -125,7 +143,7 @@ static int search_builtin_symbol( const char *str )
   @param  str	string ptr.
   @return	index. or -1 if not found.
 */
-static int search_index( uint16_t hash, const char *str )
+static int search_index( uint32_t hash, const char *str )
 {
 #ifdef MRBC_SYMBOL_SEARCH_LINEAR
   for( int i = 0; i < sym_index_pos; i++ ) {
@@ -136,18 +154,16 @@ static int search_index( uint16_t hash, const char *str )
   return -1;
 #endif
 
-#ifdef MRBC_SYMBOL_SEARCH_BTREE
-  int i = 0;
-  do {
+#ifdef MRBC_SYMBOL_SEARCH_HASH
+  unsigned int pos = hash & (SYM_HASH_SIZE-1);
+
+  while( sym_hash_table[pos] != 0 ) {
+    int i = sym_hash_table[pos] - 1;
     if( sym_index[i].hash == hash && strcmp(str, sym_index[i].cstr) == 0 ) {
       return i;
     }
-    if( hash < sym_index[i].hash ) {
-      i = sym_index[i].left;
-    } else {
-      i = sym_index[i].right;
-    }
-  } while( i != 0 );
+    pos = (pos + 1) & (SYM_HASH_SIZE-1);
+  }
   return -1;
 #endif
 }
@@ -160,7 +176,7 @@ static int search_index( uint16_t hash, const char *str )
   @param  str	string ptr.
   @return	index. or -1 if error.
 */
-static int add_index( uint16_t hash, const char *str )
+static int add_index( uint32_t hash, const char *str )
 {
   if( sym_index_pos >= MAX_SYMBOLS_COUNT ) return -1;	// check overflow.
 
@@ -170,26 +186,13 @@ static int add_index( uint16_t hash, const char *str )
   sym_index[idx].hash = hash;
   sym_index[idx].cstr = str;
 
-#ifdef MRBC_SYMBOL_SEARCH_BTREE
-  int i = 0;
+#ifdef MRBC_SYMBOL_SEARCH_HASH
+  unsigned int pos = hash & (SYM_HASH_SIZE-1);
 
-  while( 1 ) {
-    if( hash < sym_index[i].hash ) {
-      // left side
-      if( sym_index[i].left == 0 ) {	// left is empty?
-        sym_index[i].left = idx;
-        break;
-      }
-      i = sym_index[i].left;
-    } else {
-      // right side
-      if( sym_index[i].right == 0 ) {	// right is empty?
-        sym_index[i].right = idx;
-        break;
-      }
-      i = sym_index[i].right;
-    }
+  while( sym_hash_table[pos] != 0 ) {
+    pos = (pos + 1) & (SYM_HASH_SIZE-1);
   }
+  sym_hash_table[pos] = idx + 1;
 #endif
 
   return idx;
@@ -205,6 +208,9 @@ void mrbc_cleanup_symbol(void)
 {
   memset(sym_index, 0, sizeof(sym_index));
   sym_index_pos = 0;
+#ifdef MRBC_SYMBOL_SEARCH_HASH
+  memset(sym_hash_table, 0, sizeof(sym_hash_table));
+#endif
 }
 
 
@@ -216,10 +222,10 @@ void mrbc_cleanup_symbol(void)
 */
 mrbc_sym mrbc_str_to_symid(const char *str)
 {
-  mrbc_sym sym_id = search_builtin_symbol(str);
+  uint32_t h = calc_hash(str);
+  mrbc_sym sym_id = search_builtin_symbol(h, str);
   if( sym_id >= 0 ) return sym_id;
 
-  uint16_t h = calc_hash(str);
   sym_id = search_index(h, str);
   if( sym_id < 0 ) sym_id = add_index( h, str );
   if( sym_id < 0 ) return sym_id;
@@ -257,10 +263,10 @@ const char * mrbc_symid_to_str(mrbc_sym sym_id)
 */
 mrbc_sym mrbc_search_symid( const char *str )
 {
-  mrbc_sym sym_id = search_builtin_symbol(str);
+  uint32_t h = calc_hash(str);
+  mrbc_sym sym_id = search_builtin_symbol(h, str);
   if( sym_id >= 0 ) return sym_id;
 
-  uint16_t h = calc_hash(str);
   sym_id = search_index(h, str);
   if( sym_id < 0 ) return sym_id;
 
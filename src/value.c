@@ -35,7 +35,13 @@
   @see mrbc_vtype in value.h
 */
 void (* const mrbc_delfunc[])(mrbc_value *) = {
-  0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0,
+#if MRBC_USE_FLOAT && defined(MRBC_USE_COMPACT_VALUE)
+  mrbc_float_delete,            // MRBC_TT_FLOAT     = 5,
+#else
+  0,
+#endif
+  0, 0, 0,
   mrbc_instance_delete,         // MRBC_TT_OBJECT    = 9,
   mrbc_proc_delete,             // MRBC_TT_PROC      = 10,
   mrbc_array_delete,            // MRBC_TT_ARRAY     = 11,
@@ -52,6 +58,17 @@ void (* const mrbc_delfunc[])(mrbc_value *) = {
 
 /***** Signal catching functions ********************************************/
 /***** Local functions ******************************************************/
+//================================================================
+/*! get C string of the String object, or raise NoMemoryError.
+*/
+static char * string_cstr(struct VM *vm, const mrbc_value *val)
+{
+  char *s = mrbc_string_cstr( val );
+  if( !s ) mrbc_raise(vm, MRBC_CLASS(NoMemoryError), 0);	// ENOMEM
+  return s;
+}
+
+
 /***** Global functions *****************************************************/
 
 //================================================================
@@ -75,11 +92,11 @@ int mrbc_compare(const mrbc_value *v1, const mrbc_value *v2)
     // but Numeric?
     if( mrbc_type(*v1) == MRBC_TT_INTEGER && mrbc_type(*v2) == MRBC_TT_FLOAT ) {
       d1 = v1->i;
-      d2 = v2->d;
+      d2 = mrbc_float(*v2);
       goto CMP_FLOAT;
     }
     if( mrbc_type(*v1) == MRBC_TT_FLOAT && mrbc_type(*v2) == MRBC_TT_INTEGER ) {
-      d1 = v1->d;
+      d1 = mrbc_float(*v1);
       d2 = v2->i;
       goto CMP_FLOAT;
     }
@@ -101,7 +118,9 @@ int mrbc_compare(const mrbc_value *v1, const mrbc_value *v2)
     return 0;
 
   case MRBC_TT_INTEGER:
-    return mrbc_integer(*v1) - mrbc_integer(*v2);
+    // (note) not a subtraction to avoid overflow.
+    return (mrbc_integer(*v1) > mrbc_integer(*v2)) -
+	   (mrbc_integer(*v1) < mrbc_integer(*v2));
 
   case MRBC_TT_SYMBOL: {
     const char *str1 = mrbc_symid_to_str(mrbc_symbol(*v1));
@@ -159,6 +178,9 @@ int mrbc_compare(const mrbc_value *v1, const mrbc_value *v2)
 void mrbc_clear_vm_id(mrbc_value *v)
 {
   switch( mrbc_type(*v) ) {
+#if MRBC_USE_FLOAT && defined(MRBC_USE_COMPACT_VALUE)
+  case MRBC_TT_FLOAT:	mrbc_set_vm_id(v->flt, 0);	break;
+#endif
   case MRBC_TT_OBJECT:	mrbc_instance_clear_vm_id(v);	break;
   case MRBC_TT_PROC:	mrbc_proc_clear_vm_id(v);	break;
   case MRBC_TT_ARRAY:	mrbc_array_clear_vm_id(v);	break;
@@ -270,7 +292,7 @@ mrbc_int_t mrbc_val_i(struct VM *vm, const mrbc_value *val)
     return val->i;
 
   case MRBC_TT_FLOAT:
-    return val->d;
+    return mrbc_float(*val);
 
   default:
     ;
@@ -319,7 +341,7 @@ double mrbc_val_f(struct VM *vm, const mrbc_value *val)
     return val->i;
 
   case MRBC_TT_FLOAT:
-    return val->d;
+    return mrbc_float(*val);
 
   default:
     ;
@@ -365,7 +387,7 @@ const char * mrbc_val_s(struct VM *vm, const mrbc_value *val)
 
   switch(val->tt) {
   case MRBC_TT_STRING:
-    return mrbc_string_cstr( val );
+    return string_cstr( vm, val );
 
   default:
     ;
@@ -419,9 +441,11 @@ mrbc_int_t mrbc_to_i(struct VM *vm, mrbc_value v[], int argc, mrbc_value *val)
   case MRBC_TT_INTEGER:
     break;
 
-  case MRBC_TT_FLOAT:
-    mrbc_set_integer(val, val->d);
-    break;
+  case MRBC_TT_FLOAT: {
+    mrbc_int_t i = mrbc_float(*val);
+    mrbc_decref( val );
+    mrbc_set_integer(val, i);
+   } break;
 
   default:{
     mrbc_value ret = mrbc_send( vm, v, argc, val, "to_i", 0 );
@@ -458,7 +482,7 @@ mrbc_float_t mrbc_to_f(struct VM *vm, mrbc_value v[], int argc, mrbc_value *val)
     return 0;
 
   case MRBC_TT_INTEGER:
-    mrbc_set_float(val, val->i);
+    *val = mrbc_float_value(vm, val->i);
     break;
 
   case MRBC_TT_FLOAT:
@@ -473,7 +497,8 @@ mrbc_float_t mrbc_to_f(struct VM *vm, mrbc_value v[], int argc, mrbc_value *val)
    } break;
   }
 
-  return val->d;
+  if( val->tt != MRBC_TT_FLOAT ) return 0;	// ENOMEM, or to_f isn't Float.
+  return mrbc_float(*val);
 }
 
 
@@ -511,7 +536,7 @@ char * mrbc_to_s(struct VM *vm, mrbc_value v[], int argc, mrbc_value *val)
   }
 
  RETURN:
-  return mrbc_string_cstr( val );
+  return string_cstr( vm, val );
 }
 
 
@@ -564,7 +589,7 @@ mrbc_int_t mrbc_arg_i(struct VM *vm, mrbc_value v[], int argc, int n)
     return v[n].i;
 
   case MRBC_TT_FLOAT:
-    return v[n].d;
+    return mrbc_float(v[n]);
 
   default:
     ;
@@ -621,7 +646,7 @@ mrbc_float_t mrbc_arg_f(struct VM *vm, mrbc_value v[], int argc, int n)
     return v[n].i;
 
   case MRBC_TT_FLOAT:
-    return v[n].d;
+    return mrbc_float(v[n]);
 
   default:
     ;
@@ -675,7 +700,7 @@ const char * mrbc_arg_s(struct VM *vm, mrbc_value v[], int argc, int n)
 
   switch(v[n].tt) {
   case MRBC_TT_STRING:
-    return mrbc_string_cstr( &v[n] );
+    return string_cstr( vm, &v[n] );
 
   default:
     ;
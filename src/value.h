@@ -38,12 +38,18 @@ struct RObject;
 #if defined(MRBC_INT16)
 typedef int16_t mrbc_int_t;
 typedef uint16_t mrbc_uint_t;
+#define MRBC_INT_MIN INT16_MIN
+#define MRBC_INT_MAX INT16_MAX
 #elif defined(MRBC_INT64)
 typedef int64_t mrbc_int_t;
 typedef uint64_t mrbc_uint_t;
+#define MRBC_INT_MIN INT64_MIN
+#define MRBC_INT_MAX INT64_MAX
 #else
 typedef int32_t mrbc_int_t;
 typedef uint32_t mrbc_uint_t;
+#define MRBC_INT_MIN INT32_MIN
+#define MRBC_INT_MAX INT32_MAX
 #endif
 typedef mrbc_int_t mrb_int;
 
@@ -55,6 +61,9 @@ typedef double mrbc_float_t;
 #if MRBC_USE_FLOAT != 0
 typedef mrbc_float_t mrb_float;
 #endif
+#if defined(MRBC_USE_COMPACT_VALUE) && defined(MRBC_INT64)
+#error "Can't use MRBC_USE_COMPACT_VALUE with MRBC_INT64"
+#endif
 
 typedef int16_t mrbc_sym;	//!< mruby/c symbol ID
 typedef void (*mrbc_func_t)(struct VM *vm, struct RObject *v, int argc);
@@ -98,6 +107,12 @@ typedef enum {
   MRBC_TT_EXCEPTION = 15,       //!< Exception
 } mrbc_vtype;
 #define	MRBC_TT_INC_DEC_THRESHOLD MRBC_TT_MODULE
+#if defined(MRBC_USE_COMPACT_VALUE)
+#define MRBC_TT_HAS_REFCOUNT(tt) \
+  ((tt) > MRBC_TT_INC_DEC_THRESHOLD || (tt) == MRBC_TT_FLOAT)
+#else
+#define MRBC_TT_HAS_REFCOUNT(tt) ((tt) > MRBC_TT_INC_DEC_THRESHOLD)
+#endif
 #define	MRBC_TT_MAXVAL MRBC_TT_EXCEPTION
 
 
@@ -152,7 +167,9 @@ struct RObject {
   mrbc_vtype tt : 8;
   union {
     mrbc_int_t i;		// MRBC_TT_INTEGER
-#if MRBC_USE_FLOAT
+#if MRBC_USE_FLOAT && defined(MRBC_USE_COMPACT_VALUE)
+    struct RFloat *flt;		// MRBC_TT_FLOAT (boxed)
+#elif MRBC_USE_FLOAT
     mrbc_float_t d;		// MRBC_TT_FLOAT
 #endif
     mrbc_sym sym_id;		// MRBC_TT_SYMBOL
@@ -192,12 +209,20 @@ typedef struct RObject mrbc_value;
 */
 #define mrbc_type(o)		((o).tt)
 #define mrbc_integer(o)		((o).i)
+#if defined(MRBC_USE_COMPACT_VALUE)
+#define mrbc_float(o)		((o).flt->d)
+#else
 #define mrbc_float(o)		((o).d)
+#endif
 #define mrbc_symbol(o)		((o).sym_id)
 
 // setters
 #define mrbc_set_integer(p,n)	(p)->tt = MRBC_TT_INTEGER; (p)->i = (n)
+#if defined(MRBC_USE_COMPACT_VALUE)
+#define mrbc_set_float(p,n)	(*(p) = mrbc_float_new(0,(n)))
+#else
 #define mrbc_set_float(p,n)	(p)->tt = MRBC_TT_FLOAT; (p)->d = (n)
+#endif
 #define mrbc_set_nil(p)		(p)->tt = MRBC_TT_NIL
 #define mrbc_set_true(p)	(p)->tt = MRBC_TT_TRUE
 #define mrbc_set_false(p)	(p)->tt = MRBC_TT_FALSE
@@ -206,13 +231,24 @@ typedef struct RObject mrbc_value;
 
 // make immediate values.
 #define mrbc_integer_value(n)	((mrbc_value){.tt = MRBC_TT_INTEGER, .i=(n)})
+#if defined(MRBC_USE_COMPACT_VALUE)
+#define mrbc_float_value(vm,n)	mrbc_float_new(vm,(n))
+#else
 #define mrbc_float_value(vm,n)	((mrbc_value){.tt = MRBC_TT_FLOAT, .d=(n)})
+#endif
 #define mrbc_nil_value()	((mrbc_value){.tt = MRBC_TT_NIL})
 #define mrbc_true_value()	((mrbc_value){.tt = MRBC_TT_TRUE})
 #define mrbc_false_value()	((mrbc_value){.tt = MRBC_TT_FALSE})
 #define mrbc_bool_value(n)	((mrbc_value){.tt = (n)?MRBC_TT_TRUE:MRBC_TT_FALSE})
 #define mrbc_symbol_value(n)	((mrbc_value){.tt = MRBC_TT_SYMBOL, .sym_id=(n)})
 
+// replace the number of a Float value. (p must hold a Float)
+#if defined(MRBC_USE_COMPACT_VALUE)
+#define mrbc_replace_float(vm,p,n)	mrbc_float_replace(vm,(p),(n))
+#else
+#define mrbc_replace_float(vm,p,n)	((p)->d = (n))
+#endif
+
 // (for mruby compatible)
 #define mrb_type(o)		mrbc_type(o)
 #define mrb_integer(o)		mrbc_integer(o)
@@ -286,19 +322,26 @@ typedef struct RObject mrbc_value;
     v[0].tt = MRBC_TT_INTEGER;	\
     v[0].i = nnn;		\
   } while(0)
+#if defined(MRBC_USE_COMPACT_VALUE)
+#define SET_FLOAT_RETURN(n) do {\
+    mrbc_float_t nnn = (n);	\
+    mrbc_float_replace(vm, v, nnn); \
+} while(0)
+#else
 #define SET_FLOAT_RETURN(n) do {\
     mrbc_float_t nnn = (n);	\
     mrbc_decref(v);		\
     v[0].tt = MRBC_TT_FLOAT;	\
     v[0].d = nnn;		\
 } while(0)
+#endif
 
 #define GET_TT_ARG(n)		(v[(n)].tt)
 #define GET_INT_ARG(n)		(v[(n)].i)
 #define GET_ARY_ARG(n)		(v[(n)])
 #define GET_ARG(n)		(v[(n)])
-#define GET_FLOAT_ARG(n)	(v[(n)].d)
-#define GET_STRING_ARG(n)	(v[(n)].string->data)
+#define GET_FLOAT_ARG(n)	mrbc_float(v[(n)])
+#define GET_STRING_ARG(n)	((uint8_t *)mrbc_string_cstr(&v[(n)]))
 
 
 #if defined(MRBC_DEBUG)
@@ -323,9 +366,9 @@ typedef struct RObject mrbc_value;
   ((val).tt == MRBC_TT_INTEGER || (val).tt == MRBC_TT_FLOAT)
 #define MRBC_TO_INT(val) \
   (val).tt == MRBC_TT_INTEGER ? (val).i : \
-  (val).tt == MRBC_TT_FLOAT ? (mrbc_int_t)(val).d : 0
+  (val).tt == MRBC_TT_FLOAT ? (mrbc_int_t)mrbc_float(val) : 0
 #define MRBC_TO_FLOAT(val) \
-  (val).tt == MRBC_TT_FLOAT ? (val).d : \
+  (val).tt == MRBC_TT_FLOAT ? mrbc_float(val) : \
   (val).tt == MRBC_TT_INTEGER ? (mrbc_float_t)(val).i : 0.0
 
 
@@ -588,7 +631,7 @@ int mrbc_arg_b2(struct VM *vm, mrbc_value v[], int argc, int n, int default_valu
 */
 static inline void mrbc_incref(mrbc_value *v)
 {
-  if( v->tt <= MRBC_TT_INC_DEC_THRESHOLD ) return;
+  if( !MRBC_TT_HAS_REFCOUNT(v->tt) ) return;
 
   assert( v->obj->ref_count != 0 );
   assert( v->obj->ref_count != 0xff );	// check max value.
@@ -603,7 +646,7 @@ static inline void mrbc_incref(mrbc_value *v)
 */
 static inline void mrbc_decref(mrbc_value *v)
 {
-  if( v->tt <= MRBC_TT_INC_DEC_THRESHOLD ) return;
+  if( !MRBC_TT_HAS_REFCOUNT(v->tt) ) return;
 
   assert( v->obj->ref_count != 0 );
   assert( v->obj->ref_count != 0xffff );	// check broken data.
@@ -31,16 +31,438 @@
 
 
 /***** Macros ***************************************************************/
+// threaded code needs "labels as values" extension (GCC, Clang, XC32).
+#if defined(MRBC_USE_THREADED_CODE) && !defined(__GNUC__)
+#undef MRBC_USE_THREADED_CODE
+#endif
+
+#if defined(MRBC_COUNT_INSTRUCTIONS) || defined(MRBC_USE_PROFILER)
+#define COUNT_INSTRUCTION(op)	count_instruction(op)
+#else
+#define COUNT_INSTRUCTION(op)	((void)0)
+#endif
+
+
 /***** Typedefs *************************************************************/
+#if MRBC_METHOD_CACHE_SIZE > 0
+//================================================================
+/*!@brief
+  Inline method cache entry. keyed by call site.
+*/
+typedef struct METHOD_CACHE {
+  const uint8_t *inst;		//!< call site. (next instruction)
+  const mrbc_class *cls;	//!< receiver's class.
+  uint32_t epoch;		//!< mrbc_method_epoch when cached.
+  mrbc_method method;		//!< found method.
+} mrbc_method_cache;
+#endif
+
+#if MRBC_IVAR_CACHE_SIZE > 0
+//================================================================
+/*!@brief
+  Instance variable slot cache entry. keyed by access site.
+*/
+typedef struct IVAR_CACHE {
+  const uint8_t *inst;		//!< access site. (next instruction)
+  const mrbc_class *cls;	//!< class of the instance.
+  uint16_t idx;			//!< index of instance->ivar.data.
+} mrbc_ivar_cache;
+#endif
+
+#if MRBC_CONST_CACHE_SIZE > 0
+//================================================================
+/*!@brief
+  Constant cache entry. keyed by reference site.
+*/
+typedef struct CONST_CACHE {
+  const uint8_t *inst;		//!< reference site. (next instruction)
+  const mrbc_class *cls;	//!< class to start the search.
+  uint32_t serial;		//!< mrbc_const_serial when cached.
+  mrbc_sym sym_id;		//!< constant name. (the irep may be reloaded)
+  mrbc_value *value;		//!< found constant.
+} mrbc_const_cache;
+#endif
+
+
 /***** Function prototypes **************************************************/
 /***** Local variables ******************************************************/
 //! for getting the VM ID
 static uint16_t free_vm_bitmap[MAX_VM_COUNT / 16 + 1];
 
+#if MRBC_METHOD_CACHE_SIZE > 0
+//! inline method cache.
+static mrbc_method_cache method_cache[MRBC_METHOD_CACHE_SIZE];
+static struct MRBC_METHOD_CACHE_STATISTICS method_cache_stat;
+#endif
+
+#if MRBC_IVAR_CACHE_SIZE > 0
+//! instance variable slot cache.
+static mrbc_ivar_cache ivar_cache[MRBC_IVAR_CACHE_SIZE];
+#endif
+
+#if MRBC_CONST_CACHE_SIZE > 0
+//! constant cache.
+static mrbc_const_cache const_cache[MRBC_CONST_CACHE_SIZE];
+#endif
+
+#if defined(MRBC_USE_PROFILER)
+//! opcode names for the profiler.
+static const char * const opcode_name[] = {
+  [OP_NOP] = "NOP",
+  [OP_MOVE] = "MOVE",
+  [OP_LOADL] = "LOADL",
+  [OP_LOADI] = "LOADI",
+  [OP_LOADINEG] = "LOADINEG",
+  [OP_LOADI__1] = "LOADI__1",
+  [OP_LOADI_0] = "LOADI_0",
+  [OP_LOADI_1] = "LOADI_1",
+  [OP_LOADI_2] = "LOADI_2",
+  [OP_LOADI_3] = "LOADI_3",
+  [OP_LOADI_4] = "LOADI_4",
+  [OP_LOADI_5] = "LOADI_5",
+  [OP_LOADI_6] = "LOADI_6",
+  [OP_LOADI_7] = "LOADI_7",
+  [OP_LOADI16] = "LOADI16",
+  [OP_LOADI32] = "LOADI32",
+  [OP_LOADSYM] = "LOADSYM",
+  [OP_LOADNIL] = "LOADNIL",
+  [OP_LOADSELF] = "LOADSELF",
+  [OP_LOADT] = "LOADT",
+  [OP_LOADF] = "LOADF",
+  [OP_GETGV] = "GETGV",
+  [OP_SETGV] = "SETGV",
+  [OP_GETSV] = "GETSV",
+  [OP_SETSV] = "SETSV",
+  [OP_GETIV] = "GETIV",
+  [OP_SETIV] = "SETIV",
+  [OP_GETCV] = "GETCV",
+  [OP_SETCV] = "SETCV",
+  [OP_GETCONST] = "GETCONST",
+  [OP_SETCONST] = "SETCONST",
+  [OP_GETMCNST] = "GETMCNST",
+  [OP_SETMCNST] = "SETMCNST",
+  [OP_GETUPVAR] = "GETUPVAR",
+  [OP_SETUPVAR] = "SETUPVAR",
+  [OP_GETIDX] = "GETIDX",
+  [OP_SETIDX] = "SETIDX",
+  [OP_JMP] = "JMP",
+  [OP_JMPIF] = "JMPIF",
+  [OP_JMPNOT] = "JMPNOT",
+  [OP_JMPNIL] = "JMPNIL",
+  [OP_JMPUW] = "JMPUW",
+  [OP_EXCEPT] = "EXCEPT",
+  [OP_RESCUE] = "RESCUE",
+  [OP_RAISEIF] = "RAISEIF",
+  [OP_SSEND] = "SSEND",
+  [OP_SSENDB] = "SSENDB",
+  [OP_SEND] = "SEND",
+  [OP_SENDB] = "SENDB",
+  [OP_CALL] = "CALL",
+  [OP_SUPER] = "SUPER",
+  [OP_ARGARY] = "ARGARY",
+  [OP_ENTER] = "ENTER",
+  [OP_KEY_P] = "KEY_P",
+  [OP_KEYEND] = "KEYEND",
+  [OP_KARG] = "KARG",
+  [OP_RETURN] = "RETURN",
+  [OP_RETURN_BLK] = "RETURN_BLK",
+  [OP_BREAK] = "BREAK",
+  [OP_BLKPUSH] = "BLKPUSH",
+  [OP_ADD] = "ADD",
+  [OP_ADDI] = "ADDI",
+  [OP_SUB] = "SUB",
+  [OP_SUBI] = "SUBI",
+  [OP_MUL] = "MUL",
+  [OP_DIV] = "DIV",
+  [OP_EQ] = "EQ",
+  [OP_LT] = "LT",
+  [OP_LE] = "LE",
+  [OP_GT] = "GT",
+  [OP_GE] = "GE",
+  [OP_ARRAY] = "ARRAY",
+  [OP_ARRAY2] = "ARRAY2",
+  [OP_ARYCAT] = "ARYCAT",
+  [OP_ARYPUSH] = "ARYPUSH",
+  [OP_ARYDUP] = "ARYDUP",
+  [OP_AREF] = "AREF",
+  [OP_ASET] = "ASET",
+  [OP_APOST] = "APOST",
+  [OP_INTERN] = "INTERN",
+  [OP_SYMBOL] = "SYMBOL",
+  [OP_STRING] = "STRING",
+  [OP_STRCAT] = "STRCAT",
+  [OP_HASH] = "HASH",
+  [OP_HASHADD] = "HASHADD",
+  [OP_HASHCAT] = "HASHCAT",
+  [OP_LAMBDA] = "LAMBDA",
+  [OP_BLOCK] = "BLOCK",
+  [OP_METHOD] = "METHOD",
+  [OP_RANGE_INC] = "RANGE_INC",
+  [OP_RANGE_EXC] = "RANGE_EXC",
+  [OP_OCLASS] = "OCLASS",
+  [OP_CLASS] = "CLASS",
+  [OP_MODULE] = "MODULE",
+  [OP_EXEC] = "EXEC",
+  [OP_DEF] = "DEF",
+  [OP_ALIAS] = "ALIAS",
+  [OP_UNDEF] = "UNDEF",
+  [OP_SCLASS] = "SCLASS",
+  [OP_TCLASS] = "TCLASS",
+  [OP_DEBUG] = "DEBUG",
+  [OP_ERR] = "ERR",
+  [OP_EXT1] = "EXT1",
+  [OP_EXT2] = "EXT2",
+  [OP_EXT3] = "EXT3",
+  [OP_STOP] = "STOP",
+  [OP_X_LOADI_ADD] = "X_LOADI_ADD",
+  [OP_X_MOVE_SEND] = "X_MOVE_SEND",
+  [OP_X_LT_JMPNOT] = "X_LT_JMPNOT",
+  [OP_X_GETIV_SEND] = "X_GETIV_SEND",
+};
+#endif
+
 
 /***** Global variables *****************************************************/
+#if defined(MRBC_COUNT_INSTRUCTIONS)
+//! num of executed instructions. (for benchmark)
+uint64_t mrbc_instruction_count;
+#endif
+#if defined(MRBC_USE_PROFILER)
+//! profiler data.
+struct MRBC_PROFILE mrbc_profile;
+#endif
+
+
 /***** Signal catching functions ********************************************/
 /***** Local functions ******************************************************/
+#if defined(MRBC_COUNT_INSTRUCTIONS) || defined(MRBC_USE_PROFILER)
+//================================================================
+/*! count an executed instruction.
+
+  @param  op	opcode.
+*/
+static inline void count_instruction( int op )
+{
+#if defined(MRBC_COUNT_INSTRUCTIONS)
+  mrbc_instruction_count++;
+#endif
+#if defined(MRBC_USE_PROFILER)
+  if( mrbc_profile.flag_enable ) mrbc_profile.op_count[op]++;
+#endif
+}
+#endif
+
+
+//================================================================
+/*! Release the free list of callinfo
+
+  @param  vm	Pointer to VM
+*/
+static void free_callinfo_list( struct VM *vm )
+{
+  while( vm->callinfo_free ) {
+    mrbc_callinfo *callinfo = vm->callinfo_free;
+    vm->callinfo_free = callinfo->prev;
+    mrbc_free(vm, callinfo);
+  }
+}
+
+
+//================================================================
+/*! find method using inline method cache.
+
+  @param  vm		pointer to VM.
+  @param  r_method	pointer to mrbc_method to return values.
+  @param  cls		receiver's class.
+  @param  sym_id	method name symbol id.
+  @return		pointer to method or NULL.
+*/
+static inline mrbc_method * find_method_cached( struct VM *vm, mrbc_method *r_method, mrbc_class *cls, mrbc_sym sym_id )
+{
+#if MRBC_METHOD_CACHE_SIZE > 0
+  const uint8_t *inst = vm->inst;
+  mrbc_method_cache *mc = &method_cache[ ((uintptr_t)inst ^ ((uintptr_t)inst >> 5)) & (MRBC_METHOD_CACHE_SIZE - 1) ];
+
+  if( mc->inst == inst && mc->cls == cls &&
+      mc->epoch == mrbc_method_epoch && mc->method.sym_id == sym_id ) {
+    method_cache_stat.hit++;
+    *r_method = mc->method;
+    return r_method;
+  }
+
+  method_cache_stat.miss++;
+  if( mrbc_find_method( r_method, cls, sym_id ) == 0 ) return 0;
+
+  mc->inst = inst;
+  mc->cls = cls;
+  mc->epoch = mrbc_method_epoch;
+  mc->method = *r_method;
+  return r_method;
+
+#else
+  return mrbc_find_method( r_method, cls, sym_id );
+#endif
+}
+
+
+//================================================================
+/*! find instance variable slot using the slot cache.
+
+  @param  vm		pointer to VM.
+  @param  ins		pointer to instance.
+  @param  sym_id	instance variable name (without '@') symbol id.
+  @return		index of ins->ivar.data or -1 if not found.
+  @details
+  Instances of the same class usually have the same set of instance
+  variables, so the slot is cached by the access site and the class,
+  and verified by the key.
+*/
+static inline int find_ivar_slot( struct VM *vm, mrbc_instance *ins, mrbc_sym sym_id )
+{
+  mrbc_kv_handle *kvh = &ins->ivar;
+
+#if MRBC_IVAR_CACHE_SIZE > 0
+  const uint8_t *inst = vm->inst;
+  mrbc_ivar_cache *ic = &ivar_cache[ ((uintptr_t)inst ^ ((uintptr_t)inst >> 5)) & (MRBC_IVAR_CACHE_SIZE - 1) ];
+
+  if( ic->inst == inst && ic->cls == ins->cls &&
+      ic->idx < kvh->n_stored && kvh->data[ic->idx].sym_id == sym_id ) {
+    return ic->idx;
+  }
+
+  int idx = mrbc_kv_index( kvh, sym_id );
+  if( idx >= 0 ) {
+    ic->inst = inst;
+    ic->cls = ins->cls;
+    ic->idx = idx;
+  }
+  return idx;
+
+#else
+  return mrbc_kv_index( kvh, sym_id );
+#endif
+}
+
+
+//================================================================
+/*! find constant in the constant cache.
+
+  @param  vm		pointer to VM.
+  @param  cls		class to start the search.
+  @param  sym_id	constant name.
+  @return		pointer to the constant or NULL if not cached.
+*/
+static inline mrbc_value * find_const_cached( struct VM *vm, const mrbc_class *cls, mrbc_sym sym_id )
+{
+#if MRBC_CONST_CACHE_SIZE > 0
+  const uint8_t *inst = vm->inst;
+  mrbc_const_cache *cc = &const_cache[ ((uintptr_t)inst ^ ((uintptr_t)inst >> 5)) & (MRBC_CONST_CACHE_SIZE - 1) ];
+
+  if( cc->inst == inst && cc->cls == cls && cc->sym_id == sym_id &&
+      cc->serial == mrbc_const_serial ) {
+    return cc->value;
+  }
+#endif
+  return 0;
+}
+
+
+//================================================================
+/*! store the constant to the constant cache.
+
+  @param  vm		pointer to VM.
+  @param  cls		class to start the search.
+  @param  sym_id	constant name.
+  @param  value		pointer to the found constant.
+*/
+static inline void set_const_cache( struct VM *vm, const mrbc_class *cls, mrbc_sym sym_id, mrbc_value *value )
+{
+#if MRBC_CONST_CACHE_SIZE > 0
+  const uint8_t *inst = vm->inst;
+  mrbc_const_cache *cc = &const_cache[ ((uintptr_t)inst ^ ((uintptr_t)inst >> 5)) & (MRBC_CONST_CACHE_SIZE - 1) ];
+
+  cc->inst = inst;
+  cc->cls = cls;
+  cc->serial = mrbc_const_serial;
+  cc->sym_id = sym_id;
+  cc->value = value;
+#endif
+}
+
+
+//================================================================
+/*! Expand the argument array packed by splat (*args) into registers.
+
+  @param  recv		pointer to receiver register.
+  @param  karg		num of keyword arguments.
+  @return		num of expanded arguments.
+  @note
+  If nobody else refers the array, its elements are moved to registers
+  without incref/decref, and only the array shell is freed.
+*/
+static int expand_argary( mrbc_value *recv, int karg )
+{
+  mrbc_value argary = recv[1];
+  int n_move = (karg == CALL_MAXARGS) ? 2 : karg * 2 + 1;
+  int narg = mrbc_array_size(&argary);
+
+  if( argary.array->ref_count == 1 ) {
+    argary.array->n_stored = 0;		// move out all elements.
+  } else {
+    for( int i = 0; i < narg; i++ ) {
+      mrbc_incref( &argary.array->data[i] );
+    }
+  }
+
+  memmove( recv + narg + 1, recv + 2, sizeof(mrbc_value) * n_move );
+  memcpy( recv + 1, argary.array->data, sizeof(mrbc_value) * narg );
+  mrbc_decref(&argary);
+
+  return narg;
+}
+
+
+//================================================================
+/*! Convert keyword arguments in registers to a hash.
+
+  @param  vm		pointer to VM.
+  @param  r1		pointer to the last positional argument register.
+  @param  karg		num of keyword arguments.
+  @return		0 if no error.
+*/
+static int pack_kargs( struct VM *vm, mrbc_value *r1, int karg )
+{
+  mrbc_value hval = mrbc_hash_new( vm, karg );
+  if( !hval.hash ) return -1;	// ENOMEM
+
+  memcpy( hval.hash->data, r1+1, sizeof(mrbc_value) * karg * 2 );
+  hval.hash->n_stored = karg * 2;
+
+  r1[1] = hval;
+  r1[2] = r1[karg * 2 + 1];	// Proc
+  memset( r1 + 3, 0, sizeof(mrbc_value) * (karg * 2 - 1) );
+
+  return 0;
+}
+
+
+//================================================================
+/*! Does the Ruby method take keyword arguments in registers?
+
+  True if the method declares keyword parameters and no **dict parameter.
+  Such a method reads them only by OP_KEY_P, OP_KARG and OP_KEYEND,
+  so they need not be a hash.
+*/
+static inline int is_karg_method( const mrbc_irep *irep )
+{
+  const uint8_t *p = irep->inst;
+  if( p[0] != OP_ENTER ) return 0;
+
+  uint32_t a = ((uint32_t)p[1] << 16) | (p[2] << 8) | p[3];
+  return (a & 0x007c) && !(a & 0x0002);	// FLAG_KW and not FLAG_DICT
+}
+
+
 //================================================================
 /*! Method call by method name's id
 
@@ -48,6 +470,10 @@ static uint16_t free_vm_bitmap[MAX_VM_COUNT / 16 + 1];
   @param  sym_id	method name symbol id
   @param  a		operand a
   @param  c		bit: 0-3=narg, 4-7=karg, 8=have block param flag.
+  @note
+  Keyword arguments to a Ruby method that declares them are left in
+  registers as key/value pairs, and OP_ENTER moves them to the stash.
+  For other methods they are converted to a hash.
 */
 static void send_by_name( struct VM *vm, mrbc_sym sym_id, int a, int c )
 {
@@ -58,67 +484,57 @@ static void send_by_name( struct VM *vm, mrbc_sym sym_id, int a, int c )
 
   // If it's packed in an array, expand it.
   if( narg == CALL_MAXARGS ) {
-    mrbc_value argary = recv[1];
-    int n_move = (karg == CALL_MAXARGS) ? 2 : karg * 2 + 1;
+    narg = expand_argary( recv, karg );
+  }
 
-    narg = mrbc_array_size(&argary);
-    for( int i = 0; i < narg; i++ ) {
-      mrbc_incref( &argary.array->data[i] );
+  // find a method
+  mrbc_class *cls = find_class_by_object(recv);
+  mrbc_method method;
+  int flag_method_missing = 0;
+  if( find_method_cached( vm, &method, cls, sym_id ) == 0 ) {
+    // method missing?
+    if( mrbc_find_method( &method, cls, MRBC_SYM(method_missing) ) == 0 ) {
+      mrbc_raisef(vm, MRBC_CLASS(NoMethodError),
+		  "undefined local variable or method '%s' for %s",
+		  mrbc_symid_to_str(sym_id), mrbc_symid_to_str(cls->sym_id));
+      if( vm->callinfo_tail != 0 ) {
+	vm->exception.exception->method_id = vm->callinfo_tail->method_id;
+      }
+      return;
     }
-
-    memmove( recv + narg + 1, recv + 2, sizeof(mrbc_value) * n_move );
-    memcpy( recv + 1, argary.array->data, sizeof(mrbc_value) * narg );
-    mrbc_decref(&argary);
+    flag_method_missing = 1;
   }
 
   mrbc_value *r1 = recv + narg;
+  int n_kargs = 0;
 
-  // Convert keyword argument to hash.
+  // Keyword arguments are passed in registers, or converted to hash.
   if( karg && karg != CALL_MAXARGS ) {
-    mrbc_value hval = mrbc_hash_new( vm, karg );
-    if( !hval.hash ) return;	// ENOMEM
-
-    memcpy( hval.hash->data, r1+1, sizeof(mrbc_value) * karg * 2 );
-    hval.hash->n_stored = karg * 2;
-
-    r1[1] = hval;
-    r1[2] = r1[karg * 2 + 1];	// Proc
-    memset( r1 + 3, 0, sizeof(mrbc_value) * (karg * 2 - 1) );
+    if( !method.c_func && !flag_method_missing &&
+	is_karg_method( method.irep ) ) {
+      n_kargs = karg;
+    } else {
+      if( pack_kargs( vm, r1, karg ) != 0 ) return;	// ENOMEM
+    }
   }
 
   // is not have block
   if( !have_block ) {
-    r1 += (!!karg + 1);
+    r1 += n_kargs ? (n_kargs * 2 + 1) : (!!karg + 1);
     mrbc_decref( r1 );
     mrbc_set_nil( r1 );
   }
 
-  // find a method
-  mrbc_class *cls = find_class_by_object(recv);
-  mrbc_method method;
-  if( mrbc_find_method( &method, cls, sym_id ) != 0 ) goto CALL_METHOD;
-
-  // method missing?
-  if( mrbc_find_method( &method, cls, MRBC_SYM(method_missing) ) == 0 ) {
-    mrbc_raisef(vm, MRBC_CLASS(NoMethodError),
-		"undefined local variable or method '%s' for %s",
-		mrbc_symid_to_str(sym_id), mrbc_symid_to_str(cls->sym_id));
-    if( vm->callinfo_tail != 0 ) {
-      vm->exception.exception->method_id = vm->callinfo_tail->method_id;
+  if( flag_method_missing ) {
+    // prepare to call 'method_missing' method.
+    for( int i = narg+1; i != 0; i-- ) {	// shift arguments
+      recv[i+1] = recv[i];
     }
-    return;
-  }
-
-  // prepare to call 'method_missing' method.
-  for( int i = narg+1; i != 0; i-- ) {	// shift arguments
-    recv[i+1] = recv[i];
+    recv[1] = mrbc_symbol_value(sym_id);
+    sym_id = MRBC_SYM(method_missing);
+    narg++;
   }
-  recv[1] = mrbc_symbol_value(sym_id);
-  sym_id = MRBC_SYM(method_missing);
-  narg++;
 
-
- CALL_METHOD:
   if( !method.c_func ) goto CALL_RUBY_METHOD;
 
   method.func(vm, recv, narg);
@@ -138,6 +554,7 @@ static void send_by_name( struct VM *vm, mrbc_sym sym_id, int a, int c )
  CALL_RUBY_METHOD:;
   mrbc_callinfo *callinfo = mrbc_push_callinfo(vm, sym_id, a, narg);
   callinfo->own_class = method.cls;
+  callinfo->n_kargs = n_kargs;
 
   vm->cur_irep = method.irep;
   vm->inst = vm->cur_irep->inst;
@@ -145,6 +562,24 @@ static void send_by_name( struct VM *vm, mrbc_sym sym_id, int a, int c )
 }
 
 
+//================================================================
+/*! Find a keyword argument in the stash.
+
+  @param  callinfo	callinfo of the method.
+  @param  sym_id	keyword.
+  @return		index of the pair, or -1 if not found.
+*/
+static int find_karg( const mrbc_callinfo *callinfo, mrbc_sym sym_id )
+{
+  // search from the end, because the last one wins as Hash.
+  for( int i = callinfo->n_kargs - 1; i >= 0; i-- ) {
+    const mrbc_value *key = &callinfo->kargs[i*2];
+    if( key->tt == MRBC_TT_SYMBOL && key->sym_id == sym_id ) return i;
+  }
+  return -1;
+}
+
+
 //================================================================
 /*! Find ensure catch handler
 */
@@ -180,9 +615,183 @@ static const mrbc_irep_catch_handler *find_catch_handler_ensure( const struct VM
 void mrbc_cleanup_vm(void)
 {
   memset(free_vm_bitmap, 0, sizeof(free_vm_bitmap));
+#if MRBC_METHOD_CACHE_SIZE > 0
+  memset(method_cache, 0, sizeof(method_cache));
+  memset(&method_cache_stat, 0, sizeof(method_cache_stat));
+#endif
+#if MRBC_IVAR_CACHE_SIZE > 0
+  memset(ivar_cache, 0, sizeof(ivar_cache));
+#endif
+#if MRBC_CONST_CACHE_SIZE > 0
+  memset(const_cache, 0, sizeof(const_cache));
+#endif
+}
+
+
+//================================================================
+/*! get the inline method cache statistics
+
+  @param  ret	pointer to return value.
+*/
+void mrbc_method_cache_statistics( struct MRBC_METHOD_CACHE_STATISTICS *ret )
+{
+#if MRBC_METHOD_CACHE_SIZE > 0
+  *ret = method_cache_stat;
+#else
+  ret->hit = ret->miss = 0;
+#endif
+}
+
+
+//================================================================
+/*! clear the inline method cache statistics
+*/
+void mrbc_method_cache_clear_statistics( void )
+{
+#if MRBC_METHOD_CACHE_SIZE > 0
+  memset(&method_cache_stat, 0, sizeof(method_cache_stat));
+#endif
+}
+
+
+#if defined(MRBC_USE_PROFILER)
+//================================================================
+/*! start profiling. (clear the data)
+*/
+void mrbc_profile_start( void )
+{
+  hal_disable_irq();
+  memset(&mrbc_profile, 0, sizeof(mrbc_profile));
+  mrbc_profile.flag_enable = 1;
+  hal_enable_irq();
+}
+
+
+//================================================================
+/*! stop profiling. (keep the data)
+*/
+void mrbc_profile_stop( void )
+{
+  mrbc_profile.flag_enable = 0;
+}
+
+
+//================================================================
+/*! sample the running method.
+
+  This is called from the tick timer (mrbc_tick) for the running task.
+
+  @param  vm	Pointer to VM.
+*/
+void mrbc_profile_sample( const struct VM *vm )
+{
+  if( !mrbc_profile.flag_enable ) return;
+
+  const mrbc_callinfo *callinfo = vm->callinfo_tail;
+  const mrbc_class *cls = callinfo ? callinfo->own_class : 0;
+  mrbc_sym method_id = callinfo ? callinfo->method_id : 0;
+
+  for( int i = 0; i < MRBC_PROFILE_METHOD_COUNT; i++ ) {
+    struct MRBC_PROFILE_METHOD *m = &mrbc_profile.method[i];
+
+    if( m->ticks == 0 ) {
+      m->cls = cls;
+      m->method_id = method_id;
+    } else if( m->cls != cls || m->method_id != method_id ) {
+      continue;
+    }
+    m->ticks++;
+    return;
+  }
+
+  mrbc_profile.ticks_other++;
 }
 
 
+//================================================================
+/*! get opcode name.
+
+  @param  op	opcode.
+  @return	name string or NULL.
+*/
+const char *mrbc_profile_opcode_name( int op )
+{
+  if( op < 0 || op >= sizeof(opcode_name)/sizeof(opcode_name[0]) ) return 0;
+  return opcode_name[op];
+}
+
+
+//================================================================
+/*! get method name such as "Class#method".
+
+  @param  m		profile entry.
+  @param  buf		output buffer.
+  @param  bufsiz	buffer size.
+*/
+void mrbc_profile_method_name( const struct MRBC_PROFILE_METHOD *m, char *buf, int bufsiz )
+{
+  if( m->method_id == 0 ) {
+    mrbc_snprintf( buf, bufsiz, "<top>" );
+  } else if( m->cls == 0 ) {
+    mrbc_snprintf( buf, bufsiz, "%s", mrbc_symid_to_str(m->method_id) );
+  } else {
+    mrbc_snprintf( buf, bufsiz, "%s#%s", mrbc_symid_to_str(m->cls->sym_id),
+		   mrbc_symid_to_str(m->method_id) );
+  }
+}
+
+
+//================================================================
+/*! print the profile.
+
+  (examples)
+  mrbc_define_method(0, 0, "print_profile", (mrbc_func_t)mrbc_profile_print_statistics);
+*/
+void mrbc_profile_print_statistics( void )
+{
+  // sort the methods by ticks.
+  uint8_t idx[MRBC_PROFILE_METHOD_COUNT];
+  int n = 0;
+  uint32_t total = mrbc_profile.ticks_other;
+
+  for( int i = 0; i < MRBC_PROFILE_METHOD_COUNT; i++ ) {
+    uint32_t ticks = mrbc_profile.method[i].ticks;
+    if( ticks == 0 ) break;
+    total += ticks;
+
+    int j;
+    for( j = n; j > 0 && mrbc_profile.method[idx[j-1]].ticks < ticks; j-- ) {
+      idx[j] = idx[j-1];
+    }
+    idx[j] = i;
+    n++;
+  }
+
+  mrbc_printf("== PROFILE ==\n");
+  mrbc_printf(" ticks:%u (%u ms/tick)\n", total, MRBC_TICK_UNIT);
+  for( int i = 0; i < n; i++ ) {
+    char name[40];
+    mrbc_profile_method_name( &mrbc_profile.method[idx[i]], name, sizeof(name) );
+    mrbc_printf(" %8u %s\n", mrbc_profile.method[idx[i]].ticks, name);
+  }
+  if( mrbc_profile.ticks_other ) {
+    mrbc_printf(" %8u (others)\n", mrbc_profile.ticks_other);
+  }
+
+  mrbc_printf(" opcode:\n");
+  for( int i = 0; i < 256; i++ ) {
+    if( mrbc_profile.op_count[i] == 0 ) continue;
+    const char *name = mrbc_profile_opcode_name(i);
+    if( name ) {
+      mrbc_printf(" %10u OP_%s\n", mrbc_profile.op_count[i], name);
+    } else {
+      mrbc_printf(" %10u 0x%02x\n", mrbc_profile.op_count[i], i);
+    }
+  }
+}
+#endif
+
+
 //================================================================
 /*! get callee symbol id
 
@@ -215,11 +824,19 @@ const char *mrbc_get_callee_name( struct VM *vm )
 
 //================================================================
 /*! Push current status to callinfo stack
+
+  CALLINFO is taken from the free list of the VM, and allocated only
+  when the call is deeper than ever.
 */
 mrbc_callinfo * mrbc_push_callinfo( struct VM *vm, mrbc_sym method_id, int reg_offset, int n_args )
 {
-  mrbc_callinfo *callinfo = mrbc_alloc(vm, sizeof(mrbc_callinfo));
-  if( !callinfo ) return callinfo;
+  mrbc_callinfo *callinfo = vm->callinfo_free;
+  if( callinfo ) {
+    vm->callinfo_free = callinfo->prev;
+  } else {
+    callinfo = mrbc_alloc(vm, sizeof(mrbc_callinfo));
+    if( !callinfo ) return callinfo;
+  }
 
   callinfo->cur_irep = vm->cur_irep;
   callinfo->inst = vm->inst;
@@ -228,14 +845,28 @@ mrbc_callinfo * mrbc_push_callinfo( struct VM *vm, mrbc_sym method_id, int reg_o
 
   callinfo->own_class = 0;
   callinfo->karg_keep = 0;
+  callinfo->kargs = 0;
   callinfo->method_id = method_id;
   callinfo->reg_offset = reg_offset;
   callinfo->n_args = n_args;
   callinfo->is_called_super = 0;
+  callinfo->n_kargs = 0;
+  callinfo->iter_offset = 0;
+  callinfo->iter = 0;
+
+  // the keyword argument stash must stay above this. (see op_enter)
+  callinfo->regs_end = vm->cur_regs + vm->cur_irep->nregs;
+  if( vm->callinfo_tail && vm->callinfo_tail->regs_end > callinfo->regs_end ) {
+    callinfo->regs_end = vm->callinfo_tail->regs_end;
+  }
 
   callinfo->prev = vm->callinfo_tail;
   vm->callinfo_tail = callinfo;
 
+  if( ++vm->callinfo_depth > vm->callinfo_max_depth ) {
+    vm->callinfo_max_depth = vm->callinfo_depth;
+  }
+
   return callinfo;
 }
 
@@ -255,18 +886,154 @@ void mrbc_pop_callinfo( struct VM *vm )
     mrbc_decref_empty( r0+i );
   }
 
+  // native iterator block, also clear the work registers of the iterator.
+  if( callinfo->iter ) {
+    for( mrbc_value *p = r0 - callinfo->iter_offset + 1; p <= r0 + 2; p++ ) {
+      mrbc_decref_empty( p );
+    }
+  }
+
   if( callinfo->karg_keep ) {
     mrbc_hash_delete( &(mrbc_value){.tt = MRBC_TT_HASH, .hash = callinfo->karg_keep} );
   }
 
+  // release the keyword argument stash.
+  if( callinfo->kargs ) {
+    for( int i = 0; i < callinfo->n_kargs * 2; i++ ) {
+      mrbc_decref_empty( callinfo->kargs + i );
+    }
+    vm->karg_stack = callinfo->kargs + callinfo->n_kargs * 2;
+  }
+
   // copy callinfo to vm
   vm->cur_irep = callinfo->cur_irep;
   vm->inst = callinfo->inst;
   vm->cur_regs = callinfo->cur_regs;
   vm->target_class = callinfo->target_class;
   vm->callinfo_tail = callinfo->prev;
+  vm->callinfo_depth--;
 
-  mrbc_free(vm, callinfo);
+  // keep it for the next call.
+  callinfo->prev = vm->callinfo_free;
+  vm->callinfo_free = callinfo;
+}
+
+
+//================================================================
+/*! Start a native block iteration.
+
+  The C method that takes a block calls this, instead of looping over
+  mrbc_send or a Ruby method. The block frame is set up once, and each
+  time the block returns, step() sets the arguments of the next call or
+  finishes. So break, next and exceptions in the block work as usual.
+
+  Registers used after the block argument (proc):
+    proc (copy), work[0], work[1], block frame...
+
+  @param  vm	pointer to VM.
+  @param  v	register top of the C method.
+  @param  argc	num of arguments.
+  @param  step	step function.
+  @param  w0	initial value of work[0]. (move)
+  @param  w1	initial value of work[1]. (move)
+  @retval 0	the iteration was started or finished.
+  @retval -1	not started, and an exception is raised.
+*/
+int mrbc_iter_start( struct VM *vm, mrbc_value v[], int argc, mrbc_iter_func step, mrbc_value w0, mrbc_value w1 )
+{
+  int ofs = argc + 1 + (v[argc+1].tt == MRBC_TT_HASH);
+  if( v[ofs].tt != MRBC_TT_PROC ) {
+    mrbc_decref( &w0 );
+    mrbc_decref( &w1 );
+    mrbc_raise( vm, MRBC_CLASS(ArgumentError), "no block given");
+    return -1;
+  }
+
+  mrbc_value *proc = v + ofs + 1;
+  mrbc_value *work = proc + 1;
+  mrbc_value *blk = work + 2;
+  const mrbc_irep *irep = v[ofs].proc->irep;
+  int nregs = irep->nregs < 3 ? 3 : irep->nregs;
+
+  if( blk + nregs >= vm->karg_stack ) {
+    mrbc_decref( &w0 );
+    mrbc_decref( &w1 );
+    mrbc_raise( vm, MRBC_CLASS(Exception), "MAX_REGS_SIZE overflow");
+    return -1;
+  }
+
+  for( mrbc_value *p = proc; p <= blk + 2; p++ ) {
+    mrbc_decref_empty( p );
+  }
+  *proc = v[ofs];
+  mrbc_incref( proc );
+  work[0] = w0;
+  work[1] = w1;
+  blk[0] = mrbc_nil_value();
+
+  int n_args = step( vm, v, work, blk );
+  if( n_args < 0 ) goto DONE;
+
+  mrbc_callinfo *callinfo_self = proc->proc->callinfo_self;
+  mrbc_callinfo *callinfo = mrbc_push_callinfo(vm,
+				(callinfo_self ? callinfo_self->method_id : 0),
+				blk - vm->cur_regs, n_args);
+  if( !callinfo ) goto DONE;	// ENOMEM
+
+  if( callinfo_self ) {
+    callinfo->own_class = callinfo_self->own_class;
+  }
+  callinfo->iter_offset = blk - v;
+  callinfo->iter = step;
+
+  blk[0] = *proc;
+  mrbc_incref( proc );
+
+  vm->cur_irep = irep;
+  vm->inst = irep->inst;
+  vm->cur_regs = blk;
+  return 0;
+
+ DONE:
+  for( mrbc_value *p = proc; p <= blk + 2; p++ ) {
+    mrbc_decref_empty( p );
+  }
+  return 0;
+}
+
+
+//================================================================
+/*! Go to the next step of the native block iteration.
+
+  The block has returned, and its value is in cur_regs[0].
+*/
+static void iter_continue( struct VM *vm )
+{
+  mrbc_callinfo *callinfo = vm->callinfo_tail;
+  mrbc_value *blk = vm->cur_regs;
+  mrbc_value *recv = blk - callinfo->iter_offset;
+
+  // clear used register, as mrbc_pop_callinfo() and call it again.
+  int nregs = vm->cur_irep->nregs < 3 ? 3 : vm->cur_irep->nregs;
+  for( int i = 1; i < nregs; i++ ) {
+    mrbc_decref_empty( blk+i );
+  }
+  if( callinfo->karg_keep ) {
+    mrbc_hash_delete( &(mrbc_value){.tt = MRBC_TT_HASH, .hash = callinfo->karg_keep} );
+    callinfo->karg_keep = 0;
+  }
+
+  int n_args = callinfo->iter( vm, recv, blk - 2, blk );
+  mrbc_decref_empty( blk );
+  if( n_args < 0 ) {
+    mrbc_pop_callinfo( vm );
+    return;
+  }
+
+  blk[0] = blk[-3];		// proc (copy)
+  mrbc_incref( blk );
+  callinfo->n_args = n_args;
+  vm->inst = vm->cur_irep->inst;
 }
 
 
@@ -352,7 +1119,9 @@ void mrbc_vm_begin( struct VM *vm )
   vm->cur_regs = vm->regs;
   vm->target_class = MRBC_CLASS(Object);
   vm->callinfo_tail = NULL;
+  vm->callinfo_depth = 0;
   vm->ret_blk = NULL;
+  vm->karg_stack = vm->regs + vm->regs_size;
   vm->exception = mrbc_nil_value();
   vm->flag_preemption = 0;
   vm->flag_stop = 0;
@@ -394,8 +1163,12 @@ void mrbc_vm_end( struct VM *vm )
 #if defined(MRBC_DEBUG_REGS)
   mrbc_printf("Finally number of registers used was %d in VM %d.\n",
 	      n_used, vm->vm_id );
+  mrbc_printf("Maximum depth of callinfo was %d in VM %d.\n",
+	      vm->callinfo_max_depth, vm->vm_id );
 #endif
 
+  free_callinfo_list( vm );
+
 #if defined(MRBC_ALLOC_VMID)
   mrbc_global_clear_vm_id();
   mrbc_free_all(vm);
@@ -411,6 +1184,7 @@ void mrbc_vm_end( struct VM *vm )
 void mrbc_vm_close( struct VM *vm )
 {
   mrbc_decref( &vm->regs[0] );
+  free_callinfo_list( vm );
 
   // free vm id.
   if( vm->vm_id != 0 ) {
@@ -421,6 +1195,7 @@ void mrbc_vm_close( struct VM *vm )
 
   // free irep and vm
   if( vm->top_irep ) mrbc_irep_free( vm->top_irep );
+  mrbc_method_cache_invalidate();
   if( vm->flag_need_memfree ) mrbc_raw_free(vm);
 }
 
@@ -660,20 +1435,23 @@ static inline void op_getiv( mrbc_vm *vm, mrbc_value *regs EXT )
 {
   FETCH_BB();
 
-  const char *sym_name = mrbc_irep_symbol_cstr(vm->cur_irep, b);
-  mrbc_sym sym_id = mrbc_str_to_symid(sym_name+1);   // skip '@'
-  if( sym_id < 0 ) {
-    mrbc_raise(vm, MRBC_CLASS(Exception), "Overflow MAX_SYMBOLS_COUNT");
-    return;
-  }
   mrbc_value *self = mrbc_get_self( vm, regs );
   if( self->tt != MRBC_TT_OBJECT ) {
     mrbc_raise(vm, MRBC_CLASS(NotImplementedError), 0);
     return;
   }
 
+  assert( vm->cur_irep->ofs_ivars );
+  mrbc_sym sym_id = mrbc_irep_ivar_id(vm->cur_irep, b);
+  int idx = find_ivar_slot( vm, self->instance, sym_id );
+
   mrbc_decref(&regs[a]);
-  regs[a] = mrbc_instance_getiv(self, sym_id);
+  if( idx < 0 ) {
+    mrbc_set_nil(&regs[a]);
+  } else {
+    regs[a] = self->instance->ivar.data[idx].value;
+    mrbc_incref(&regs[a]);
+  }
 }
 
 
@@ -686,19 +1464,24 @@ static inline void op_setiv( mrbc_vm *vm, mrbc_value *regs EXT )
 {
   FETCH_BB();
 
-  const char *sym_name = mrbc_irep_symbol_cstr(vm->cur_irep, b);
-  mrbc_sym sym_id = mrbc_str_to_symid(sym_name+1);   // skip '@'
-  if( sym_id < 0 ) {
-    mrbc_raise(vm, MRBC_CLASS(Exception), "Overflow MAX_SYMBOLS_COUNT");
-    return;
-  }
   mrbc_value *self = mrbc_get_self( vm, regs );
   if( self->tt != MRBC_TT_OBJECT ) {
     mrbc_raise(vm, MRBC_CLASS(NotImplementedError), 0);
     return;
   }
 
-  mrbc_instance_setiv(self, sym_id, &regs[a]);
+  assert( vm->cur_irep->ofs_ivars );
+  mrbc_sym sym_id = mrbc_irep_ivar_id(vm->cur_irep, b);
+  int idx = find_ivar_slot( vm, self->instance, sym_id );
+
+  if( idx < 0 ) {
+    mrbc_instance_setiv(self, sym_id, &regs[a]);
+  } else {
+    mrbc_value *v = &self->instance->ivar.data[idx].value;
+    mrbc_incref(&regs[a]);
+    mrbc_decref(v);
+    *v = regs[a];
+  }
 }
 
 
@@ -721,11 +1504,14 @@ static inline void op_getconst( mrbc_vm *vm, mrbc_value *regs EXT )
     crit_cls = find_class_by_object( mrbc_get_self(vm, regs) );
   }
 
+  ret = find_const_cached( vm, crit_cls, sym_id );
+  if( ret ) goto DONE;
+
   // search in my class, then search nested outer class.
   mrbc_class *cls = crit_cls;
   while( 1 ) {
     ret = mrbc_get_class_const(cls, sym_id);
-    if( ret ) goto DONE;
+    if( ret ) goto FOUND;
     if( !mrbc_is_nested_symid(cls->sym_id) ) break;
 
     mrbc_sym outer_id;
@@ -737,7 +1523,7 @@ static inline void op_getconst( mrbc_vm *vm, mrbc_value *regs EXT )
   cls = crit_cls->super;
   while( cls ) {
     ret = mrbc_get_class_const(cls, sym_id);
-    if( ret ) goto DONE;
+    if( ret ) goto FOUND;
     cls = cls->super;
   }
 
@@ -749,6 +1535,9 @@ static inline void op_getconst( mrbc_vm *vm, mrbc_value *regs EXT )
     return;
   }
 
+ FOUND:
+  set_const_cache( vm, crit_cls, sym_id, ret );
+
  DONE:
   mrbc_incref(ret);
   mrbc_decref(&regs[a]);
@@ -789,6 +1578,9 @@ static inline void op_getmcnst( mrbc_vm *vm, mrbc_value *regs EXT )
   mrbc_class *cls = regs[a].cls;
   mrbc_value *ret;
 
+  ret = find_const_cached( vm, regs[a].cls, sym_id );
+  if( ret ) goto DONE;
+
   // ::CONST case
   if( cls->sym_id == MRBC_SYM(Object) ) {
     ret = mrbc_get_const(sym_id);
@@ -797,7 +1589,7 @@ static inline void op_getmcnst( mrbc_vm *vm, mrbc_value *regs EXT )
                    "", mrbc_symid_to_str( sym_id ));
       return;
     }
-    goto DONE;
+    goto FOUND;
   }
 
   while( !(ret = mrbc_get_class_const(cls, sym_id)) ) {
@@ -809,6 +1601,9 @@ static inline void op_getmcnst( mrbc_vm *vm, mrbc_value *regs EXT )
     }
   }
 
+ FOUND:
+  set_const_cache( vm, regs[a].cls, sym_id, ret );
+
  DONE:
   mrbc_incref(ret);
   mrbc_decref(&regs[a]);
@@ -1076,7 +1871,11 @@ CASE_OP_RETURN:
   regs[0] = regs[ vm->cur_irep->nregs ];
   regs[ vm->cur_irep->nregs ].tt = MRBC_TT_EMPTY;
 
-  mrbc_pop_callinfo(vm);
+  if( vm->callinfo_tail->iter ) {
+    iter_continue(vm);
+  } else {
+    mrbc_pop_callinfo(vm);
+  }
   return;
 }
 
@@ -1138,7 +1937,7 @@ CASE_OP_BREAK: {
       return;
     }
 
-    reg_offset = vm->callinfo_tail->reg_offset;
+    reg_offset = vm->callinfo_tail->reg_offset - vm->callinfo_tail->iter_offset;
     mrbc_pop_callinfo(vm);
   }
 
@@ -1278,31 +2077,12 @@ static inline void op_super( mrbc_vm *vm, mrbc_value *regs EXT )
 	 b = 255 in other method.
     */
 
-    mrbc_value argary = recv[1];
-    int n_move = (karg == CALL_MAXARGS) ? 2 : karg * 2 + 1;
-    narg = mrbc_array_size(&argary);
-    for( int i = 0; i < narg; i++ ) {
-      mrbc_incref( &argary.array->data[i] );
-    }
-
-    memmove( recv + narg + 1, recv + 2, sizeof(mrbc_value) * n_move );
-    memcpy( recv + 1, argary.array->data, sizeof(mrbc_value) * narg );
-    mrbc_decref(&argary);
+    narg = expand_argary( recv, karg );
   }
 
-  mrbc_value *r1 = recv + narg;
-
   // Convert keyword argument to hash.
   if( karg && karg != CALL_MAXARGS ) {
-    mrbc_value hval = mrbc_hash_new( vm, karg );
-    if( !hval.hash ) return;	// ENOMEM
-
-    memcpy( hval.hash->data, r1+1, sizeof(mrbc_value) * karg * 2 );
-    hval.hash->n_stored = karg * 2;
-
-    r1[1] = hval;
-    r1[2] = r1[karg * 2 + 1];	// Proc
-    memset( r1 + 3, 0, sizeof(mrbc_value) * (karg * 2 - 1) );
+    if( pack_kargs( vm, recv + narg, karg ) != 0 ) return;	// ENOMEM
   }
 
   // find super class
@@ -1397,9 +2177,19 @@ static inline void op_argary( mrbc_vm *vm, mrbc_value *regs EXT )
 
   if( d ) {
     if( !callinfo ) callinfo = vm->callinfo_tail;
-    assert( callinfo->karg_keep );
-    mrbc_value karg = (mrbc_value){.tt = MRBC_TT_HASH, .hash = callinfo->karg_keep};
-    karg = mrbc_hash_dup(vm, &karg);
+    mrbc_value karg;
+    if( callinfo->kargs ) {
+      karg = mrbc_hash_new( vm, callinfo->n_kargs );
+      if( !karg.hash ) return;	// ENOMEM
+      for( int i = 0; i < callinfo->n_kargs * 2; i += 2 ) {
+	mrbc_incref( &callinfo->kargs[i+1] );
+	mrbc_hash_set( &karg, &callinfo->kargs[i], &callinfo->kargs[i+1] );
+      }
+    } else {
+      assert( callinfo->karg_keep );
+      karg = (mrbc_value){.tt = MRBC_TT_HASH, .hash = callinfo->karg_keep};
+      karg = mrbc_hash_dup(vm, &karg);
+    }
     mrbc_array_push( &argary, &karg );
   }
 
@@ -1431,8 +2221,20 @@ static inline void op_enter( mrbc_vm *vm, mrbc_value *regs EXT )
   FETCH_W();
 
   // Check the number of registers to use.
-  int reg_use_max = regs - vm->regs + vm->cur_irep->nregs;
-  if( reg_use_max >= vm->regs_size ) {
+  mrbc_callinfo *callinfo = vm->callinfo_tail;
+  int n_kargs = callinfo->n_kargs;
+  int reg_use_max = vm->cur_irep->nregs;
+  mrbc_value *reg_end = regs;
+  if( n_kargs ) {	// the stash must not overlap the arguments.
+    if( reg_use_max < callinfo->n_args + n_kargs * 2 + 2 ) {
+      reg_use_max = callinfo->n_args + n_kargs * 2 + 2;
+    }
+    reg_use_max += n_kargs * 2;
+
+    // nor the registers of any caller.
+    reg_end = callinfo->regs_end + n_kargs * 2;
+  }
+  if( regs + reg_use_max >= vm->karg_stack || reg_end > vm->karg_stack ) {
     mrbc_raise( vm, MRBC_CLASS(Exception), "MAX_REGS_SIZE overflow");
     return;
   }
@@ -1445,9 +2247,26 @@ static inline void op_enter( mrbc_vm *vm, mrbc_value *regs EXT )
 
   int m1 = (a >> 18) & 0x1f;	// num of required parameters 1
   int o  = (a >> 13) & 0x1f;	// num of optional parameters
-  int argc = vm->callinfo_tail->n_args;
-  int flag_kwarg = regs[argc+1].tt == MRBC_TT_HASH;
+  int argc = callinfo->n_args;
 
+  // move keyword arguments in registers to the stash.
+  if( n_kargs ) {
+    mrbc_value *kargs = vm->karg_stack - n_kargs * 2;
+    for( int i = 0; i < n_kargs * 2; i++ ) {
+      mrbc_decref( &kargs[i] );
+    }
+    memcpy( kargs, regs + argc + 1, sizeof(mrbc_value) * n_kargs * 2 );
+    regs[argc+1] = regs[argc + n_kargs * 2 + 1];	// Proc
+    for( int i = 2; i <= n_kargs * 2 + 1; i++ ) {
+      regs[argc+i].tt = MRBC_TT_EMPTY;
+    }
+
+    callinfo->kargs = kargs;
+    callinfo->karg_used = 0;
+    vm->karg_stack = kargs;
+  }
+
+  int flag_kwarg = !n_kargs && regs[argc+1].tt == MRBC_TT_HASH;
   argc += flag_kwarg;
 
   if( argc < m1 && regs[0].tt != MRBC_TT_PROC ) {
@@ -1484,9 +2303,15 @@ static inline void op_enter( mrbc_vm *vm, mrbc_value *regs EXT )
   if( a & (FLAG_DICT|FLAG_KW|FLAG_REST) ) {
     mrbc_value dict;
     if( a & (FLAG_DICT|FLAG_KW) ) {
-      if( (argc - m1) > 0 && regs[argc].tt == MRBC_TT_HASH ) {
+      if( callinfo->kargs ) {
+	dict = mrbc_nil_value();
+      } else if( (argc - m1) > 0 && regs[argc].tt == MRBC_TT_HASH ) {
 	dict = regs[argc];
 	regs[argc--].tt = MRBC_TT_EMPTY;
+      } else if( !(a & FLAG_DICT) ) {
+	// no keyword arguments given. use the empty stash.
+	dict = mrbc_nil_value();
+	callinfo->kargs = vm->karg_stack;
       } else {
 	dict = mrbc_hash_new( vm, 0 );
       }
@@ -1519,11 +2344,13 @@ static inline void op_enter( mrbc_vm *vm, mrbc_value *regs EXT )
     if( a & (FLAG_DICT|FLAG_KW) ) {
       mrbc_decref(&regs[++i]);
       regs[i] = dict;
-      vm->callinfo_tail->karg_keep = mrbc_hash_dup(vm, &dict).hash;
+      if( !callinfo->kargs ) {
+	callinfo->karg_keep = mrbc_hash_dup(vm, &dict).hash;
+      }
     }
     mrbc_decref(&regs[i+1]);
     regs[i+1] = proc;
-    vm->callinfo_tail->n_args = i;
+    callinfo->n_args = i;
 
   } else {
     // reorder arguments.
@@ -1534,7 +2361,7 @@ static inline void op_enter( mrbc_vm *vm, mrbc_value *regs EXT )
     int i = m1 + o;
     mrbc_decref(&regs[i+1]);
     regs[i+1] = proc;
-    vm->callinfo_tail->n_args = i;
+    callinfo->n_args = i;
   }
 
   // prepare for get default arguments.
@@ -1568,12 +2395,19 @@ static inline void op_key_p( mrbc_vm *vm, mrbc_value *regs EXT )
 {
   FETCH_BB();
 
-  mrbc_value *kdict = &regs[vm->callinfo_tail->n_args];
+  mrbc_callinfo *callinfo = vm->callinfo_tail;
   mrbc_sym sym_id = mrbc_irep_symbol_id( vm->cur_irep, b );
-  mrbc_value *v = mrbc_hash_search_by_id( kdict, sym_id );
+  int flag;
+
+  if( callinfo->kargs ) {
+    flag = find_karg( callinfo, sym_id ) >= 0;
+  } else {
+    mrbc_value *kdict = &regs[callinfo->n_args];
+    flag = mrbc_hash_search_by_id( kdict, sym_id ) != NULL;
+  }
 
   mrbc_decref(&regs[a]);
-  mrbc_set_bool(&regs[a], v);
+  mrbc_set_bool(&regs[a], flag);
 }
 
 
@@ -1586,7 +2420,20 @@ static inline void op_keyend( mrbc_vm *vm, mrbc_value *regs EXT )
 {
   FETCH_Z();
 
-  mrbc_value *kdict = &regs[vm->callinfo_tail->n_args];
+  mrbc_callinfo *callinfo = vm->callinfo_tail;
+
+  if( callinfo->kargs ) {
+    for( int i = 0; i < callinfo->n_kargs; i++ ) {
+      if( callinfo->karg_used & (1 << i) ) continue;
+      const mrbc_value *key = &callinfo->kargs[i*2];
+      mrbc_raisef(vm, MRBC_CLASS(ArgumentError), "unknown keyword: %s",
+		  key->tt == MRBC_TT_SYMBOL ? mrbc_symid_to_str(key->sym_id) : "?");
+      return;
+    }
+    return;
+  }
+
+  mrbc_value *kdict = &regs[callinfo->n_args];
 
   if( mrbc_hash_size(kdict) != 0 ) {
     mrbc_hash_iterator ite = mrbc_hash_iterator_new(kdict);
@@ -1607,9 +2454,29 @@ static inline void op_karg( mrbc_vm *vm, mrbc_value *regs EXT )
 {
   FETCH_BB();
 
-  mrbc_value *kdict = &regs[vm->callinfo_tail->n_args];
+  mrbc_callinfo *callinfo = vm->callinfo_tail;
   mrbc_sym sym_id = mrbc_irep_symbol_id( vm->cur_irep, b );
-  mrbc_value v = mrbc_hash_remove_by_id( kdict, sym_id );
+  mrbc_value v;
+
+  if( callinfo->kargs ) {
+    // take it from the stash. it is kept for OP_ARGARY.
+    int i = find_karg( callinfo, sym_id );
+    if( i >= 0 ) {
+      v = callinfo->kargs[i*2+1];
+      mrbc_incref(&v);
+      for( ; i >= 0; i-- ) {	// mark also the duplicated keys.
+	const mrbc_value *key = &callinfo->kargs[i*2];
+	if( key->tt == MRBC_TT_SYMBOL && key->sym_id == sym_id ) {
+	  callinfo->karg_used |= (1 << i);
+	}
+      }
+    } else {
+      v.tt = MRBC_TT_EMPTY;
+    }
+  } else {
+    mrbc_value *kdict = &regs[callinfo->n_args];
+    v = mrbc_hash_remove_by_id( kdict, sym_id );
+  }
 
   if( v.tt == MRBC_TT_EMPTY ) {
     mrbc_raisef(vm, MRBC_CLASS(ArgumentError), "missing keywords: %s",
@@ -1657,6 +2524,15 @@ static inline void op_return__sub( mrbc_vm *vm, mrbc_value *regs, int a )
     return;
   }
 
+  // native iterator block, pass the value to the next step.
+  if( vm->callinfo_tail->iter ) {
+    mrbc_decref(&regs[0]);
+    regs[0] = regs[a];
+    regs[a].tt = MRBC_TT_EMPTY;
+    iter_continue(vm);
+    return;
+  }
+
   // not in initialize method, set return value.
   if( vm->callinfo_tail->method_id != MRBC_SYM(initialize) ) goto SET_RETURN;
 
@@ -1773,7 +2649,7 @@ static inline void op_break( mrbc_vm *vm, mrbc_value *regs EXT )
     // Is it the origin (generator) of proc?
     if( vm->callinfo_tail == vm->ret_blk->callinfo ) break;
 
-    reg_offset = vm->callinfo_tail->reg_offset;
+    reg_offset = vm->callinfo_tail->reg_offset - vm->callinfo_tail->iter_offset;
     mrbc_pop_callinfo(vm);
   }
 
@@ -1851,26 +2727,36 @@ static inline void op_add( mrbc_vm *vm, mrbc_value *regs EXT )
 
   // in case of Integer + Integer
   if( regs[a].tt == MRBC_TT_INTEGER && regs[a+1].tt == MRBC_TT_INTEGER ) {
+#if defined(MRBC_INT_OVERFLOW_CHECK)
+    mrbc_int_t ret;
+    if( mrbc_int_add_overflow( regs[a].i, regs[a+1].i, &ret ) ) {
+      MRBC_INT_OVERFLOW( vm, &regs[a],
+			 (mrbc_float_t)regs[a].i + regs[a+1].i );
+      return;
+    }
+    regs[a].i = ret;
+#else
     regs[a].i += regs[a+1].i;
+#endif
     return;
   }
 
 #if MRBC_USE_FLOAT
   // in case of Integer + Float
   if( regs[a].tt == MRBC_TT_INTEGER && regs[a+1].tt == MRBC_TT_FLOAT ) {
-    mrbc_set_float( &regs[a], regs[a].i + regs[a+1].d );
+    regs[a] = mrbc_float_value(vm, regs[a].i + mrbc_float(regs[a+1]));
     return;
   }
 
   // in case of Float + Integer
   if( regs[a].tt == MRBC_TT_FLOAT && regs[a+1].tt == MRBC_TT_INTEGER ) {
-    regs[a].d += regs[a+1].i;
+    mrbc_replace_float(vm, &regs[a], mrbc_float(regs[a]) + regs[a+1].i);
     return;
   }
 
   // in case of Float + Float
   if( regs[a].tt == MRBC_TT_FLOAT && regs[a+1].tt == MRBC_TT_FLOAT ) {
-    regs[a].d += regs[a+1].d;
+    mrbc_replace_float(vm, &regs[a], mrbc_float(regs[a]) + mrbc_float(regs[a+1]));
     return;
   }
 #endif
@@ -1890,13 +2776,22 @@ static inline void op_addi( mrbc_vm *vm, mrbc_value *regs EXT )
   FETCH_BB();
 
   if( regs[a].tt == MRBC_TT_INTEGER ) {
+#if defined(MRBC_INT_OVERFLOW_CHECK)
+    mrbc_int_t ret;
+    if( mrbc_int_add_overflow( regs[a].i, b, &ret ) ) {
+      MRBC_INT_OVERFLOW( vm, &regs[a], (mrbc_float_t)regs[a].i + b );
+      return;
+    }
+    regs[a].i = ret;
+#else
     regs[a].i += b;
+#endif
     return;
   }
 
 #if MRBC_USE_FLOAT
   if( regs[a].tt == MRBC_TT_FLOAT ) {
-    regs[a].d += b;
+    mrbc_replace_float(vm, &regs[a], mrbc_float(regs[a]) + b);
     return;
   }
 #endif
@@ -1918,26 +2813,36 @@ static inline void op_sub( mrbc_vm *vm, mrbc_value *regs EXT )
 
   // in case of Integer - Integer
   if( regs[a].tt == MRBC_TT_INTEGER && regs[a+1].tt == MRBC_TT_INTEGER ) {
+#if defined(MRBC_INT_OVERFLOW_CHECK)
+    mrbc_int_t ret;
+    if( mrbc_int_sub_overflow( regs[a].i, regs[a+1].i, &ret ) ) {
+      MRBC_INT_OVERFLOW( vm, &regs[a],
+			 (mrbc_float_t)regs[a].i - regs[a+1].i );
+      return;
+    }
+    regs[a].i = ret;
+#else
     regs[a].i -= regs[a+1].i;
+#endif
     return;
   }
 
 #if MRBC_USE_FLOAT
   // in case of Integer - Float
   if( regs[a].tt == MRBC_TT_INTEGER && regs[a+1].tt == MRBC_TT_FLOAT ) {
-    mrbc_set_float( &regs[a], regs[a].i - regs[a+1].d );
+    regs[a] = mrbc_float_value(vm, regs[a].i - mrbc_float(regs[a+1]));
     return;
   }
 
   // in case of Float - Integer
   if( regs[a].tt == MRBC_TT_FLOAT && regs[a+1].tt == MRBC_TT_INTEGER ) {
-    regs[a].d -= regs[a+1].i;
+    mrbc_replace_float(vm, &regs[a], mrbc_float(regs[a]) - regs[a+1].i);
     return;
   }
 
   // in case of Float - Float
   if( regs[a].tt == MRBC_TT_FLOAT && regs[a+1].tt == MRBC_TT_FLOAT ) {
-    regs[a].d -= regs[a+1].d;
+    mrbc_replace_float(vm, &regs[a], mrbc_float(regs[a]) - mrbc_float(regs[a+1]));
     return;
   }
 #endif
@@ -1957,13 +2862,22 @@ static inline void op_subi( mrbc_vm *vm, mrbc_value *regs EXT )
   FETCH_BB();
 
   if( regs[a].tt == MRBC_TT_INTEGER ) {
+#if defined(MRBC_INT_OVERFLOW_CHECK)
+    mrbc_int_t ret;
+    if( mrbc_int_sub_overflow( regs[a].i, b, &ret ) ) {
+      MRBC_INT_OVERFLOW( vm, &regs[a], (mrbc_float_t)regs[a].i - b );
+      return;
+    }
+    regs[a].i = ret;
+#else
     regs[a].i -= b;
+#endif
     return;
   }
 
 #if MRBC_USE_FLOAT
   if( regs[a].tt == MRBC_TT_FLOAT ) {
-    regs[a].d -= b;
+    mrbc_replace_float(vm, &regs[a], mrbc_float(regs[a]) - b);
     return;
   }
 #endif
@@ -1985,26 +2899,36 @@ static inline void op_mul( mrbc_vm *vm, mrbc_value *regs EXT )
 
   // in case of Integer * Integer
   if( regs[a].tt == MRBC_TT_INTEGER && regs[a+1].tt == MRBC_TT_INTEGER ) {
+#if defined(MRBC_INT_OVERFLOW_CHECK)
+    mrbc_int_t ret;
+    if( mrbc_int_mul_overflow( regs[a].i, regs[a+1].i, &ret ) ) {
+      MRBC_INT_OVERFLOW( vm, &regs[a],
+			 (mrbc_float_t)regs[a].i * regs[a+1].i );
+      return;
+    }
+    regs[a].i = ret;
+#else
     regs[a].i *= regs[a+1].i;
+#endif
     return;
   }
 
 #if MRBC_USE_FLOAT
   // in case of Integer * Float
   if( regs[a].tt == MRBC_TT_INTEGER && regs[a+1].tt == MRBC_TT_FLOAT ) {
-    mrbc_set_float( &regs[a], regs[a].i * regs[a+1].d );
+    regs[a] = mrbc_float_value(vm, regs[a].i * mrbc_float(regs[a+1]));
     return;
   }
 
   // in case of Float * Integer
   if( regs[a].tt == MRBC_TT_FLOAT && regs[a+1].tt == MRBC_TT_INTEGER ) {
-    regs[a].d *= regs[a+1].i;
+    mrbc_replace_float(vm, &regs[a], mrbc_float(regs[a]) * regs[a+1].i);
     return;
   }
 
   // in case of Float * Float
   if( regs[a].tt == MRBC_TT_FLOAT && regs[a+1].tt == MRBC_TT_FLOAT ) {
-    regs[a].d *= regs[a+1].d;
+    mrbc_replace_float(vm, &regs[a], mrbc_float(regs[a]) * mrbc_float(regs[a+1]));
     return;
   }
 #endif
@@ -2032,6 +2956,14 @@ static inline void op_div( mrbc_vm *vm, mrbc_value *regs EXT )
       mrbc_raise(vm, MRBC_CLASS(ZeroDivisionError), 0 );
       return;
     }
+    if( v1 == -1 ) {
+      if( v0 == MRBC_INT_MIN ) {
+	MRBC_INT_OVERFLOW( vm, &regs[a], -(mrbc_float_t)v0 );
+	return;
+      }
+      regs[a].i = -v0;
+      return;
+    }
 
     mrbc_int_t ret = v0 / v1;
     mrbc_int_t mod = v0 % v1;
@@ -2045,19 +2977,19 @@ static inline void op_div( mrbc_vm *vm, mrbc_value *regs EXT )
 #if MRBC_USE_FLOAT
   // in case of Integer / Float
   if( regs[a].tt == MRBC_TT_INTEGER && regs[a+1].tt == MRBC_TT_FLOAT ) {
-    mrbc_set_float( &regs[a], regs[a].i / regs[a+1].d );
+    regs[a] = mrbc_float_value(vm, regs[a].i / mrbc_float(regs[a+1]));
     return;
   }
 
   // in case of Float / Integer
   if( regs[a].tt == MRBC_TT_FLOAT && regs[a+1].tt == MRBC_TT_INTEGER ) {
-    regs[a].d /= regs[a+1].i;
+    mrbc_replace_float(vm, &regs[a], mrbc_float(regs[a]) / regs[a+1].i);
     return;
   }
 
   // in case of Float / Float
   if( regs[a].tt == MRBC_TT_FLOAT && regs[a+1].tt == MRBC_TT_FLOAT ) {
-    regs[a].d /= regs[a+1].d;
+    mrbc_replace_float(vm, &regs[a], mrbc_float(regs[a]) / mrbc_float(regs[a+1]));
     return;
   }
 #endif
@@ -2067,6 +2999,35 @@ static inline void op_div( mrbc_vm *vm, mrbc_value *regs EXT )
 }
 
 
+//================================================================
+/*! compare Integer and Float without mrbc_compare(). (for OP_EQ .. OP_GE)
+
+  If both R[a] and R[a+1] are numeric, set the result to R[a] and return
+  from the instruction. NaN is compared by C operator, so it's always false.
+*/
+#if MRBC_USE_FLOAT
+#define COMPARE_NUMERIC(OP) do {					\
+    if( regs[a].tt == MRBC_TT_INTEGER && regs[a+1].tt == MRBC_TT_INTEGER ) { \
+      regs[a].tt = (regs[a].i OP regs[a+1].i) ? MRBC_TT_TRUE : MRBC_TT_FALSE; \
+      return;								\
+    }									\
+    if( MRBC_ISNUMERIC(regs[a]) && MRBC_ISNUMERIC(regs[a+1]) ) {	\
+      int result = (MRBC_TO_FLOAT(regs[a])) OP (MRBC_TO_FLOAT(regs[a+1])); \
+      mrbc_decref(&regs[a]);						\
+      regs[a].tt = result ? MRBC_TT_TRUE : MRBC_TT_FALSE;		\
+      return;								\
+    }									\
+  } while(0)
+#else
+#define COMPARE_NUMERIC(OP) do {					\
+    if( regs[a].tt == MRBC_TT_INTEGER && regs[a+1].tt == MRBC_TT_INTEGER ) { \
+      regs[a].tt = (regs[a].i OP regs[a+1].i) ? MRBC_TT_TRUE : MRBC_TT_FALSE; \
+      return;								\
+    }									\
+  } while(0)
+#endif
+
+
 //================================================================
 /*! OP_EQ
 
@@ -2076,6 +3037,8 @@ static inline void op_eq( mrbc_vm *vm, mrbc_value *regs EXT )
 {
   FETCH_B();
 
+  COMPARE_NUMERIC( == );
+
   if (regs[a].tt == MRBC_TT_OBJECT) {
     send_by_name(vm, MRBC_SYM(EQ_EQ), a, 1);
     return;
@@ -2097,6 +3060,8 @@ static inline void op_lt( mrbc_vm *vm, mrbc_value *regs EXT )
 {
   FETCH_B();
 
+  COMPARE_NUMERIC( < );
+
   if (regs[a].tt == MRBC_TT_OBJECT) {
     send_by_name(vm, MRBC_SYM(LT), a, 1);
     return;
@@ -2118,6 +3083,8 @@ static inline void op_le( mrbc_vm *vm, mrbc_value *regs EXT )
 {
   FETCH_B();
 
+  COMPARE_NUMERIC( <= );
+
   if (regs[a].tt == MRBC_TT_OBJECT) {
     send_by_name(vm, MRBC_SYM(LT_EQ), a, 1);
     return;
@@ -2139,6 +3106,8 @@ static inline void op_gt( mrbc_vm *vm, mrbc_value *regs EXT )
 {
   FETCH_B();
 
+  COMPARE_NUMERIC( > );
+
   if (regs[a].tt == MRBC_TT_OBJECT) {
     send_by_name(vm, MRBC_SYM(GT), a, 1);
     return;
@@ -2160,6 +3129,8 @@ static inline void op_ge( mrbc_vm *vm, mrbc_value *regs EXT )
 {
   FETCH_B();
 
+  COMPARE_NUMERIC( >= );
+
   if (regs[a].tt == MRBC_TT_OBJECT) {
     send_by_name(vm, MRBC_SYM(GT_EQ), a, 1);
     return;
@@ -2170,6 +3141,7 @@ static inline void op_ge( mrbc_vm *vm, mrbc_value *regs EXT )
   mrbc_decref(&regs[a]);
   regs[a].tt = result >= 0 ? MRBC_TT_TRUE : MRBC_TT_FALSE;
 }
+#undef COMPARE_NUMERIC
 
 
 //================================================================
@@ -2386,7 +3358,12 @@ static inline void op_intern( mrbc_vm *vm, mrbc_value *regs EXT )
 
   assert( regs[a].tt == MRBC_TT_STRING );
 
-  mrbc_value sym_val = mrbc_symbol_new(vm, (const char*)regs[a].string->data);
+  const char *s = mrbc_string_cstr(&regs[a]);
+  if( !s ) {
+    mrbc_raise(vm, MRBC_CLASS(NoMemoryError), 0);
+    return;
+  }
+  mrbc_value sym_val = mrbc_symbol_new(vm, s);
 
   mrbc_decref( &regs[a] );
   regs[a] = sym_val;
@@ -2727,6 +3704,7 @@ static void sub_def_alias( mrbc_class *cls, mrbc_method *method, mrbc_sym sym_id
 {
   method->next = cls->method_link;
   cls->method_link = method;
+  mrbc_method_cache_invalidate();
 
   if( !method->c_func ) sub_irep_incref( method->irep, +1 );
 
@@ -2895,127 +3873,305 @@ int mrbc_vm_run( struct VM *vm )
 #define EXT
 #endif
 
+#if defined(MRBC_USE_THREADED_CODE)
+  // direct threaded code. each handler jumps to the next one directly.
+  static const void * const dispatch_table[256] = {
+    [OP_NOP]       = &&L_OP_NOP,
+    [OP_MOVE]      = &&L_OP_MOVE,
+    [OP_LOADL]     = &&L_OP_LOADL,
+    [OP_LOADI]     = &&L_OP_LOADI,
+    [OP_LOADINEG]  = &&L_OP_LOADINEG,
+    [OP_LOADI__1]  = &&L_OP_LOADI__1,
+    [OP_LOADI_0]   = &&L_OP_LOADI_0,
+    [OP_LOADI_1]   = &&L_OP_LOADI_1,
+    [OP_LOADI_2]   = &&L_OP_LOADI_2,
+    [OP_LOADI_3]   = &&L_OP_LOADI_3,
+    [OP_LOADI_4]   = &&L_OP_LOADI_4,
+    [OP_LOADI_5]   = &&L_OP_LOADI_5,
+    [OP_LOADI_6]   = &&L_OP_LOADI_6,
+    [OP_LOADI_7]   = &&L_OP_LOADI_7,
+    [OP_LOADI16]   = &&L_OP_LOADI16,
+    [OP_LOADI32]   = &&L_OP_LOADI32,
+    [OP_LOADSYM]   = &&L_OP_LOADSYM,
+    [OP_LOADNIL]   = &&L_OP_LOADNIL,
+    [OP_LOADSELF]  = &&L_OP_LOADSELF,
+    [OP_LOADT]     = &&L_OP_LOADT,
+    [OP_LOADF]     = &&L_OP_LOADF,
+    [OP_GETGV]     = &&L_OP_GETGV,
+    [OP_SETGV]     = &&L_OP_SETGV,
+    [OP_GETSV]     = &&L_OP_GETSV,
+    [OP_SETSV]     = &&L_OP_SETSV,
+    [OP_GETIV]     = &&L_OP_GETIV,
+    [OP_SETIV]     = &&L_OP_SETIV,
+    [OP_GETCV]     = &&L_OP_GETCV,
+    [OP_SETCV]     = &&L_OP_SETCV,
+    [OP_GETCONST]  = &&L_OP_GETCONST,
+    [OP_SETCONST]  = &&L_OP_SETCONST,
+    [OP_GETMCNST]  = &&L_OP_GETMCNST,
+    [OP_SETMCNST]  = &&L_OP_SETMCNST,
+    [OP_GETUPVAR]  = &&L_OP_GETUPVAR,
+    [OP_SETUPVAR]  = &&L_OP_SETUPVAR,
+    [OP_GETIDX]    = &&L_OP_GETIDX,
+    [OP_SETIDX]    = &&L_OP_SETIDX,
+    [OP_JMP]       = &&L_OP_JMP,
+    [OP_JMPIF]     = &&L_OP_JMPIF,
+    [OP_JMPNOT]    = &&L_OP_JMPNOT,
+    [OP_JMPNIL]    = &&L_OP_JMPNIL,
+    [OP_JMPUW]     = &&L_OP_JMPUW,
+    [OP_EXCEPT]    = &&L_OP_EXCEPT,
+    [OP_RESCUE]    = &&L_OP_RESCUE,
+    [OP_RAISEIF]   = &&L_OP_RAISEIF,
+    [OP_SSEND]     = &&L_OP_SSEND,
+    [OP_SSENDB]    = &&L_OP_SSENDB,
+    [OP_SEND]      = &&L_OP_SEND,
+    [OP_SENDB]     = &&L_OP_SENDB,
+    [OP_CALL]      = &&L_OP_CALL,
+    [OP_SUPER]     = &&L_OP_SUPER,
+    [OP_ARGARY]    = &&L_OP_ARGARY,
+    [OP_ENTER]     = &&L_OP_ENTER,
+    [OP_KEY_P]     = &&L_OP_KEY_P,
+    [OP_KEYEND]    = &&L_OP_KEYEND,
+    [OP_KARG]      = &&L_OP_KARG,
+    [OP_RETURN]    = &&L_OP_RETURN,
+    [OP_RETURN_BLK]= &&L_OP_RETURN_BLK,
+    [OP_BREAK]     = &&L_OP_BREAK,
+    [OP_BLKPUSH]   = &&L_OP_BLKPUSH,
+    [OP_ADD]       = &&L_OP_ADD,
+    [OP_ADDI]      = &&L_OP_ADDI,
+    [OP_SUB]       = &&L_OP_SUB,
+    [OP_SUBI]      = &&L_OP_SUBI,
+    [OP_MUL]       = &&L_OP_MUL,
+    [OP_DIV]       = &&L_OP_DIV,
+    [OP_EQ]        = &&L_OP_EQ,
+    [OP_LT]        = &&L_OP_LT,
+    [OP_LE]        = &&L_OP_LE,
+    [OP_GT]        = &&L_OP_GT,
+    [OP_GE]        = &&L_OP_GE,
+    [OP_ARRAY]     = &&L_OP_ARRAY,
+    [OP_ARRAY2]    = &&L_OP_ARRAY2,
+    [OP_ARYCAT]    = &&L_OP_ARYCAT,
+    [OP_ARYPUSH]   = &&L_OP_ARYPUSH,
+    [OP_ARYDUP]    = &&L_OP_ARYDUP,
+    [OP_AREF]      = &&L_OP_AREF,
+    [OP_ASET]      = &&L_OP_ASET,
+    [OP_APOST]     = &&L_OP_APOST,
+    [OP_INTERN]    = &&L_OP_INTERN,
+    [OP_SYMBOL]    = &&L_OP_SYMBOL,
+    [OP_STRING]    = &&L_OP_STRING,
+    [OP_STRCAT]    = &&L_OP_STRCAT,
+    [OP_HASH]      = &&L_OP_HASH,
+    [OP_HASHADD]   = &&L_OP_HASHADD,
+    [OP_HASHCAT]   = &&L_OP_HASHCAT,
+    [OP_LAMBDA]    = &&L_OP_LAMBDA,
+    [OP_BLOCK]     = &&L_OP_BLOCK,
+    [OP_METHOD]    = &&L_OP_METHOD,
+    [OP_RANGE_INC] = &&L_OP_RANGE_INC,
+    [OP_RANGE_EXC] = &&L_OP_RANGE_EXC,
+    [OP_OCLASS]    = &&L_OP_OCLASS,
+    [OP_CLASS]     = &&L_OP_CLASS,
+    [OP_MODULE]    = &&L_OP_MODULE,
+    [OP_EXEC]      = &&L_OP_EXEC,
+    [OP_DEF]       = &&L_OP_DEF,
+    [OP_ALIAS]     = &&L_OP_ALIAS,
+    [OP_UNDEF]     = &&L_OP_UNDEF,
+    [OP_SCLASS]    = &&L_OP_SCLASS,
+    [OP_TCLASS]    = &&L_OP_TCLASS,
+    [OP_DEBUG]     = &&L_OP_DEBUG,
+    [OP_ERR]       = &&L_OP_ERR,
+    [OP_EXT1]      = &&L_OP_EXT1,
+    [OP_EXT2]      = &&L_OP_EXT2,
+    [OP_EXT3]      = &&L_OP_EXT3,
+    [OP_STOP]      = &&L_OP_STOP,
+#if defined(MRBC_USE_SUPERINSTRUCTION)
+    [OP_X_LOADI_ADD]  = &&L_OP_X_LOADI_ADD,
+    [OP_X_MOVE_SEND]  = &&L_OP_X_MOVE_SEND,
+    [OP_X_LT_JMPNOT]  = &&L_OP_X_LT_JMPNOT,
+    [OP_X_GETIV_SEND] = &&L_OP_X_GETIV_SEND,
+    [OP_X_GETIV_SEND+1 ... 255] = &&L_DEFAULT,
+#else
+    [OP_STOP+1 ... 255] = &&L_DEFAULT,
+#endif
+  };
+#define CASE(op)	L_##op
+#define CASE_DEFAULT	L_DEFAULT
+#define NEXT_EXT	op = *vm->inst++; COUNT_INSTRUCTION(op); goto *dispatch_table[op]
+#define NEXT_RELOAD	regs = vm->cur_regs; NEXT
+#if defined(MRBC_SUPPORT_OP_EXT)
+#define NEXT		ext = 0; if( vm->flag_preemption ) goto END_OF_INSTRUCTION; NEXT_EXT
+#else
+#define NEXT		if( vm->flag_preemption ) goto END_OF_INSTRUCTION; NEXT_EXT
+#endif
+#else
+  // switch statement.
+#define CASE(op)	case op
+#define CASE_DEFAULT	default
+#define NEXT_EXT	continue
+#define NEXT_RELOAD	break
+#define NEXT		break
+#endif
+
+#if defined(MRBC_USE_SUPERINSTRUCTION)
+  // fused superinstruction. (see load.c)
+  // The second instruction is executed without dispatch, only if the first
+  // one has not changed the flow. (method call, exception or preemption)
+#define FUSED(op1, len1, op2) do {				\
+    const uint8_t *inst2 = vm->inst + (len1);			\
+    op1(vm, regs EXT);						\
+    if( vm->inst == inst2 && !vm->flag_preemption ) {		\
+      vm->inst++;						\
+      COUNT_INSTRUCTION(*inst2);				\
+      op2(vm, regs EXT);					\
+    }								\
+  } while(0)
+#endif
+
+  // raised while the task is stopped. (by Task#raise or the resume function)
+  if( mrbc_israised(vm) ) goto HANDLE_EXCEPTION;
+
   while( 1 ) {
     mrbc_value *regs = vm->cur_regs;
     uint8_t op = *vm->inst++;		// Dispatch
+    COUNT_INSTRUCTION(op);
 
+#if defined(MRBC_USE_THREADED_CODE)
+    goto *dispatch_table[op];
+    {
+#else
     switch( op ) {
-    case OP_NOP:        op_nop        (vm, regs EXT); break;
-    case OP_MOVE:       op_move       (vm, regs EXT); break;
-    case OP_LOADL:      op_loadl      (vm, regs EXT); break;
-    case OP_LOADI:      op_loadi      (vm, regs EXT); break;
-    case OP_LOADINEG:   op_loadineg   (vm, regs EXT); break;
-    case OP_LOADI__1:   // fall through
-    case OP_LOADI_0:    // fall through
-    case OP_LOADI_1:    // fall through
-    case OP_LOADI_2:    // fall through
-    case OP_LOADI_3:    // fall through
-    case OP_LOADI_4:    // fall through
-    case OP_LOADI_5:    // fall through
-    case OP_LOADI_6:    // fall through
-    case OP_LOADI_7:    op_loadi_n    (vm, regs EXT); break;
-    case OP_LOADI16:    op_loadi16    (vm, regs EXT); break;
-    case OP_LOADI32:    op_loadi32    (vm, regs EXT); break;
-    case OP_LOADSYM:    op_loadsym    (vm, regs EXT); break;
-    case OP_LOADNIL:    op_loadnil    (vm, regs EXT); break;
-    case OP_LOADSELF:   op_loadself   (vm, regs EXT); break;
-    case OP_LOADT:      op_loadt      (vm, regs EXT); break;
-    case OP_LOADF:      op_loadf      (vm, regs EXT); break;
-    case OP_GETGV:      op_getgv      (vm, regs EXT); break;
-    case OP_SETGV:      op_setgv      (vm, regs EXT); break;
-    case OP_GETSV:      op_unsupported(vm, regs EXT); break; // not implemented.
-    case OP_SETSV:      op_unsupported(vm, regs EXT); break; // not implemented.
-    case OP_GETIV:      op_getiv      (vm, regs EXT); break;
-    case OP_SETIV:      op_setiv      (vm, regs EXT); break;
-    case OP_GETCV:      op_unsupported(vm, regs EXT); break; // not implemented.
-    case OP_SETCV:      op_unsupported(vm, regs EXT); break; // not implemented.
-    case OP_GETCONST:   op_getconst   (vm, regs EXT); break;
-    case OP_SETCONST:   op_setconst   (vm, regs EXT); break;
-    case OP_GETMCNST:   op_getmcnst   (vm, regs EXT); break;
-    case OP_SETMCNST:   op_unsupported(vm, regs EXT); break; // not implemented.
-    case OP_GETUPVAR:   op_getupvar   (vm, regs EXT); break;
-    case OP_SETUPVAR:   op_setupvar   (vm, regs EXT); break;
-    case OP_GETIDX:     op_getidx     (vm, regs EXT); break;
-    case OP_SETIDX:     op_setidx     (vm, regs EXT); break;
-    case OP_JMP:        op_jmp        (vm, regs EXT); break;
-    case OP_JMPIF:      op_jmpif      (vm, regs EXT); break;
-    case OP_JMPNOT:     op_jmpnot     (vm, regs EXT); break;
-    case OP_JMPNIL:     op_jmpnil     (vm, regs EXT); break;
-    case OP_JMPUW:      op_jmpuw      (vm, regs EXT); break;
-    case OP_EXCEPT:     op_except     (vm, regs EXT); break;
-    case OP_RESCUE:     op_rescue     (vm, regs EXT); break;
-    case OP_RAISEIF:    op_raiseif    (vm, regs EXT); break;
-    case OP_SSEND:      op_ssend      (vm, regs EXT); break;
-    case OP_SSENDB:     op_ssendb     (vm, regs EXT); break;
-    case OP_SEND:       op_send       (vm, regs EXT); break;
-    case OP_SENDB:      op_sendb      (vm, regs EXT); break;
-    case OP_CALL:       op_unsupported(vm, regs EXT); break; // not implemented.
-    case OP_SUPER:      op_super      (vm, regs EXT); break;
-    case OP_ARGARY:     op_argary     (vm, regs EXT); break;
-    case OP_ENTER:      op_enter      (vm, regs EXT); break;
-    case OP_KEY_P:      op_key_p      (vm, regs EXT); break;
-    case OP_KEYEND:     op_keyend     (vm, regs EXT); break;
-    case OP_KARG:       op_karg       (vm, regs EXT); break;
-    case OP_RETURN:     op_return     (vm, regs EXT); break;
-    case OP_RETURN_BLK: op_return_blk (vm, regs EXT); break;
-    case OP_BREAK:      op_break      (vm, regs EXT); break;
-    case OP_BLKPUSH:    op_blkpush    (vm, regs EXT); break;
-    case OP_ADD:        op_add        (vm, regs EXT); break;
-    case OP_ADDI:       op_addi       (vm, regs EXT); break;
-    case OP_SUB:        op_sub        (vm, regs EXT); break;
-    case OP_SUBI:       op_subi       (vm, regs EXT); break;
-    case OP_MUL:        op_mul        (vm, regs EXT); break;
-    case OP_DIV:        op_div        (vm, regs EXT); break;
-    case OP_EQ:         op_eq         (vm, regs EXT); break;
-    case OP_LT:         op_lt         (vm, regs EXT); break;
-    case OP_LE:         op_le         (vm, regs EXT); break;
-    case OP_GT:         op_gt         (vm, regs EXT); break;
-    case OP_GE:         op_ge         (vm, regs EXT); break;
-    case OP_ARRAY:      op_array      (vm, regs EXT); break;
-    case OP_ARRAY2:     op_array2     (vm, regs EXT); break;
-    case OP_ARYCAT:     op_arycat     (vm, regs EXT); break;
-    case OP_ARYPUSH:    op_arypush    (vm, regs EXT); break;
-    case OP_ARYDUP:     op_arydup     (vm, regs EXT); break;
-    case OP_AREF:       op_aref       (vm, regs EXT); break;
-    case OP_ASET:       op_aset       (vm, regs EXT); break;
-    case OP_APOST:      op_apost      (vm, regs EXT); break;
-    case OP_INTERN:     op_intern     (vm, regs EXT); break;
-    case OP_SYMBOL:     op_symbol     (vm, regs EXT); break;
-    case OP_STRING:     op_string     (vm, regs EXT); break;
-    case OP_STRCAT:     op_strcat     (vm, regs EXT); break;
-    case OP_HASH:       op_hash       (vm, regs EXT); break;
-    case OP_HASHADD:    op_hashadd    (vm, regs EXT); break;
-    case OP_HASHCAT:    op_hashcat    (vm, regs EXT); break;
-    case OP_LAMBDA:     op_unsupported(vm, regs EXT); break; // not implemented.
-    case OP_BLOCK:      op_block      (vm, regs EXT); break;
-    case OP_METHOD:     op_method     (vm, regs EXT); break;
-    case OP_RANGE_INC:  op_range_inc  (vm, regs EXT); break;
-    case OP_RANGE_EXC:  op_range_exc  (vm, regs EXT); break;
-    case OP_OCLASS:     op_oclass     (vm, regs EXT); break;
-    case OP_CLASS:      op_class      (vm, regs EXT); break;
-    case OP_MODULE:     op_module     (vm, regs EXT); break;
-    case OP_EXEC:       op_exec       (vm, regs EXT); break;
-    case OP_DEF:        op_def        (vm, regs EXT); break;
-    case OP_ALIAS:      op_alias      (vm, regs EXT); break;
-    case OP_UNDEF:      op_unsupported(vm, regs EXT); break; // not implemented.
-    case OP_SCLASS:     op_sclass     (vm, regs EXT); break;
-    case OP_TCLASS:     op_tclass     (vm, regs EXT); break;
-    case OP_DEBUG:      op_unsupported(vm, regs EXT); break; // not implemented.
-    case OP_ERR:        op_unsupported(vm, regs EXT); break; // not implemented.
+#endif
+    CASE(OP_NOP):       op_nop        (vm, regs EXT); NEXT;
+    CASE(OP_MOVE):      op_move       (vm, regs EXT); NEXT;
+    CASE(OP_LOADL):     op_loadl      (vm, regs EXT); NEXT;
+    CASE(OP_LOADI):     op_loadi      (vm, regs EXT); NEXT;
+    CASE(OP_LOADINEG):  op_loadineg   (vm, regs EXT); NEXT;
+    CASE(OP_LOADI__1):  // fall through
+    CASE(OP_LOADI_0):   // fall through
+    CASE(OP_LOADI_1):   // fall through
+    CASE(OP_LOADI_2):   // fall through
+    CASE(OP_LOADI_3):   // fall through
+    CASE(OP_LOADI_4):   // fall through
+    CASE(OP_LOADI_5):   // fall through
+    CASE(OP_LOADI_6):   // fall through
+    CASE(OP_LOADI_7):   op_loadi_n    (vm, regs EXT); NEXT;
+    CASE(OP_LOADI16):   op_loadi16    (vm, regs EXT); NEXT;
+    CASE(OP_LOADI32):   op_loadi32    (vm, regs EXT); NEXT;
+    CASE(OP_LOADSYM):   op_loadsym    (vm, regs EXT); NEXT;
+    CASE(OP_LOADNIL):   op_loadnil    (vm, regs EXT); NEXT;
+    CASE(OP_LOADSELF):  op_loadself   (vm, regs EXT); NEXT;
+    CASE(OP_LOADT):     op_loadt      (vm, regs EXT); NEXT;
+    CASE(OP_LOADF):     op_loadf      (vm, regs EXT); NEXT;
+    CASE(OP_GETGV):     op_getgv      (vm, regs EXT); NEXT_RELOAD;
+    CASE(OP_SETGV):     op_setgv      (vm, regs EXT); NEXT_RELOAD;
+    CASE(OP_GETSV):     op_unsupported(vm, regs EXT); NEXT_RELOAD; // not implemented.
+    CASE(OP_SETSV):     op_unsupported(vm, regs EXT); NEXT_RELOAD; // not implemented.
+    CASE(OP_GETIV):     op_getiv      (vm, regs EXT); NEXT_RELOAD;
+    CASE(OP_SETIV):     op_setiv      (vm, regs EXT); NEXT_RELOAD;
+    CASE(OP_GETCV):     op_unsupported(vm, regs EXT); NEXT_RELOAD; // not implemented.
+    CASE(OP_SETCV):     op_unsupported(vm, regs EXT); NEXT_RELOAD; // not implemented.
+    CASE(OP_GETCONST):  op_getconst   (vm, regs EXT); NEXT_RELOAD;
+    CASE(OP_SETCONST):  op_setconst   (vm, regs EXT); NEXT_RELOAD;
+    CASE(OP_GETMCNST):  op_getmcnst   (vm, regs EXT); NEXT_RELOAD;
+    CASE(OP_SETMCNST):  op_unsupported(vm, regs EXT); NEXT_RELOAD; // not implemented.
+    CASE(OP_GETUPVAR):  op_getupvar   (vm, regs EXT); NEXT;
+    CASE(OP_SETUPVAR):  op_setupvar   (vm, regs EXT); NEXT;
+    CASE(OP_GETIDX):    op_getidx     (vm, regs EXT); NEXT_RELOAD;
+    CASE(OP_SETIDX):    op_setidx     (vm, regs EXT); NEXT_RELOAD;
+    CASE(OP_JMP):       op_jmp        (vm, regs EXT); NEXT;
+    CASE(OP_JMPIF):     op_jmpif      (vm, regs EXT); NEXT;
+    CASE(OP_JMPNOT):    op_jmpnot     (vm, regs EXT); NEXT;
+    CASE(OP_JMPNIL):    op_jmpnil     (vm, regs EXT); NEXT;
+    CASE(OP_JMPUW):     op_jmpuw      (vm, regs EXT); NEXT_RELOAD;
+    CASE(OP_EXCEPT):    op_except     (vm, regs EXT); NEXT;
+    CASE(OP_RESCUE):    op_rescue     (vm, regs EXT); NEXT_RELOAD;
+    CASE(OP_RAISEIF):   op_raiseif    (vm, regs EXT); NEXT_RELOAD;
+    CASE(OP_SSEND):     op_ssend      (vm, regs EXT); NEXT_RELOAD;
+    CASE(OP_SSENDB):    op_ssendb     (vm, regs EXT); NEXT_RELOAD;
+    CASE(OP_SEND):      op_send       (vm, regs EXT); NEXT_RELOAD;
+    CASE(OP_SENDB):     op_sendb      (vm, regs EXT); NEXT_RELOAD;
+    CASE(OP_CALL):      op_unsupported(vm, regs EXT); NEXT_RELOAD; // not implemented.
+    CASE(OP_SUPER):     op_super      (vm, regs EXT); NEXT_RELOAD;
+    CASE(OP_ARGARY):    op_argary     (vm, regs EXT); NEXT_RELOAD;
+    CASE(OP_ENTER):     op_enter      (vm, regs EXT); NEXT_RELOAD;
+    CASE(OP_KEY_P):     op_key_p      (vm, regs EXT); NEXT_RELOAD;
+    CASE(OP_KEYEND):    op_keyend     (vm, regs EXT); NEXT_RELOAD;
+    CASE(OP_KARG):      op_karg       (vm, regs EXT); NEXT_RELOAD;
+    CASE(OP_RETURN):    op_return     (vm, regs EXT); NEXT_RELOAD;
+    CASE(OP_RETURN_BLK): op_return_blk (vm, regs EXT); NEXT_RELOAD;
+    CASE(OP_BREAK):     op_break      (vm, regs EXT); NEXT_RELOAD;
+    CASE(OP_BLKPUSH):   op_blkpush    (vm, regs EXT); NEXT_RELOAD;
+    CASE(OP_ADD):       op_add        (vm, regs EXT); NEXT_RELOAD;
+    CASE(OP_ADDI):      op_addi       (vm, regs EXT); NEXT_RELOAD;
+    CASE(OP_SUB):       op_sub        (vm, regs EXT); NEXT_RELOAD;
+    CASE(OP_SUBI):      op_subi       (vm, regs EXT); NEXT_RELOAD;
+    CASE(OP_MUL):       op_mul        (vm, regs EXT); NEXT_RELOAD;
+    CASE(OP_DIV):       op_div        (vm, regs EXT); NEXT_RELOAD;
+    CASE(OP_EQ):        op_eq         (vm, regs EXT); NEXT_RELOAD;
+    CASE(OP_LT):        op_lt         (vm, regs EXT); NEXT_RELOAD;
+    CASE(OP_LE):        op_le         (vm, regs EXT); NEXT_RELOAD;
+    CASE(OP_GT):        op_gt         (vm, regs EXT); NEXT_RELOAD;
+    CASE(OP_GE):        op_ge         (vm, regs EXT); NEXT_RELOAD;
+    CASE(OP_ARRAY):     op_array      (vm, regs EXT); NEXT;
+    CASE(OP_ARRAY2):    op_array2     (vm, regs EXT); NEXT;
+    CASE(OP_ARYCAT):    op_arycat     (vm, regs EXT); NEXT_RELOAD;
+    CASE(OP_ARYPUSH):   op_arypush    (vm, regs EXT); NEXT_RELOAD;
+    CASE(OP_ARYDUP):    op_arydup     (vm, regs EXT); NEXT_RELOAD;
+    CASE(OP_AREF):      op_aref       (vm, regs EXT); NEXT_RELOAD;
+    CASE(OP_ASET):      op_aset       (vm, regs EXT); NEXT_RELOAD;
+    CASE(OP_APOST):     op_apost      (vm, regs EXT); NEXT_RELOAD;
+    CASE(OP_INTERN):    op_intern     (vm, regs EXT); NEXT;
+    CASE(OP_SYMBOL):    op_symbol     (vm, regs EXT); NEXT_RELOAD;
+    CASE(OP_STRING):    op_string     (vm, regs EXT); NEXT;
+    CASE(OP_STRCAT):    op_strcat     (vm, regs EXT); NEXT_RELOAD;
+    CASE(OP_HASH):      op_hash       (vm, regs EXT); NEXT_RELOAD;
+    CASE(OP_HASHADD):   op_hashadd    (vm, regs EXT); NEXT_RELOAD;
+    CASE(OP_HASHCAT):   op_hashcat    (vm, regs EXT); NEXT_RELOAD;
+    CASE(OP_LAMBDA):    op_unsupported(vm, regs EXT); NEXT_RELOAD; // not implemented.
+    CASE(OP_BLOCK):     op_block      (vm, regs EXT); NEXT_RELOAD;
+    CASE(OP_METHOD):    op_method     (vm, regs EXT); NEXT_RELOAD;
+    CASE(OP_RANGE_INC): op_range_inc  (vm, regs EXT); NEXT;
+    CASE(OP_RANGE_EXC): op_range_exc  (vm, regs EXT); NEXT;
+    CASE(OP_OCLASS):    op_oclass     (vm, regs EXT); NEXT_RELOAD;
+    CASE(OP_CLASS):     op_class      (vm, regs EXT); NEXT_RELOAD;
+    CASE(OP_MODULE):    op_module     (vm, regs EXT); NEXT_RELOAD;
+    CASE(OP_EXEC):      op_exec       (vm, regs EXT); NEXT_RELOAD;
+    CASE(OP_DEF):       op_def        (vm, regs EXT); NEXT_RELOAD;
+    CASE(OP_ALIAS):     op_alias      (vm, regs EXT); NEXT_RELOAD;
+    CASE(OP_UNDEF):     op_unsupported(vm, regs EXT); NEXT_RELOAD; // not implemented.
+    CASE(OP_SCLASS):    op_sclass     (vm, regs EXT); NEXT_RELOAD;
+    CASE(OP_TCLASS):    op_tclass     (vm, regs EXT); NEXT_RELOAD;
+    CASE(OP_DEBUG):     op_unsupported(vm, regs EXT); NEXT_RELOAD; // not implemented.
+    CASE(OP_ERR):       op_unsupported(vm, regs EXT); NEXT_RELOAD; // not implemented.
 #if defined(MRBC_SUPPORT_OP_EXT)
-    case OP_EXT1:       ext = 1; continue;
-    case OP_EXT2:       ext = 2; continue;
-    case OP_EXT3:       ext = 3; continue;
+    CASE(OP_EXT1):      ext = 1; NEXT_EXT;
+    CASE(OP_EXT2):      ext = 2; NEXT_EXT;
+    CASE(OP_EXT3):      ext = 3; NEXT_EXT;
 #else
-    case OP_EXT1:       // fall through
-    case OP_EXT2:       // fall through
-    case OP_EXT3:       op_ext        (vm, regs EXT); break;
+    CASE(OP_EXT1):      // fall through
+    CASE(OP_EXT2):      // fall through
+    CASE(OP_EXT3):      op_ext        (vm, regs EXT); NEXT_RELOAD;
 #endif
-    case OP_STOP:       op_stop       (vm, regs EXT); break;
-    default:		op_unsupported(vm, regs EXT); break;
+    CASE(OP_STOP):      op_stop       (vm, regs EXT); NEXT_RELOAD;
+#if defined(MRBC_USE_SUPERINSTRUCTION)
+    CASE(OP_X_LOADI_ADD):  FUSED(op_loadi, 2, op_add);	NEXT_RELOAD;
+    CASE(OP_X_MOVE_SEND):  FUSED(op_move, 2, op_send);	NEXT_RELOAD;
+    CASE(OP_X_LT_JMPNOT):  FUSED(op_lt, 1, op_jmpnot);	NEXT_RELOAD;
+    CASE(OP_X_GETIV_SEND): FUSED(op_getiv, 2, op_send);	NEXT_RELOAD;
+#endif
+    CASE_DEFAULT:       op_unsupported(vm, regs EXT); NEXT_RELOAD;
     } // end switch.
 
+#if defined(MRBC_USE_THREADED_CODE)
+  END_OF_INSTRUCTION:
+#endif
 #undef EXT
+#undef CASE
+#undef CASE_DEFAULT
+#undef NEXT_EXT
+#undef NEXT_RELOAD
+#undef NEXT
+#if defined(MRBC_USE_SUPERINSTRUCTION)
+#undef FUSED
+#endif
 #if defined(MRBC_SUPPORT_OP_EXT)
     ext = 0;
 #endif
@@ -3024,6 +4180,7 @@ int mrbc_vm_run( struct VM *vm )
 
 
     // Handle exception
+  HANDLE_EXCEPTION:
     vm->flag_preemption = 0;
     const mrbc_irep_catch_handler *handler;
 
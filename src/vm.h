@@ -35,6 +35,19 @@ extern "C" {
 /***** Constat values *******************************************************/
 /***** Macros ***************************************************************/
 /***** Typedefs *************************************************************/
+//================================================================
+/*!@brief
+  Step function of a native block iterator. (see mrbc_iter_start)
+
+  @param  vm	pointer to VM.
+  @param  recv	receiver of the iterator method.
+  @param  work	two work registers of the iterator.
+  @param  blk	block frame. blk[0] is the value of the last block call.
+  @return	num of block arguments set in blk[1..], or -1 if finished.
+*/
+typedef int (*mrbc_iter_func)(struct VM *vm, mrbc_value *recv, mrbc_value *work, mrbc_value *blk);
+
+
 //================================================================
 /*!@brief
   IREP Internal REPresentation
@@ -57,6 +70,7 @@ typedef struct IREP {
   uint16_t slen;		//!< num of symbols
 #endif
   uint16_t ofs_pools;		//!< offset of data->tbl_pools.
+  uint16_t ofs_ivars;		//!< offset of data->tbl_ivars, or 0 if none.
   uint16_t ofs_ireps;		//!< offset of data->tbl_ireps. (32bit aligned)
 
   const uint8_t *inst;		//!< pointer to instruction in RITE binary
@@ -65,6 +79,7 @@ typedef struct IREP {
   uint8_t data[];		//!< variable data. (see load.c)
 				//!<  mrbc_sym   tbl_syms[slen]
 				//!<  uint16_t   tbl_pools[plen]
+				//!<  mrbc_sym   tbl_ivars[slen] (if any)
 				//!<  mrbc_irep *tbl_ireps[rlen]
 } mrbc_irep;
 typedef struct IREP mrb_irep;
@@ -80,6 +95,11 @@ typedef struct IREP mrb_irep;
 #define mrbc_irep_symbol_cstr(irep, n)	mrbc_symid_to_str( mrbc_irep_symbol_id(irep, n) )
 
 
+//! get a n'th instance variable name (without '@') symbol id in irep
+#define mrbc_irep_ivar_id(irep, n) \
+  ( ((mrbc_sym *)((irep)->data + (irep)->ofs_ivars))[(n)] )
+
+
 //! get a pool data offset table pointer.
 #define mrbc_irep_tbl_pools(irep) \
   ( (uint16_t *)((irep)->data + (irep)->ofs_pools) )
@@ -124,10 +144,16 @@ typedef struct CALLINFO {
 
   mrbc_class *own_class;	//!< class that owns method.
   struct RHash *karg_keep;	//!< keyword argument backup for OP_ARGARY.
+  mrbc_value *kargs;		//!< keyword arguments in the stash, or NULL.
+  mrbc_value *regs_end;		//!< end of the registers used by all callers.
   mrbc_sym method_id;		//!< called method ID.
   uint8_t reg_offset;		//!< register offset after call.
   uint8_t n_args;		//!< num of arguments.
   uint8_t is_called_super;	//!< this is called by op_super.
+  uint8_t n_kargs;		//!< num of keyword arguments (pairs) in registers.
+  uint16_t karg_used;		//!< bitmap of kargs taken by OP_KARG.
+  uint8_t iter_offset;		//!< offset from the iterator receiver to the block frame.
+  mrbc_iter_func iter;		//!< step function if this is a native iterator block.
 
 } mrbc_callinfo;
 typedef struct CALLINFO mrb_callinfo;
@@ -146,6 +172,7 @@ typedef struct VM {
   unsigned int flag_need_memfree : 1;
   unsigned int flag_stop : 1;
   unsigned int flag_permanence : 1;
+  unsigned int flag_no_superinstruction : 1; //!< don't fuse instructions at load.
 
   uint16_t	  regs_size;		//!< size of regs[]
 
@@ -155,7 +182,11 @@ typedef struct VM {
   mrbc_value	  *cur_regs;		//!< Current register top.
   mrbc_class      *target_class;	//!< Target class.
   mrbc_callinfo	  *callinfo_tail;	//!< Last point of CALLINFO link.
+  mrbc_callinfo	  *callinfo_free;	//!< Free list of CALLINFO for reuse.
+  uint16_t	  callinfo_depth;	//!< Current depth of CALLINFO link.
+  uint16_t	  callinfo_max_depth;	//!< High-water mark of callinfo_depth.
   mrbc_proc	  *ret_blk;		//!< Return block.
+  mrbc_value	  *karg_stack;		//!< Bottom of the keyword argument stash.
 
   mrbc_value	  exception;		//!< Raised exception or nil.
   mrbc_value      regs[];
@@ -163,20 +194,57 @@ typedef struct VM {
 typedef struct VM mrb_vm;
 
 
+#if defined(MRBC_USE_PROFILER)
+//================================================================
+/*!@brief
+  Profiler data.
+*/
+struct MRBC_PROFILE {
+  volatile uint8_t flag_enable;	//!< profiling now.
+  uint32_t op_count[256];	//!< num of executions per opcode.
+  uint32_t ticks_other;		//!< ticks that could not be recorded.
+  struct MRBC_PROFILE_METHOD {
+    const struct RClass *cls;	//!< class that owns method, or NULL.
+    mrbc_sym method_id;		//!< method name. 0 is top level.
+    uint32_t ticks;		//!< num of sampled ticks.
+  } method[MRBC_PROFILE_METHOD_COUNT];
+};
+#endif
+
+
 /***** Global variables *****************************************************/
+#if defined(MRBC_COUNT_INSTRUCTIONS)
+extern uint64_t mrbc_instruction_count;
+#endif
+#if defined(MRBC_USE_PROFILER)
+extern struct MRBC_PROFILE mrbc_profile;
+#endif
+
+
 /***** Function prototypes **************************************************/
 //@cond
 void mrbc_cleanup_vm(void);
+void mrbc_method_cache_statistics(struct MRBC_METHOD_CACHE_STATISTICS *ret);
+void mrbc_method_cache_clear_statistics(void);
 mrbc_sym mrbc_get_callee_symid(struct VM *vm);
 const char *mrbc_get_callee_name(struct VM *vm);
 mrbc_callinfo *mrbc_push_callinfo(struct VM *vm, mrbc_sym method_id, int reg_offset, int n_args);
 void mrbc_pop_callinfo(struct VM *vm);
+int mrbc_iter_start(struct VM *vm, mrbc_value v[], int argc, mrbc_iter_func step, mrbc_value w0, mrbc_value w1);
 mrbc_vm *mrbc_vm_new(int regs_size);
 mrbc_vm *mrbc_vm_open(struct VM *vm);
 void mrbc_vm_close(struct VM *vm);
 void mrbc_vm_begin(struct VM *vm);
 void mrbc_vm_end(struct VM *vm);
 int mrbc_vm_run(struct VM *vm);
+#if defined(MRBC_USE_PROFILER)
+void mrbc_profile_start(void);
+void mrbc_profile_stop(void);
+void mrbc_profile_sample(const struct VM *vm);
+const char *mrbc_profile_opcode_name(int op);
+void mrbc_profile_method_name(const struct MRBC_PROFILE_METHOD *m, char *buf, int bufsiz);
+void mrbc_profile_print_statistics(void);
+#endif
 //@endcond
 
 
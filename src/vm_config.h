@@ -23,7 +23,32 @@
 #define MAX_REGS_SIZE 110
 #endif
 
-// maximum number of symbols
+// number of entries of the inline method cache (power of 2, 0: not use)
+#if !defined(MRBC_METHOD_CACHE_SIZE)
+#define MRBC_METHOD_CACHE_SIZE 32
+#endif
+
+// number of entries of the instance variable slot cache (power of 2, 0: not use)
+#if !defined(MRBC_IVAR_CACHE_SIZE)
+#define MRBC_IVAR_CACHE_SIZE 16
+#endif
+
+// number of entries of the constant cache (power of 2, 0: not use)
+#if !defined(MRBC_CONST_CACHE_SIZE)
+#define MRBC_CONST_CACHE_SIZE 16
+#endif
+
+// number of entries in a Hash to build the search index (0: not use)
+#if !defined(MRBC_HASH_INDEX_THRESHOLD)
+#define MRBC_HASH_INDEX_THRESHOLD 16
+#endif
+
+// number of methods recorded by the profiler (see MRBC_USE_PROFILER)
+#if !defined(MRBC_PROFILE_METHOD_COUNT)
+#define MRBC_PROFILE_METHOD_COUNT 32
+#endif
+
+// maximum number of symbols (except built-in symbols, up to 4095)
 #if !defined(MAX_SYMBOLS_COUNT)
 #define MAX_SYMBOLS_COUNT 255
 #endif
@@ -33,6 +58,20 @@
 //  MRBC_ALLOC_16BIT or MRBC_ALLOC_24BIT
 #define MRBC_ALLOC_24BIT
 
+// size of the slab area for small objects, carved from the pool (0: not use)
+// Small objects are allocated faster and don't fragment the pool, but the
+// area is reserved for them. A larger object can't use the free slots in it.
+// It is used only if the pool is 4 times as large or more.
+// (e.g. 4096 for the 40KB pool of PIC32MX170F256B)
+#if !defined(MRBC_ALLOC_SLAB_SIZE)
+#define MRBC_ALLOC_SLAB_SIZE 0
+#endif
+
+// Per-task scratch arena for short-lived objects. (see mrbc_set_scratch_arena)
+// Objects are bump-allocated in chunks (MRBC_SCRATCH_CHUNK_SIZE, default 256)
+// and a chunk is reclaimed at once when all objects in it are freed.
+// #define MRBC_USE_SCRATCH_ARENA
+
 
 /* USE Float. Support Float class.
    0: NOT USE
@@ -43,6 +82,18 @@
 #define MRBC_USE_FLOAT 2
 #endif
 
+/* Compact value representation.
+   mrbc_value holds a type and a 32bit payload, so it becomes 8 bytes
+   on 32bit targets instead of 16. Float objects are allocated in the heap
+   and shared by reference counting. Can't use with MRBC_INT64.
+*/
+// #define MRBC_USE_COMPACT_VALUE
+
+// Check overflow of Integer arithmetic. The result is promoted to Float,
+// or RangeError is raised if Float is not used.
+// Comment out to get the wrapped around result as earlier versions.
+#define MRBC_INT_OVERFLOW_CHECK		/* CHANGED */
+
 // Use math. Support Math class.
 #if !defined(MRBC_USE_MATH)
 #define MRBC_USE_MATH 1		/* CHANGED */
@@ -110,6 +161,10 @@
 
 // #define MRBC_NO_TIMER
 
+// Tickless idle. When no task is ready, the periodic tick is stopped and
+// the CPU sleeps until the nearest wakeup time. (needs hal_idle_tickless)
+// #define MRBC_USE_TICKLESS
+
 // Console new-line mode.
 // If you need to convert LF to CRLF in console output, enable the following:
 // #define MRBC_CONVERT_CRLF
@@ -120,6 +175,33 @@
 // If you get exception with message "Not support op_ext..." when runtime.
 // #define MRBC_SUPPORT_OP_EXT
 
+// Use direct threaded code (computed goto) for instruction dispatch.
+// It needs the "labels as values" extension of GCC. Otherwise, switch is used.
+// #define MRBC_USE_THREADED_CODE
+
+// Load all IREPs of a bytecode into one memory block. Instructions, literals
+// and symbol names are still referenced in place from the bytecode (flash).
+// The block is released when no method refers to any IREP in it.
+#define MRBC_IREP_SINGLE_BLOCK
+
+// Fuse frequent instruction pairs (e.g. OP_LT + OP_JMPNOT) into
+// superinstructions at load time. The instructions are copied for it, so
+// only the bytecode already in RAM is fused, and the bytecode in flash is
+// still referenced in place. hal_is_ram_address(p) in hal.h tells which.
+// Set vm->flag_no_superinstruction before loading to opt out.
+// #define MRBC_USE_SUPERINSTRUCTION
+
+// Accept the pre-linked image made by host/mrbc_image as well as .mrb
+// for fast task startup. It needs MRBC_IREP_SINGLE_BLOCK.
+// #define MRBC_USE_IMAGE
+
+// Count executed instructions to mrbc_instruction_count. (for benchmark)
+// #define MRBC_COUNT_INSTRUCTIONS
+
+// Profiler. Counts executions per opcode, and samples the running method
+// at each tick. (see VM.profile and mrbc_profile_print_statistics)
+// #define MRBC_USE_PROFILER
+
 // If you use LIBC malloc instead of mruby/c malloc
 // #define MRBC_ALLOC_LIBC
 
@@ -45,9 +45,72 @@ void tick_timer_init( void )
   T1CONbits.ON = 1;
 }
 
+
+#if defined(MRBC_USE_TICKLESS)
+/*
+  Tickless idle.
+
+  While idle, Timer1 counts PBCLK 1:8 (1250 counts/ms) up to the deadline,
+  so one period can be 52ms at the longest. The interrupt at the end of
+  the period only wakes up the CPU, and the elapsed ticks are returned.
+  The remainder is carried over to the next tick.
+  WAIT is executed with interrupts disabled. It wakes up on a pending
+  interrupt all the same, so an interrupt just before it isn't missed.
+  The interrupts are handled after the CPU wakes up.
+*/
+#define TICKLESS_COUNT_PER_TICK (PBCLK / 8 / 1000)
+#define TICKLESS_MAX_TICKS	(0xffff / TICKLESS_COUNT_PER_TICK)
+
+static volatile int flag_tickless_;
+static volatile int flag_expired_;
+
+uint32_t hal_idle_tickless( uint32_t ticks )
+{
+  if( ticks == 0 || ticks > TICKLESS_MAX_TICKS ) ticks = TICKLESS_MAX_TICKS;
+
+  // switch to 1:8 keeping the counts in the current tick.
+  T1CONbits.ON = 0;
+  TMR1 = TMR1 / 8;
+  T1CONbits.TCKPS = 1;
+  PR1 = ticks * TICKLESS_COUNT_PER_TICK - 1;
+  IFS0CLR = (1 << _IFS0_T1IF_POSITION);
+  flag_tickless_ = 1;
+  flag_expired_ = 0;
+  T1CONbits.ON = 1;
+
+  // wait for the deadline or any other interrupt, and handle it.
+  _wait();
+  __builtin_enable_interrupts();
+  _ehb();
+  __builtin_disable_interrupts();
+
+  T1CONbits.ON = 0;
+  flag_tickless_ = 0;
+  uint32_t counts = TMR1;
+  if( flag_expired_ ) counts += PR1 + 1;
+
+  // back to the periodic tick.
+  T1CONbits.TCKPS = 0;
+  PR1 = PBCLK / 1000;
+  TMR1 = (counts % TICKLESS_COUNT_PER_TICK) * 8;
+  IFS0CLR = (1 << _IFS0_T1IF_POSITION);
+  T1CONbits.ON = 1;
+
+  return counts / TICKLESS_COUNT_PER_TICK;
+}
+#endif
+
+
 // Timer1 interrupt handler.
 void __ISR(_TIMER_1_VECTOR, IPL1AUTO) timer1_isr( void )
 {
+#if defined(MRBC_USE_TICKLESS)
+  if( flag_tickless_ ) {
+    flag_expired_ = 1;
+    IFS0CLR = (1 << _IFS0_T1IF_POSITION);
+    return;
+  }
+#endif
   mrbc_tick();
   IFS0CLR = (1 << _IFS0_T1IF_POSITION);
 }
@@ -35,15 +35,23 @@
 #define UART_NL		"\n"
 #endif
 
+// events to wake up the task waiting for the data. (see rrt0.c)
+#define UART_EVENT_RX(hndl)	((const void *)&(hndl)->rxfifo)
+#define UART_EVENT_TX(hndl)	((const void *)&(hndl)->txfifo)
+
 
 // handle table.
 UART_HANDLE uart_handle_[NUM_UART_UNIT];
 
+// default receive buffers.
+static uint8_t uart_rxfifo_[NUM_UART_UNIT][UART_SIZE_RXFIFO];
+
 // function prototypes for static function.
 static int uart_assign_pin( const UART_HANDLE *hndl );
 static void c_uart_new(mrbc_vm *vm, mrbc_value v[], int argc);
 static void c_uart_setmode(mrbc_vm *vm, mrbc_value v[], int argc);
 static void c_uart_read(mrbc_vm *vm, mrbc_value v[], int argc);
+static void c_uart_read_into(mrbc_vm *vm, mrbc_value v[], int argc);
 static void c_uart_write(mrbc_vm *vm, mrbc_value v[], int argc);
 static void c_uart_gets(mrbc_vm *vm, mrbc_value v[], int argc);
 static void c_uart_puts(mrbc_vm *vm, mrbc_value v[], int argc);
@@ -93,6 +101,11 @@ void __ISR(_UART_1_VECTOR, IPL4AUTO) uart1_isr( void )
     IFS1CLR = (1 << _IFS1_U1RXIF_POSITION);
   }
 
+  if( IEC1bits.U1TXIE && IFS1bits.U1TXIF ) {
+    uart_pop_txfifo( &uart_handle_[0] );
+    IFS1CLR = (1 << _IFS1_U1TXIF_POSITION);
+  }
+
   if( U1STAbits.FERR ) {
     U1STACLR = (1 << _U1STA_FERR_POSITION);
   }
@@ -113,6 +126,11 @@ void __ISR(_UART_2_VECTOR, IPL4AUTO) uart2_isr( void )
     IFS1CLR = (1 << _IFS1_U2RXIF_POSITION);
   }
 
+  if( IEC1bits.U2TXIE && IFS1bits.U2TXIF ) {
+    uart_pop_txfifo( &uart_handle_[1] );
+    IFS1CLR = (1 << _IFS1_U2TXIF_POSITION);
+  }
+
   if( U2STAbits.FERR ) {
     U2STACLR = (1 << _U2STA_FERR_POSITION);
   }
@@ -124,27 +142,80 @@ void __ISR(_UART_2_VECTOR, IPL4AUTO) uart2_isr( void )
 
 void uart_push_rxfifo( UART_HANDLE *hndl, uint8_t ch )
 {
-  hndl->rxfifo[hndl->rx_wr++] = ch;
+  uint16_t rx_wr = hndl->rx_wr + 1;
+  if( rx_wr >= hndl->rx_size ) rx_wr = 0;	// roll over.
 
-  // check rollover write index.
-  if( hndl->rx_wr < sizeof(hndl->rxfifo)) {
-    if( hndl->rx_wr == hndl->rx_rd ) {
-      --hndl->rx_wr;   // buffer full
-      hndl->rx_overflow = 1;
-    }
+  if( rx_wr == hndl->rx_rd ) {
+    hndl->rx_overflow = 1;	// buffer full, discard the data.
+  } else {
+    hndl->rxfifo[hndl->rx_wr] = ch;
+
+    // count the delimiter before the data is visible to the reader.
+    if( ch == hndl->delimiter ) hndl->rx_eol_in++;
+    hndl->rx_wr = rx_wr;
   }
-  else {
-    if( hndl->rx_rd == 0 ) {
-      --hndl->rx_wr;   // buffer full
-      hndl->rx_overflow = 1;
-    }
-    else {
-      hndl->rx_wr = 0; // roll over.
-    }
+
+  // wake up the task waiting for the data.
+  if( hndl->rx_wait != 0 &&
+      (hndl->rx_overflow ||
+       (hndl->rx_wait < 0 ? ch == hndl->delimiter :
+	uart_bytes_available(hndl) >= hndl->rx_wait)) ) {
+    hndl->rx_wait = 0;
+    mrbc_notify_event_from_isr( UART_EVENT_RX(hndl) );
   }
 }
 
 
+//================================================================
+/*! move data from TX FIFO to the UART, until its h/w FIFO is full.
+*/
+static void uart_feed_txreg( UART_HANDLE *hndl )
+{
+  uint16_t tx_rd = hndl->tx_rd;
+
+  while( tx_rd != hndl->tx_wr &&
+	 (UxSTA(hndl->unit_num) & _U1STA_UTXBF_MASK) == 0 ) {
+    UxTXREG(hndl->unit_num) = hndl->txfifo[tx_rd++];
+    if( tx_rd >= sizeof(hndl->txfifo) ) tx_rd = 0;
+  }
+  hndl->tx_rd = tx_rd;
+}
+
+
+//================================================================
+/*! TX interrupt handler.
+
+  Stops TX interrupt when TX FIFO becomes empty, and posts the event
+  to the task that waits for the FIFO to drain.
+*/
+void uart_pop_txfifo( UART_HANDLE *hndl )
+{
+  uart_feed_txreg( hndl );
+
+  if( hndl->tx_wake_level >= 0 &&
+      uart_bytes_to_write(hndl) <= hndl->tx_wake_level ) {
+    hndl->tx_wake_level = -1;
+    mrbc_notify_event_from_isr( UART_EVENT_TX(hndl) );
+  }
+  if( hndl->tx_rd == hndl->tx_wr ) uart_tx_interrupt_disable( hndl );
+}
+
+
+//================================================================
+/*! move data from TX FIFO to the UART, by polling.
+
+  It works even if interrupts are disabled.
+*/
+static void uart_tx_poll( UART_HANDLE *hndl )
+{
+  uart_tx_interrupt_disable( hndl );
+  uart_feed_txreg( hndl );
+
+  // the handler posts the event if need, and stops itself.
+  uart_tx_interrupt_enable( hndl );
+}
+
+
 //================================================================
 /*! UART enable or disable interrupt.
 */
@@ -152,8 +223,16 @@ void uart_push_rxfifo( UART_HANDLE *hndl, uint8_t ch )
 void uart_interrupt_en_dis( const UART_HANDLE *hndl, int en_dis )
 {
   switch( hndl->unit_num ) {
-  case 1: IEC1bits.U1RXIE = en_dis;
-  case 2: IEC1bits.U2RXIE = en_dis;
+  case 1: IEC1bits.U1RXIE = en_dis; break;
+  case 2: IEC1bits.U2RXIE = en_dis; break;
+  }
+}
+
+void uart_tx_interrupt_en_dis( const UART_HANDLE *hndl, int en_dis )
+{
+  switch( hndl->unit_num ) {
+  case 1: IEC1bits.U1TXIE = en_dis; break;
+  case 2: IEC1bits.U2TXIE = en_dis; break;
   }
 }
 #endif
@@ -204,6 +283,10 @@ void uart_init(void)
   uart_handle_[0].rxd_pin = (PIN_HANDLE){UART1_RXD_PIN};
   uart_handle_[0].unit_num = 1;
   uart_handle_[0].delimiter = '\n';
+  uart_handle_[0].rxfifo = uart_rxfifo_[0];
+  uart_handle_[0].rx_size = UART_SIZE_RXFIFO;
+  uart_handle_[0].tx_policy = UART_TX_POLICY;
+  uart_handle_[0].tx_wake_level = -1;
 
   // UART1 parameter.
   U1MODE = 0x0008;
@@ -224,6 +307,10 @@ void uart_init(void)
   uart_handle_[1].rxd_pin = (PIN_HANDLE){UART2_RXD_PIN};
   uart_handle_[1].unit_num = 2;
   uart_handle_[1].delimiter = '\n';
+  uart_handle_[1].rxfifo = uart_rxfifo_[1];
+  uart_handle_[1].rx_size = UART_SIZE_RXFIFO;
+  uart_handle_[1].tx_policy = UART_TX_POLICY;
+  uart_handle_[1].tx_wake_level = -1;
 
   // UART2 parameter.
   U2MODE = 0x0008;
@@ -258,10 +345,9 @@ void uart_enable( const UART_HANDLE *hndl )
 
   @memberof UART_HANDLE
 */
-void uart_disable( const UART_HANDLE *hndl )
+void uart_disable( UART_HANDLE *hndl )
 {
-  while( (UxSTA(hndl->unit_num) & _U1STA_TRMT_MASK) == 0 )
-    ;
+  uart_flush( hndl );
   uart_interrupt_disable( hndl );
   UxMODECLR(hndl->unit_num) = _U1MODE_ON_MASK;
   UxSTACLR(hndl->unit_num) = (_U1STA_UTXEN_MASK | _U1STA_URXEN_MASK);
@@ -327,11 +413,111 @@ void uart_clear_rx_buffer( UART_HANDLE *hndl )
   hndl->rx_rd = 0;
   hndl->rx_wr = 0;
   hndl->rx_overflow = 0;
+  hndl->rx_eol_in = 0;
+  hndl->rx_eol_out = 0;
+  hndl->rx_scanned = 0;
 
   uart_interrupt_enable( hndl );
 }
 
 
+//================================================================
+/*! Set the receive buffer.
+
+  @memberof UART_HANDLE
+  @param  hndl		Pointer of UART_HANDLE.
+  @param  buffer	Pointer of buffer, or NULL to allocate from the heap.
+  @param  size		Size of buffer. (2..65535)
+  @return int		0 if no error.
+  @note			The received data is discarded.
+*/
+int uart_set_rx_buffer( UART_HANDLE *hndl, void *buffer, int size )
+{
+  if( size < 2 || size > UINT16_MAX ) return -1;
+
+  int flag_alloc = !buffer;
+  if( flag_alloc ) {
+#if defined(MRBC_USE_SCRATCH_ARENA)
+    // never place it in the task's scratch arena.
+    void *arena = mrbc_scratch_select( 0 );
+    buffer = mrbc_raw_alloc( size );
+    mrbc_scratch_select( arena );
+#else
+    buffer = mrbc_raw_alloc( size );
+#endif
+    if( !buffer ) return -1;
+  }
+
+  uart_interrupt_disable( hndl );
+
+  void *old = hndl->rx_alloc ? (void *)hndl->rxfifo : NULL;
+  hndl->rxfifo = buffer;
+  hndl->rx_size = size;
+  hndl->rx_alloc = flag_alloc;
+  uart_clear_rx_buffer( hndl );		// enables the interrupt.
+
+  if( old ) mrbc_raw_free( old );
+  return 0;
+}
+
+
+//================================================================
+/*! Clear transmit buffer.
+
+  @memberof UART_HANDLE
+  @param  hndl		Pointer of UART_HANDLE.
+*/
+void uart_clear_tx_buffer( UART_HANDLE *hndl )
+{
+  uart_tx_interrupt_disable( hndl );
+  hndl->tx_rd = hndl->tx_wr;
+
+  // let the handler post the event to the waiting task.
+  if( hndl->tx_wake_level >= 0 ) uart_tx_interrupt_enable( hndl );
+}
+
+
+//================================================================
+/*! Wait until all data is sent out.
+
+  @memberof UART_HANDLE
+  @param  hndl		Pointer of UART_HANDLE.
+  @note			It works even if interrupts are disabled.
+*/
+void uart_flush( UART_HANDLE *hndl )
+{
+  while( hndl->tx_rd != hndl->tx_wr ) {
+    uart_tx_poll( hndl );
+  }
+  while( (UxSTA(hndl->unit_num) & _U1STA_TRMT_MASK) == 0 )
+    ;
+}
+
+
+//================================================================
+/*! Release the data that has been read from the receive buffer.
+
+  @memberof UART_HANDLE
+  @param  hndl		Pointer of UART_HANDLE.
+  @param  n		Num of bytes read.
+*/
+static void uart_rx_advance( UART_HANDLE *hndl, int n )
+{
+  int idx = hndl->rx_rd + hndl->rx_scanned;
+
+  // count the delimiters not yet scanned by uart_can_read_line().
+  for( int i = hndl->rx_scanned; i < n; i++ ) {
+    if( idx >= hndl->rx_size ) idx -= hndl->rx_size;
+    if( hndl->rxfifo[idx++] == hndl->delimiter ) hndl->rx_eol_out++;
+  }
+  hndl->rx_scanned = (hndl->rx_scanned > n) ? hndl->rx_scanned - n : 0;
+
+  idx = hndl->rx_rd + n;
+  if( idx >= hndl->rx_size ) idx -= hndl->rx_size;
+  hndl->rx_rd = idx;
+}
+
+
 //================================================================
 /*! Receive binary data.
 
@@ -341,7 +527,9 @@ void uart_clear_rx_buffer( UART_HANDLE *hndl )
   @param  size		Size of buffer.
   @return int		Num of received bytes.
 
-  @note			If no data received, it blocks execution.
+  @note			If no data received, it blocks execution,
+			sleeping the CPU until the next interrupt.
+			The tasks should use UART#read instead.
 */
 int uart_read( UART_HANDLE *hndl, void *buffer, int size )
 {
@@ -349,22 +537,44 @@ int uart_read( UART_HANDLE *hndl, void *buffer, int size )
 
   // wait for data.
   while( !uart_is_readable(hndl) ) {
-    Nop(); Nop(); Nop(); Nop();
+    hal_idle_cpu();
   }
 
   // copy fifo to buffer
+  int n = uart_bytes_available(hndl);
+  if( n > size ) n = size;
+
   uint8_t *buf = buffer;
-  size_t   cnt = size;
-  uint16_t rx_rd;
+  int idx = hndl->rx_rd;
+  for( int i = 0; i < n; i++ ) {
+    *buf++ = hndl->rxfifo[idx++];
+    if( idx >= hndl->rx_size ) idx = 0;
+  }
+  uart_rx_advance( hndl, n );
+
+  return n;
+}
+
+
+//================================================================
+/*! Arrange the TX event to be posted when TX FIFO drains to the level.
 
-  do {
-    rx_rd = hndl->rx_rd;
-    *buf++ = hndl->rxfifo[rx_rd++];
-    if( rx_rd >= sizeof(hndl->rxfifo) ) rx_rd = 0;
-    hndl->rx_rd = rx_rd;
-  } while( --cnt != 0 && rx_rd != hndl->rx_wr );
+  @memberof UART_HANDLE
+  @param  hndl		target UART_HANDLE
+  @param  level		num of bytes left in the FIFO.
+  @return int		0: already drained, 1: wait for the event.
+  @note	called with interrupt disabled.
+	The lowest level of the waiting tasks is kept, and each task must
+	check its level again when woken up.
+*/
+static int uart_set_tx_wake_level( UART_HANDLE *hndl, int level )
+{
+  if( uart_bytes_to_write(hndl) <= level ) return 0;
 
-  return size - cnt;
+  if( hndl->tx_wake_level < 0 || hndl->tx_wake_level > level ) {
+    hndl->tx_wake_level = level;
+  }
+  return 1;
 }
 
 
@@ -383,12 +593,69 @@ int uart_write( UART_HANDLE *hndl, const void *buffer, int size )
   int n = size;
 
   while( n > 0 ) {
-    // TX-FIFOに空きができるまで待つ。
-    while( UxSTA(hndl->unit_num) & _U1STA_UTXBF_MASK ) {
-      Nop(); Nop(); Nop(); Nop();
+    int room = sizeof(hndl->txfifo) - 1 - uart_bytes_to_write(hndl);
+
+    if( room < n ) {
+      switch( hndl->tx_policy ) {
+      case UART_TX_DROP:
+	if( room == 0 ) {
+	  hndl->tx_dropped += n;
+	  return size - n;
+	}
+	break;
+
+      case UART_TX_OVERWRITE: {
+	// keep the newest data.
+	int skip = n - (sizeof(hndl->txfifo) - 1);
+	if( skip > 0 ) {
+	  p += skip;
+	  n -= skip;
+	  hndl->tx_dropped += skip;
+	}
+	uart_tx_interrupt_disable( hndl );
+	room = sizeof(hndl->txfifo) - 1 - uart_bytes_to_write(hndl);
+	if( room < n ) {
+	  uint16_t tx_rd = hndl->tx_rd + (n - room);
+	  if( tx_rd >= sizeof(hndl->txfifo) ) tx_rd -= sizeof(hndl->txfifo);
+	  hndl->tx_rd = tx_rd;
+	  hndl->tx_dropped += n - room;
+	  room = n;
+	}
+      } break;
+
+      default:	// UART_TX_BLOCK
+	if( room == 0 ) {
+	  uart_tx_poll( hndl );
+	  continue;
+	}
+      }
+    }
+
+    // copy buffer to fifo
+    if( room > n ) room = n;
+    n -= room;
+    uint16_t tx_wr = hndl->tx_wr;
+    while( room-- > 0 ) {
+      hndl->txfifo[tx_wr++] = *p++;
+      if( tx_wr >= sizeof(hndl->txfifo) ) tx_wr = 0;
+    }
+    hndl->tx_wr = tx_wr;
+    uart_tx_interrupt_enable( hndl );
+  }
+
+  /* If the FIFO is filled up by a task, the task waits until it drains
+     to 1/4, so that other tasks can run in the meantime.
+     The task stops at the next instruction boundary.
+  */
+  mrbc_tcb *tcb;
+  if( hndl->tx_policy == UART_TX_BLOCK &&
+      uart_bytes_to_write(hndl) > sizeof(hndl->txfifo) * 3 / 4 &&
+      (tcb = mrbc_get_running_task()) != NULL ) {
+    hal_disable_irq();
+    if( uart_set_tx_wake_level( hndl, sizeof(hndl->txfifo) / 4 ) ) {
+      mrbc_wait_event( tcb, UART_EVENT_TX(hndl), -1 );
     }
-    UxTXREG(hndl->unit_num) = *p++;
-    n--;
+    hal_enable_irq();
   }
 
   return size;
@@ -404,7 +671,9 @@ int uart_write( UART_HANDLE *hndl, const void *buffer, int size )
   @param  size		Size of buffer.
   @return int		Num of received bytes.
 
-  @note			If no data received, it blocks execution.
+  @note			If no data received, it blocks execution,
+			sleeping the CPU until the next interrupt.
+			The tasks should use UART#gets instead.
 */
 int uart_gets( UART_HANDLE *hndl, void *buffer, int size )
 {
@@ -415,17 +684,19 @@ int uart_gets( UART_HANDLE *hndl, void *buffer, int size )
     len = uart_can_read_line(hndl);
     if( len > 0 ) break;
 
-      Nop(); Nop(); Nop(); Nop();
+    hal_idle_cpu();
   }
 
   if( len >= size ) return -1;		// buffer size too small.
 
   // copy fifo to buffer
-  for( int ba = len; ba > 0; ba-- ) {
-    *buf++ = hndl->rxfifo[hndl->rx_rd++];
-    if( hndl->rx_rd >= sizeof(hndl->rxfifo) ) hndl->rx_rd = 0;
+  int idx = hndl->rx_rd;
+  for( int i = 0; i < len; i++ ) {
+    *buf++ = hndl->rxfifo[idx++];
+    if( idx >= hndl->rx_size ) idx = 0;
   }
   *buf = '\0';
+  uart_rx_advance( hndl, len );
 
   return len;
 }
@@ -446,7 +717,27 @@ int uart_bytes_available( const UART_HANDLE *hndl )
     return rx_wr - hndl->rx_rd;
   }
   else {
-    return sizeof(hndl->rxfifo) - hndl->rx_rd + rx_wr;
+    return hndl->rx_size - hndl->rx_rd + rx_wr;
+  }
+}
+
+
+//================================================================
+/*! check data length waiting to be sent.
+
+  @memberof UART_HANDLE
+  @param  hndl		Pointer of UART_HANDLE.
+  @return int		result (bytes)
+*/
+int uart_bytes_to_write( const UART_HANDLE *hndl )
+{
+  uint16_t tx_rd = hndl->tx_rd;
+
+  if( tx_rd <= hndl->tx_wr ) {
+    return hndl->tx_wr - tx_rd;
+  }
+  else {
+    return sizeof(hndl->txfifo) - tx_rd + hndl->tx_wr;
   }
 }
 
@@ -459,29 +750,62 @@ int uart_bytes_available( const UART_HANDLE *hndl )
   @return int		string length.
   @note
    If RX-FIFO buffer is full, return -1.
+   The delimiters are counted by the ISR, and the scan continues from
+   where the last call left off, so each byte is scanned only once.
 */
-int uart_can_read_line( const UART_HANDLE *hndl )
+int uart_can_read_line( UART_HANDLE *hndl )
 {
-  uint16_t idx   = hndl->rx_rd;
-  uint16_t rx_wr = hndl->rx_wr;
-
   if( hndl->rx_overflow ) return -1;
 
-  while( idx != rx_wr ) {
-    if( hndl->rxfifo[idx++] == hndl->delimiter ) {
-      if( hndl->rx_rd < idx ) {
-	return idx - hndl->rx_rd;
-      } else {
-	return sizeof(hndl->rxfifo) - hndl->rx_rd + idx;
-      }
-    }
-    if( idx >= sizeof(hndl->rxfifo)) idx = 0;
+  int n = uart_bytes_available(hndl);
+  if( hndl->rx_eol_in == hndl->rx_eol_out ) {
+    hndl->rx_scanned = n;	// no delimiter in n bytes.
+    return 0;
+  }
+
+  int idx = hndl->rx_rd + hndl->rx_scanned;
+  if( idx >= hndl->rx_size ) idx -= hndl->rx_size;
+
+  while( hndl->rx_scanned < n ) {
+    if( hndl->rxfifo[idx] == hndl->delimiter ) return hndl->rx_scanned + 1;
+    hndl->rx_scanned++;
+    if( ++idx >= hndl->rx_size ) idx = 0;
   }
 
   return 0;
 }
 
 
+//================================================================
+/*! Receive data, and append it to the String.
+
+  @memberof UART_HANDLE
+  @param  hndl		Pointer of UART_HANDLE.
+  @param  str		String to append.
+  @param  size		Max bytes to receive.
+  @return int		Num of received bytes.
+*/
+static int uart_read_append( UART_HANDLE *hndl, mrbc_value *str, int size )
+{
+  uint16_t rx_rd = hndl->rx_rd;
+  uint16_t rx_wr = hndl->rx_wr;
+  int n = 0;
+
+  // copy fifo to string, at most 2 chunks due to wrap around.
+  while( n < size && rx_rd != rx_wr ) {
+    int len = (rx_rd < rx_wr ? rx_wr : hndl->rx_size) - rx_rd;
+    if( len > size - n ) len = size - n;
+    if( mrbc_string_append_cbuf( str, (const uint8_t *)hndl->rxfifo + rx_rd, len ) != 0 ) break;
+
+    rx_rd += len;
+    if( rx_rd >= hndl->rx_size ) rx_rd = 0;
+    n += len;
+  }
+  uart_rx_advance( hndl, n );
+
+  return n;
+}
+
 
 /* ============================= mruby/c codes ============================= */
 
@@ -524,7 +848,7 @@ static void c_uart_new(mrbc_vm *vm, mrbc_value v[], int argc)
 */
 static void c_uart_setmode(mrbc_vm *vm, mrbc_value v[], int argc)
 {
-  MRBC_KW_ARG( baudrate, baud, data_bits, stop_bits, parity, flow_control, txd_pin, rxd_pin, rts_pin, cts_pin );
+  MRBC_KW_ARG( baudrate, baud, data_bits, stop_bits, parity, flow_control, txd_pin, rxd_pin, rts_pin, cts_pin, tx_policy, rx_buffer_size );
   if( !MRBC_KW_END() ) goto RETURN;
 
   UART_HANDLE *hndl = *MRBC_INSTANCE_DATA_PTR(v, UART_HANDLE *);
@@ -550,6 +874,17 @@ static void c_uart_setmode(mrbc_vm *vm, mrbc_value v[], int argc)
   }
   if( MRBC_KW_ISVALID(rts_pin) ) goto ERROR_NOT_IMPLEMENTED;
   if( MRBC_KW_ISVALID(cts_pin) ) goto ERROR_NOT_IMPLEMENTED;
+  if( MRBC_KW_ISVALID(tx_policy) ) {
+    int policy = MRBC_VAL_I(&tx_policy);
+    if( policy < UART_TX_BLOCK || policy > UART_TX_OVERWRITE ) goto ERROR_ARGUMENT;
+    uart_set_tx_policy( hndl, policy );
+  }
+  if( MRBC_KW_ISVALID(rx_buffer_size) ) {
+    int size = MRBC_VAL_I(&rx_buffer_size);
+    if( size < 2 || size > UINT16_MAX ) goto ERROR_ARGUMENT;
+    if( size != hndl->rx_size &&
+	uart_set_rx_buffer( hndl, NULL, size ) != 0 ) goto ERROR_NO_MEMORY;
+  }
   if( mrbc_israised(vm) ) goto RETURN;
 
   // set to UART
@@ -567,11 +902,53 @@ static void c_uart_setmode(mrbc_vm *vm, mrbc_value v[], int argc)
   mrbc_raise(vm, MRBC_CLASS(NotImplementedError), 0);
   goto RETURN;
 
+ ERROR_NO_MEMORY:
+  mrbc_raise(vm, MRBC_CLASS(NoMemoryError), 0);
+  goto RETURN;
+
  ERROR_ARGUMENT:
   mrbc_raise(vm, MRBC_CLASS(ArgumentError), 0);
 
  RETURN:
-  MRBC_KW_DELETE( baudrate, baud, data_bits, stop_bits, parity, flow_control, txd_pin, rxd_pin, rts_pin, cts_pin );
+  MRBC_KW_DELETE( baudrate, baud, data_bits, stop_bits, parity, flow_control, txd_pin, rxd_pin, rts_pin, cts_pin, tx_policy, rx_buffer_size );
+}
+
+
+//================================================================
+/*! read n bytes into v[0], or arrange to wait for the rest.
+
+  @return	0: done, 1: wait for the data.
+*/
+static int uart_read_sub( mrbc_vm *vm, mrbc_value v[], UART_HANDLE *hndl, int read_bytes, int flag_timeout )
+{
+  if( uart_is_rx_overflow( hndl ) ) {
+    mrbc_raise(vm, 0, "UART Rx buffer overflow. resetting.");
+    uart_clear_rx_buffer( hndl );
+    return 0;
+  }
+
+  int n = read_bytes - mrbc_string_size(&v[0]);
+  n -= uart_read_append( hndl, &v[0], n );
+  if( n == 0 ) return 0;
+
+  if( flag_timeout ) {
+    hndl->rx_wait = 0;
+    if( mrbc_string_size(&v[0]) == 0 ) SET_NIL_RETURN();
+    return 0;
+  }
+
+  // the rest may be larger than the fifo.
+  if( n > hndl->rx_size - 1 ) n = hndl->rx_size - 1;
+  hndl->rx_wait = n;
+  return 1;
+}
+
+static int uart_read_resume( mrbc_tcb *tcb, int flag_timeout )
+{
+  UART_HANDLE *hndl = &uart_handle_[(tcb->resume_param & 0xff) - 1];
+
+  return uart_read_sub( &tcb->vm, tcb->resume_v, hndl,
+			tcb->resume_param >> 8, flag_timeout );
 }
 
 
@@ -579,46 +956,159 @@ static void c_uart_setmode(mrbc_vm *vm, mrbc_value v[], int argc)
 /*! read
 
   s = uart1.read(n)
+  s = uart1.read(n, timeout: ms)
 
   @param  n		Number of bytes receive.
+  @param  timeout	Timeout in milliseconds.
   @return String	Received data.
+  @note	The task waits without spinning, until n bytes are received.
+	If timed out, returns the received data so far, or nil.
 */
 static void c_uart_read(mrbc_vm *vm, mrbc_value v[], int argc)
 {
   UART_HANDLE *hndl = *MRBC_INSTANCE_DATA_PTR(v, UART_HANDLE *);
+  MRBC_KW_ARG( timeout );
+  if( !MRBC_KW_END() ) goto RETURN;
 
   mrbc_int_t read_bytes = MRBC_ARG_I(1);
-  if( mrbc_israised(vm) ) return;
+  int32_t timeout_ms = MRBC_KW_ISVALID(timeout) ? MRBC_VAL_I(&timeout) : -1;
+  if( mrbc_israised(vm) ) goto RETURN;
+  if( read_bytes < 0 || read_bytes > UINT16_MAX ) {
+    mrbc_raise(vm, MRBC_CLASS(ArgumentError), 0);
+    goto RETURN;
+  }
+
+  // the data is appended to v[0].
+  mrbc_value ret = mrbc_string_new(vm, 0, 0);
+  if( !ret.string ) {
+    SET_NIL_RETURN();
+    goto RETURN;
+  }
+  SET_RETURN(ret);
+
+  mrbc_tcb *tcb = mrbc_get_running_task();
+  if( !tcb ) {
+    while( uart_read_sub( vm, v, hndl, read_bytes, 0 ) ) {
+      hal_idle_cpu();
+    }
+    hndl->rx_wait = 0;
+    goto RETURN;
+  }
+
+  hal_disable_irq();
+  if( uart_read_sub( vm, v, hndl, read_bytes, timeout_ms == 0 ) ) {
+    mrbc_set_resume_func( tcb, uart_read_resume, v,
+			  hndl->unit_num | (read_bytes << 8) );
+    mrbc_wait_event( tcb, UART_EVENT_RX(hndl), timeout_ms );
+  }
+  hal_enable_irq();
 
+ RETURN:
+  MRBC_KW_DELETE( timeout );
+}
+
+
+//================================================================
+/*! read the available data into the String in v[0], or arrange to wait.
+
+  @return	0: done, 1: wait for the data.
+*/
+static int uart_read_into_sub( mrbc_vm *vm, mrbc_value v[], UART_HANDLE *hndl, int maxlen, int flag_timeout )
+{
   if( uart_is_rx_overflow( hndl ) ) {
     mrbc_raise(vm, 0, "UART Rx buffer overflow. resetting.");
     uart_clear_rx_buffer( hndl );
-    return;
+    return 0;
   }
 
-  mrbc_value ret = mrbc_string_new(vm, 0, read_bytes);
-  char *buf = mrbc_string_cstr(&ret);
-  if( !buf ) {
-    SET_RETURN(mrbc_nil_value());
-    return;
+  if( maxlen != 0 && !uart_is_readable(hndl) ) {
+    if( flag_timeout ) {
+      hndl->rx_wait = 0;
+      SET_NIL_RETURN();
+      return 0;
+    }
+    hndl->rx_wait = 1;
+    return 1;
   }
 
-  while( read_bytes > 0 ) {
-    mrbc_int_t n = uart_bytes_available(hndl);
-    if( n == 0 ) {
-      Nop(); Nop(); Nop(); Nop();
-      continue;
-    }
+  // overwrite the contents, keeping the buffer.
+  // (another task may have shared it while waiting)
+  if( mrbc_string_modify( &v[0] ) != 0 ) {
+    mrbc_raise(vm, MRBC_CLASS(NoMemoryError), 0);
+    return 0;
+  }
+  v[0].string->size = 0;
+  v[0].string->data[0] = '\0';
+  int n = uart_read_append( hndl, &v[0], maxlen );
 
-    if( n > read_bytes ) n = read_bytes;
-    uart_read( hndl, buf, n );
+  SET_INT_RETURN( n );
+  return 0;
+}
 
-    buf += n;
-    read_bytes -= n;
+static int uart_read_into_resume( mrbc_tcb *tcb, int flag_timeout )
+{
+  UART_HANDLE *hndl = &uart_handle_[(tcb->resume_param & 0xff) - 1];
+
+  return uart_read_into_sub( &tcb->vm, tcb->resume_v, hndl,
+			     tcb->resume_param >> 8, flag_timeout );
+}
+
+
+//================================================================
+/*! read into the buffer
+
+  n = uart1.read_into(buf)
+  n = uart1.read_into(buf, maxlen, timeout: ms)
+
+  @param  buf		String to be overwritten by the received data.
+  @param  maxlen	Max bytes to receive. (default: capacity of buf)
+  @param  timeout	Timeout in milliseconds.
+  @return Integer	Num of received bytes, or nil if timed out.
+  @note	The task waits until at least one byte is received.
+	No memory is allocated as long as the data fits in buf.
+*/
+static void c_uart_read_into(mrbc_vm *vm, mrbc_value v[], int argc)
+{
+  UART_HANDLE *hndl = *MRBC_INSTANCE_DATA_PTR(v, UART_HANDLE *);
+  MRBC_KW_ARG( timeout );
+  if( !MRBC_KW_END() ) goto RETURN;
+
+  if( argc < 1 || v[1].tt != MRBC_TT_STRING ) goto ERROR_ARGUMENT;
+
+  int capa = v[1].string->shared ? v[1].string->size : v[1].string->capa;
+  mrbc_int_t maxlen = MRBC_ARG_I(2, capa ? capa : hndl->rx_size - 1);
+  int32_t timeout_ms = MRBC_KW_ISVALID(timeout) ? MRBC_VAL_I(&timeout) : -1;
+  if( mrbc_israised(vm) ) goto RETURN;
+  if( maxlen < 0 || maxlen > UINT16_MAX ) goto ERROR_ARGUMENT;
+
+  // the buffer is kept in v[0] while waiting.
+  mrbc_incref( &v[1] );
+  SET_RETURN( v[1] );
+
+  mrbc_tcb *tcb = mrbc_get_running_task();
+  if( !tcb ) {
+    while( uart_read_into_sub( vm, v, hndl, maxlen, 0 ) ) {
+      hal_idle_cpu();
+    }
+    hndl->rx_wait = 0;
+    goto RETURN;
   }
-  *buf = 0;
 
-  SET_RETURN(ret);
+  hal_disable_irq();
+  if( uart_read_into_sub( vm, v, hndl, maxlen, timeout_ms == 0 ) ) {
+    mrbc_set_resume_func( tcb, uart_read_into_resume, v,
+			  hndl->unit_num | (maxlen << 8) );
+    mrbc_wait_event( tcb, UART_EVENT_RX(hndl), timeout_ms );
+  }
+  hal_enable_irq();
+  goto RETURN;
+
+
+ ERROR_ARGUMENT:
+  mrbc_raise(vm, MRBC_CLASS(ArgumentError), 0);
+
+ RETURN:
+  MRBC_KW_DELETE( timeout );
 }
 
 
@@ -634,7 +1124,7 @@ static void c_uart_write(mrbc_vm *vm, mrbc_value v[], int argc)
   UART_HANDLE *hndl = *MRBC_INSTANCE_DATA_PTR(v, UART_HANDLE *);
 
   if( v[1].tt == MRBC_TT_STRING ) {
-    int n = uart_write( hndl, mrbc_string_cstr(&v[1]), mrbc_string_size(&v[1]) );
+    int n = uart_write( hndl, mrbc_string_ptr(&v[1]), mrbc_string_size(&v[1]) );
     SET_INT_RETURN(n);
   }
   else {
@@ -644,40 +1134,86 @@ static void c_uart_write(mrbc_vm *vm, mrbc_value v[], int argc)
 
 
 //================================================================
-/*! gets
+/*! read a line into v[0], or arrange to wait for it.
 
-  s = uart1.gets()
-
-  @return String	Received string.
+  @return	0: done, 1: wait for the data.
 */
-static void c_uart_gets(mrbc_vm *vm, mrbc_value v[], int argc)
+static int uart_gets_sub( mrbc_vm *vm, mrbc_value v[], UART_HANDLE *hndl, int flag_timeout )
 {
-  UART_HANDLE *hndl = *MRBC_INSTANCE_DATA_PTR(v, UART_HANDLE *);
-
-  int len;
-  while( 1 ) {
-    len = uart_can_read_line(hndl);
-    if( len > 0 ) break;
-    if( len < 0 ) {
-      mrbc_raise(vm, 0, "UART Rx buffer overflow. resetting.");
-      uart_clear_rx_buffer( hndl );
-      return;
+  int len = uart_can_read_line(hndl);
+  if( len < 0 ) {
+    mrbc_raise(vm, 0, "UART Rx buffer overflow. resetting.");
+    uart_clear_rx_buffer( hndl );
+    return 0;
+  }
+  if( len == 0 ) {
+    if( flag_timeout ) {
+      hndl->rx_wait = 0;
+      SET_NIL_RETURN();
+      return 0;
     }
-
-    Nop(); Nop(); Nop(); Nop();
+    hndl->rx_wait = -1;
+    return 1;
   }
 
   mrbc_value ret = mrbc_string_new(vm, 0, len);
   char *buf = mrbc_string_cstr(&ret);
   if( !buf ) {
-    SET_RETURN(mrbc_nil_value());
-    return;
+    SET_NIL_RETURN();
+    return 0;
   }
 
   uart_read( hndl, buf, len );
   *(buf + len) = 0;
 
   SET_RETURN(ret);
+  return 0;
+}
+
+static int uart_gets_resume( mrbc_tcb *tcb, int flag_timeout )
+{
+  UART_HANDLE *hndl = &uart_handle_[tcb->resume_param - 1];
+
+  return uart_gets_sub( &tcb->vm, tcb->resume_v, hndl, flag_timeout );
+}
+
+
+//================================================================
+/*! gets
+
+  s = uart1.gets()
+  s = uart1.gets(timeout: ms)
+
+  @param  timeout	Timeout in milliseconds.
+  @return String	Received string, or nil if timed out.
+  @note	The task waits without spinning, until the delimiter is received.
+*/
+static void c_uart_gets(mrbc_vm *vm, mrbc_value v[], int argc)
+{
+  UART_HANDLE *hndl = *MRBC_INSTANCE_DATA_PTR(v, UART_HANDLE *);
+  MRBC_KW_ARG( timeout );
+  if( !MRBC_KW_END() ) goto RETURN;
+
+  int32_t timeout_ms = MRBC_KW_ISVALID(timeout) ? MRBC_VAL_I(&timeout) : -1;
+
+  mrbc_tcb *tcb = mrbc_get_running_task();
+  if( !tcb ) {
+    while( uart_gets_sub( vm, v, hndl, 0 ) ) {
+      hal_idle_cpu();
+    }
+    hndl->rx_wait = 0;
+    goto RETURN;
+  }
+
+  hal_disable_irq();
+  if( uart_gets_sub( vm, v, hndl, timeout_ms == 0 ) ) {
+    mrbc_set_resume_func( tcb, uart_gets_resume, v, hndl->unit_num );
+    mrbc_wait_event( tcb, UART_EVENT_RX(hndl), timeout_ms );
+  }
+  hal_enable_irq();
+
+ RETURN:
+  MRBC_KW_DELETE( timeout );
 }
 
 
@@ -693,7 +1229,7 @@ static void c_uart_puts(mrbc_vm *vm, mrbc_value v[], int argc)
   UART_HANDLE *hndl = *MRBC_INSTANCE_DATA_PTR(v, UART_HANDLE *);
 
   if( v[1].tt == MRBC_TT_STRING ) {
-    const char *s = mrbc_string_cstr(&v[1]);
+    const char *s = mrbc_string_ptr(&v[1]);
     int len = mrbc_string_size(&v[1]);
 
     uart_write( hndl, s, len );
@@ -732,8 +1268,9 @@ static void c_uart_bytes_available(mrbc_vm *vm, mrbc_value v[], int argc)
 */
 static void c_uart_bytes_to_write(mrbc_vm *vm, mrbc_value v[], int argc)
 {
-  // always zero return because no write buffer.
-  SET_INT_RETURN( 0 );
+  UART_HANDLE *hndl = *MRBC_INSTANCE_DATA_PTR(v, UART_HANDLE *);
+
+  SET_INT_RETURN( uart_bytes_to_write( hndl ) );
 }
 
 
@@ -759,14 +1296,43 @@ static void c_uart_can_read_line(mrbc_vm *vm, mrbc_value v[], int argc)
 }
 
 
+//================================================================
+/*! check that TX FIFO is empty when the flushing task is woken up.
+
+  @return	0: done, 1: wait again.
+*/
+static int uart_flush_resume( mrbc_tcb *tcb, int flag_timeout )
+{
+  UART_HANDLE *hndl = &uart_handle_[tcb->resume_param - 1];
+
+  if( flag_timeout ) return 0;
+  return uart_set_tx_wake_level( hndl, 0 );
+}
+
+
 //================================================================
 /*! flush tx buffer.
 
   uart1.flush()
+
+  The task waits until TX FIFO becomes empty, without spinning.
 */
 static void c_uart_flush(mrbc_vm *vm, mrbc_value v[], int argc)
 {
-  // nothing to do.
+  UART_HANDLE *hndl = *MRBC_INSTANCE_DATA_PTR(v, UART_HANDLE *);
+  mrbc_tcb *tcb = mrbc_get_running_task();
+
+  if( !tcb ) {
+    uart_flush( hndl );
+    return;
+  }
+
+  hal_disable_irq();
+  if( uart_set_tx_wake_level( hndl, 0 ) ) {
+    mrbc_set_resume_func( tcb, uart_flush_resume, v, hndl->unit_num );
+    mrbc_wait_event( tcb, UART_EVENT_TX(hndl), -1 );
+  }
+  hal_enable_irq();
 }
 
 
@@ -777,7 +1343,8 @@ static void c_uart_flush(mrbc_vm *vm, mrbc_value v[], int argc)
 */
 static void c_uart_clear_tx_buffer(mrbc_vm *vm, mrbc_value v[], int argc)
 {
-  // nothing to do.
+  UART_HANDLE *hndl = *MRBC_INSTANCE_DATA_PTR(v, UART_HANDLE *);
+  uart_clear_tx_buffer( hndl );
 }
 
 
@@ -802,8 +1369,7 @@ static void c_uart_send_break(mrbc_vm *vm, mrbc_value v[], int argc)
 {
   UART_HANDLE *hndl = *MRBC_INSTANCE_DATA_PTR(v, UART_HANDLE *);
 
-  while( (UxSTA(hndl->unit_num) & _U1STA_TRMT_MASK) == 0 )
-    ;
+  uart_flush( hndl );
   UxSTASET(hndl->unit_num) = _U1STA_UTXBRK_MASK;
   UxTXREG(hndl->unit_num) = 0x00;		// dummy data.
 
@@ -821,6 +1387,7 @@ void mrbc_init_class_uart(void)
     { "new", c_uart_new },
     { "setmode", c_uart_setmode },
     { "read", c_uart_read },
+    { "read_into", c_uart_read_into },
     { "write", c_uart_write },
     { "gets", c_uart_gets },
     { "puts", c_uart_puts },
@@ -840,4 +1407,7 @@ void mrbc_init_class_uart(void)
   mrbc_set_class_const(uart, mrbc_str_to_symid("ODD"), &mrbc_integer_value(UART_ODD));
   mrbc_set_class_const(uart, mrbc_str_to_symid("EVEN"), &mrbc_integer_value(UART_EVEN));
   mrbc_set_class_const(uart, mrbc_str_to_symid("RTSCTS"), &mrbc_integer_value(UART_RTSCTS));
+  mrbc_set_class_const(uart, mrbc_str_to_symid("TX_BLOCK"), &mrbc_integer_value(UART_TX_BLOCK));
+  mrbc_set_class_const(uart, mrbc_str_to_symid("TX_DROP"), &mrbc_integer_value(UART_TX_DROP));
+  mrbc_set_class_const(uart, mrbc_str_to_symid("TX_OVERWRITE"), &mrbc_integer_value(UART_TX_OVERWRITE));
 }
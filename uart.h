@@ -30,7 +30,18 @@ extern "C" {
 #endif
 
 #ifndef UART_SIZE_RXFIFO
-# define UART_SIZE_RXFIFO 128
+# define UART_SIZE_RXFIFO 128	// default. (see uart_set_rx_buffer)
+#endif
+#ifndef UART_SIZE_TXFIFO
+# define UART_SIZE_TXFIFO 256
+#endif
+
+// what uart_write() does when the TX FIFO is full.
+#define UART_TX_BLOCK		0	// wait, and throttle the task.
+#define UART_TX_DROP		1	// discard the new data.
+#define UART_TX_OVERWRITE	2	// discard the oldest data.
+#ifndef UART_TX_POLICY
+# define UART_TX_POLICY UART_TX_BLOCK
 #endif
 
 //================================================================
@@ -44,10 +55,24 @@ typedef struct UART_HANDLE {
   uint8_t unit_num;		// 1..
   uint8_t rx_overflow;		// buffer overflow flag.
   uint8_t delimiter;
+  uint8_t rx_alloc;		// rxfifo is allocated from the heap.
 
   volatile uint16_t rx_rd;	// index of rxfifo for read.
   volatile uint16_t rx_wr;	// index of rxfifo for write.
-  volatile uint8_t rxfifo[UART_SIZE_RXFIFO]; // FIFO for received data.
+  volatile int16_t rx_wait;	// post the event when received this many
+				// bytes, -1: a line, 0: none.
+  volatile uint16_t rx_eol_in;	// num of delimiters received. (by ISR)
+  uint16_t rx_eol_out;		// num of delimiters read.
+  uint16_t rx_scanned;		// bytes from rx_rd having no delimiter.
+  uint16_t rx_size;		// size of rxfifo.
+  volatile uint8_t *rxfifo;	// FIFO for received data.
+
+  uint8_t tx_policy;		// UART_TX_BLOCK, DROP or OVERWRITE.
+  volatile int16_t tx_wake_level; // post the event at this fill, or -1.
+  uint32_t tx_dropped;		// num of bytes discarded.
+  volatile uint16_t tx_rd;	// index of txfifo for read. (by ISR)
+  volatile uint16_t tx_wr;	// index of txfifo for write.
+  uint8_t txfifo[UART_SIZE_TXFIFO]; // FIFO for transmit data.
 
 } UART_HANDLE;
 
@@ -58,17 +83,23 @@ extern UART_HANDLE uart_handle_[];
   function prototypes.
 */
 void uart_push_rxfifo(UART_HANDLE *hndl, uint8_t ch);
+void uart_pop_txfifo(UART_HANDLE *hndl);
 void uart_interrupt_en_dis(const UART_HANDLE *hndl, int en_dis);
+void uart_tx_interrupt_en_dis(const UART_HANDLE *hndl, int en_dis);
 void uart_init(void);
 void uart_enable(const UART_HANDLE *hndl);
-void uart_disable(const UART_HANDLE *hndl);
+void uart_disable(UART_HANDLE *hndl);
 int uart_setmode(const UART_HANDLE *hndl, int baud, int parity, int stop_bits);
 void uart_clear_rx_buffer(UART_HANDLE *hndl);
+int uart_set_rx_buffer(UART_HANDLE *hndl, void *buffer, int size);
+void uart_clear_tx_buffer(UART_HANDLE *hndl);
+void uart_flush(UART_HANDLE *hndl);
 int uart_read(UART_HANDLE *hndl, void *buffer, int size);
 int uart_write(UART_HANDLE *hndl, const void *buffer, int size);
 int uart_gets(UART_HANDLE *hndl, void *buffer, int size);
 int uart_bytes_available(const UART_HANDLE *hndl);
-int uart_can_read_line(const UART_HANDLE *hndl);
+int uart_bytes_to_write(const UART_HANDLE *hndl);
+int uart_can_read_line(UART_HANDLE *hndl);
 void mrbc_init_class_uart(void);
 
 
@@ -133,6 +164,40 @@ static inline void uart_interrupt_disable( const UART_HANDLE *hndl )
 }
 
 
+//================================================================
+/*! Enable TX interrrupt
+
+  @memberof UART_HANDLE
+*/
+static inline void uart_tx_interrupt_enable( const UART_HANDLE *hndl )
+{
+  uart_tx_interrupt_en_dis( hndl, 1 );
+}
+
+
+//================================================================
+/*! Disable TX interrrupt
+
+  @memberof UART_HANDLE
+*/
+static inline void uart_tx_interrupt_disable( const UART_HANDLE *hndl )
+{
+  uart_tx_interrupt_en_dis( hndl, 0 );
+}
+
+
+//================================================================
+/*! Set the policy when TX FIFO is full.
+
+  @memberof UART_HANDLE
+  @param  policy	UART_TX_BLOCK, UART_TX_DROP or UART_TX_OVERWRITE
+*/
+static inline void uart_set_tx_policy( UART_HANDLE *hndl, int policy )
+{
+  hndl->tx_policy = policy;
+}
+
+
 /* Provide C++ Compatibility */
 #ifdef __cplusplus
 }